@@ -0,0 +1,561 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "gstspotifyconvert.h"
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define HAVE_CONVERT_X86 1
+#include <immintrin.h>
+#elif defined (__aarch64__) && defined (__ARM_NEON)
+#define HAVE_CONVERT_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* One set of kernels per instruction set, the S16 copy is always memcpy */
+typedef struct _GstSpotifyConvertImpl
+{
+  const gchar           *name;
+  GstSpotifyConvertFunc s16;
+  GstSpotifyConvertFunc s16_mono;
+  GstSpotifyConvertFunc s32;
+  GstSpotifyConvertFunc s32_mono;
+  GstSpotifyConvertFunc f32;
+  GstSpotifyConvertFunc f32_mono;
+} GstSpotifyConvertImpl;
+
+/*** scalar *****************************************************************/
+
+/* Rounds to nearest, saturating at the limits of the output type */
+static inline gint16
+clamp_s16 (gfloat v)
+{
+  v = CLAMP (v, -32768.0f, 32767.0f);
+  return (gint16) (v < 0.0f ? v - 0.5f : v + 0.5f);
+}
+
+static inline gint32
+clamp_s32 (gfloat v)
+{
+  /* the largest float below 2^31 */
+  v = CLAMP (v, -2147483648.0f, 2147483520.0f);
+  return (gint32) (v < 0.0f ? v - 0.5f : v + 0.5f);
+}
+
+static void
+convert_copy (guint8 * dest, const gint16 * src, guint samples, gfloat scale)
+{
+  memcpy (dest, src, samples * sizeof (gint16));
+}
+
+/* Plain loops over restrict pointers, which compilers vectorize too */
+
+static void
+convert_s16 (guint8 * dest, const gint16 * src, guint samples, gfloat scale)
+{
+  gint16 *restrict d = (gint16 *) dest;
+  const gint16 *restrict s = src;
+  guint i;
+
+  for (i = 0; i < samples; i++)
+    d[i] = clamp_s16 (s[i] * scale);
+}
+
+static void
+convert_s16_mono (guint8 * dest, const gint16 * src, guint samples,
+    gfloat scale)
+{
+  gint16 *restrict d = (gint16 *) dest;
+  const gint16 *restrict s = src;
+  guint i;
+
+  for (i = 0; i < samples; i++)
+    d[i] = clamp_s16 (((gint32) s[2 * i] + s[2 * i + 1]) * scale);
+}
+
+static void
+convert_s32 (guint8 * dest, const gint16 * src, guint samples, gfloat scale)
+{
+  gint32 *restrict d = (gint32 *) dest;
+  const gint16 *restrict s = src;
+  guint i;
+
+  for (i = 0; i < samples; i++)
+    d[i] = clamp_s32 (s[i] * scale);
+}
+
+static void
+convert_s32_mono (guint8 * dest, const gint16 * src, guint samples,
+    gfloat scale)
+{
+  gint32 *restrict d = (gint32 *) dest;
+  const gint16 *restrict s = src;
+  guint i;
+
+  for (i = 0; i < samples; i++)
+    d[i] = clamp_s32 (((gint32) s[2 * i] + s[2 * i + 1]) * scale);
+}
+
+static void
+convert_f32 (guint8 * dest, const gint16 * src, guint samples, gfloat scale)
+{
+  gfloat *restrict d = (gfloat *) dest;
+  const gint16 *restrict s = src;
+  guint i;
+
+  for (i = 0; i < samples; i++)
+    d[i] = s[i] * scale;
+}
+
+static void
+convert_f32_mono (guint8 * dest, const gint16 * src, guint samples,
+    gfloat scale)
+{
+  gfloat *restrict d = (gfloat *) dest;
+  const gint16 *restrict s = src;
+  guint i;
+
+  for (i = 0; i < samples; i++)
+    d[i] = ((gint32) s[2 * i] + s[2 * i + 1]) * scale;
+}
+
+static const GstSpotifyConvertImpl impl_scalar = {
+  "scalar",
+  convert_s16, convert_s16_mono,
+  convert_s32, convert_s32_mono,
+  convert_f32, convert_f32_mono
+};
+
+/*
+ * The vector kernels below handle whole vectors and leave the tail to the
+ * scalar ones.  Downmixes add each stereo pair with a multiply-add against
+ * ones.  S32 stays scalar, vector float to int32 conversions don't
+ * saturate on x86.
+ */
+
+/*** SSE2 *******************************************************************/
+
+#ifdef HAVE_CONVERT_X86
+__attribute__ ((target ("sse2")))
+static void
+convert_s16_sse2 (guint8 * dest, const gint16 * src, guint samples,
+    gfloat scale)
+{
+  gint16 *d = (gint16 *) dest;
+  const __m128 s = _mm_set1_ps (scale);
+  __m128i x, lo, hi;
+  guint i;
+
+  for (i = 0; i + 8 <= samples; i += 8) {
+    x = _mm_loadu_si128 ((const __m128i *) (src + i));
+    lo = _mm_srai_epi32 (_mm_unpacklo_epi16 (x, x), 16);
+    hi = _mm_srai_epi32 (_mm_unpackhi_epi16 (x, x), 16);
+    lo = _mm_cvtps_epi32 (_mm_mul_ps (_mm_cvtepi32_ps (lo), s));
+    hi = _mm_cvtps_epi32 (_mm_mul_ps (_mm_cvtepi32_ps (hi), s));
+    _mm_storeu_si128 ((__m128i *) (d + i), _mm_packs_epi32 (lo, hi));
+  }
+  convert_s16 ((guint8 *) (d + i), src + i, samples - i, scale);
+}
+
+__attribute__ ((target ("sse2")))
+static void
+convert_s16_mono_sse2 (guint8 * dest, const gint16 * src, guint samples,
+    gfloat scale)
+{
+  gint16 *d = (gint16 *) dest;
+  const __m128 s = _mm_set1_ps (scale);
+  const __m128i ones = _mm_set1_epi16 (1);
+  __m128i lo, hi;
+  guint i;
+
+  for (i = 0; i + 8 <= samples; i += 8) {
+    lo = _mm_madd_epi16 (_mm_loadu_si128 ((const __m128i *) (src + 2 * i)),
+        ones);
+    hi = _mm_madd_epi16 (_mm_loadu_si128 ((const __m128i *) (src + 2 * i +
+                8)), ones);
+    lo = _mm_cvtps_epi32 (_mm_mul_ps (_mm_cvtepi32_ps (lo), s));
+    hi = _mm_cvtps_epi32 (_mm_mul_ps (_mm_cvtepi32_ps (hi), s));
+    _mm_storeu_si128 ((__m128i *) (d + i), _mm_packs_epi32 (lo, hi));
+  }
+  convert_s16_mono ((guint8 *) (d + i), src + 2 * i, samples - i, scale);
+}
+
+__attribute__ ((target ("sse2")))
+static void
+convert_f32_sse2 (guint8 * dest, const gint16 * src, guint samples,
+    gfloat scale)
+{
+  gfloat *d = (gfloat *) dest;
+  const __m128 s = _mm_set1_ps (scale);
+  __m128i x, lo, hi;
+  guint i;
+
+  for (i = 0; i + 8 <= samples; i += 8) {
+    x = _mm_loadu_si128 ((const __m128i *) (src + i));
+    lo = _mm_srai_epi32 (_mm_unpacklo_epi16 (x, x), 16);
+    hi = _mm_srai_epi32 (_mm_unpackhi_epi16 (x, x), 16);
+    _mm_storeu_ps (d + i, _mm_mul_ps (_mm_cvtepi32_ps (lo), s));
+    _mm_storeu_ps (d + i + 4, _mm_mul_ps (_mm_cvtepi32_ps (hi), s));
+  }
+  convert_f32 ((guint8 *) (d + i), src + i, samples - i, scale);
+}
+
+__attribute__ ((target ("sse2")))
+static void
+convert_f32_mono_sse2 (guint8 * dest, const gint16 * src, guint samples,
+    gfloat scale)
+{
+  gfloat *d = (gfloat *) dest;
+  const __m128 s = _mm_set1_ps (scale);
+  const __m128i ones = _mm_set1_epi16 (1);
+  __m128i sum;
+  guint i;
+
+  for (i = 0; i + 4 <= samples; i += 4) {
+    sum = _mm_madd_epi16 (_mm_loadu_si128 ((const __m128i *) (src + 2 * i)),
+        ones);
+    _mm_storeu_ps (d + i, _mm_mul_ps (_mm_cvtepi32_ps (sum), s));
+  }
+  convert_f32_mono ((guint8 *) (d + i), src + 2 * i, samples - i, scale);
+}
+
+static const GstSpotifyConvertImpl impl_sse2 = {
+  "sse2",
+  convert_s16_sse2, convert_s16_mono_sse2,
+  convert_s32, convert_s32_mono,
+  convert_f32_sse2, convert_f32_mono_sse2
+};
+
+/*** AVX2 *******************************************************************/
+
+__attribute__ ((target ("avx2")))
+static void
+convert_s16_avx2 (guint8 * dest, const gint16 * src, guint samples,
+    gfloat scale)
+{
+  gint16 *d = (gint16 *) dest;
+  const __m256 s = _mm256_set1_ps (scale);
+  __m256i lo, hi;
+  guint i;
+
+  for (i = 0; i + 16 <= samples; i += 16) {
+    lo = _mm256_cvtepi16_epi32 (_mm_loadu_si128 ((const __m128i *) (src + i)));
+    hi = _mm256_cvtepi16_epi32 (_mm_loadu_si128 ((const __m128i *) (src + i +
+                8)));
+    lo = _mm256_cvtps_epi32 (_mm256_mul_ps (_mm256_cvtepi32_ps (lo), s));
+    hi = _mm256_cvtps_epi32 (_mm256_mul_ps (_mm256_cvtepi32_ps (hi), s));
+    /* packs works per 128 bit lane, put the quarters back in order */
+    _mm256_storeu_si256 ((__m256i *) (d + i),
+        _mm256_permute4x64_epi64 (_mm256_packs_epi32 (lo, hi), 0xd8));
+  }
+  convert_s16 ((guint8 *) (d + i), src + i, samples - i, scale);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+convert_s16_mono_avx2 (guint8 * dest, const gint16 * src, guint samples,
+    gfloat scale)
+{
+  gint16 *d = (gint16 *) dest;
+  const __m256 s = _mm256_set1_ps (scale);
+  const __m256i ones = _mm256_set1_epi16 (1);
+  __m256i lo, hi;
+  guint i;
+
+  for (i = 0; i + 16 <= samples; i += 16) {
+    lo = _mm256_madd_epi16 (_mm256_loadu_si256 ((const __m256i *) (src +
+                2 * i)), ones);
+    hi = _mm256_madd_epi16 (_mm256_loadu_si256 ((const __m256i *) (src +
+                2 * i + 16)), ones);
+    lo = _mm256_cvtps_epi32 (_mm256_mul_ps (_mm256_cvtepi32_ps (lo), s));
+    hi = _mm256_cvtps_epi32 (_mm256_mul_ps (_mm256_cvtepi32_ps (hi), s));
+    _mm256_storeu_si256 ((__m256i *) (d + i),
+        _mm256_permute4x64_epi64 (_mm256_packs_epi32 (lo, hi), 0xd8));
+  }
+  convert_s16_mono ((guint8 *) (d + i), src + 2 * i, samples - i, scale);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+convert_f32_avx2 (guint8 * dest, const gint16 * src, guint samples,
+    gfloat scale)
+{
+  gfloat *d = (gfloat *) dest;
+  const __m256 s = _mm256_set1_ps (scale);
+  __m256i x;
+  guint i;
+
+  for (i = 0; i + 8 <= samples; i += 8) {
+    x = _mm256_cvtepi16_epi32 (_mm_loadu_si128 ((const __m128i *) (src + i)));
+    _mm256_storeu_ps (d + i, _mm256_mul_ps (_mm256_cvtepi32_ps (x), s));
+  }
+  convert_f32 ((guint8 *) (d + i), src + i, samples - i, scale);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+convert_f32_mono_avx2 (guint8 * dest, const gint16 * src, guint samples,
+    gfloat scale)
+{
+  gfloat *d = (gfloat *) dest;
+  const __m256 s = _mm256_set1_ps (scale);
+  const __m256i ones = _mm256_set1_epi16 (1);
+  __m256i sum;
+  guint i;
+
+  for (i = 0; i + 8 <= samples; i += 8) {
+    sum = _mm256_madd_epi16 (_mm256_loadu_si256 ((const __m256i *) (src +
+                2 * i)), ones);
+    _mm256_storeu_ps (d + i, _mm256_mul_ps (_mm256_cvtepi32_ps (sum), s));
+  }
+  convert_f32_mono ((guint8 *) (d + i), src + 2 * i, samples - i, scale);
+}
+
+static const GstSpotifyConvertImpl impl_avx2 = {
+  "avx2",
+  convert_s16_avx2, convert_s16_mono_avx2,
+  convert_s32, convert_s32_mono,
+  convert_f32_avx2, convert_f32_mono_avx2
+};
+#endif
+
+/*** NEON *******************************************************************/
+
+#ifdef HAVE_CONVERT_NEON
+static void
+convert_s16_neon (guint8 * dest, const gint16 * src, guint samples,
+    gfloat scale)
+{
+  gint16 *d = (gint16 *) dest;
+  int16x8_t x;
+  int32x4_t lo, hi;
+  guint i;
+
+  for (i = 0; i + 8 <= samples; i += 8) {
+    x = vld1q_s16 (src + i);
+    lo = vcvtnq_s32_f32 (vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16
+                (vget_low_s16 (x))), scale));
+    hi = vcvtnq_s32_f32 (vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16
+                (vget_high_s16 (x))), scale));
+    vst1q_s16 (d + i, vcombine_s16 (vqmovn_s32 (lo), vqmovn_s32 (hi)));
+  }
+  convert_s16 ((guint8 *) (d + i), src + i, samples - i, scale);
+}
+
+static void
+convert_s16_mono_neon (guint8 * dest, const gint16 * src, guint samples,
+    gfloat scale)
+{
+  gint16 *d = (gint16 *) dest;
+  int32x4_t lo, hi;
+  guint i;
+
+  for (i = 0; i + 8 <= samples; i += 8) {
+    lo = vcvtnq_s32_f32 (vmulq_n_f32 (vcvtq_f32_s32 (vpaddlq_s16
+                (vld1q_s16 (src + 2 * i))), scale));
+    hi = vcvtnq_s32_f32 (vmulq_n_f32 (vcvtq_f32_s32 (vpaddlq_s16
+                (vld1q_s16 (src + 2 * i + 8))), scale));
+    vst1q_s16 (d + i, vcombine_s16 (vqmovn_s32 (lo), vqmovn_s32 (hi)));
+  }
+  convert_s16_mono ((guint8 *) (d + i), src + 2 * i, samples - i, scale);
+}
+
+static void
+convert_f32_neon (guint8 * dest, const gint16 * src, guint samples,
+    gfloat scale)
+{
+  gfloat *d = (gfloat *) dest;
+  int16x8_t x;
+  guint i;
+
+  for (i = 0; i + 8 <= samples; i += 8) {
+    x = vld1q_s16 (src + i);
+    vst1q_f32 (d + i, vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16
+                (vget_low_s16 (x))), scale));
+    vst1q_f32 (d + i + 4, vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16
+                (vget_high_s16 (x))), scale));
+  }
+  convert_f32 ((guint8 *) (d + i), src + i, samples - i, scale);
+}
+
+static void
+convert_f32_mono_neon (guint8 * dest, const gint16 * src, guint samples,
+    gfloat scale)
+{
+  gfloat *d = (gfloat *) dest;
+  guint i;
+
+  for (i = 0; i + 4 <= samples; i += 4)
+    vst1q_f32 (d + i, vmulq_n_f32 (vcvtq_f32_s32 (vpaddlq_s16 (vld1q_s16
+                    (src + 2 * i))), scale));
+  convert_f32_mono ((guint8 *) (d + i), src + 2 * i, samples - i, scale);
+}
+
+/* NEON is part of the aarch64 baseline, no runtime check needed; its
+ * conversions saturate, so S32 could follow */
+static const GstSpotifyConvertImpl impl_neon = {
+  "neon",
+  convert_s16_neon, convert_s16_mono_neon,
+  convert_s32, convert_s32_mono,
+  convert_f32_neon, convert_f32_mono_neon
+};
+#endif
+
+/*
+ * Pick the kernels once per process.  GST_SPOTIFY_NO_SIMD in the
+ * environment forces the scalar ones, to compare or rule them out.
+ */
+static const GstSpotifyConvertImpl *
+gst_spotify_convert_get_impl (void)
+{
+  static gsize impl = 0;
+
+  if (g_once_init_enter (&impl)) {
+    const GstSpotifyConvertImpl *tmp = &impl_scalar;
+
+    if (g_getenv ("GST_SPOTIFY_NO_SIMD") == NULL) {
+#if defined (HAVE_CONVERT_X86)
+      __builtin_cpu_init ();
+      if (__builtin_cpu_supports ("avx2"))
+        tmp = &impl_avx2;
+      else if (__builtin_cpu_supports ("sse2"))
+        tmp = &impl_sse2;
+#elif defined (HAVE_CONVERT_NEON)
+      tmp = &impl_neon;
+#endif
+    }
+    g_once_init_leave (&impl, (gsize) tmp);
+  }
+
+  return (const GstSpotifyConvertImpl *) impl;
+}
+
+const gchar *
+gst_spotify_convert_get_impl_name (void)
+{
+  return gst_spotify_convert_get_impl ()->name;
+}
+
+static void
+gst_spotify_convert_select (GstSpotifyConvert * convert)
+{
+  const GstSpotifyConvertImpl *impl = gst_spotify_convert_get_impl ();
+  gboolean downmix = convert->out_channels != convert->in_channels;
+  gfloat scale = convert->gain;
+
+  /* downmixes average the left and right channel */
+  if (downmix)
+    scale *= 0.5f;
+
+  switch (convert->format) {
+    case GST_AUDIO_FORMAT_S16:
+      if (downmix)
+        convert->func = impl->s16_mono;
+      else if (convert->gain != 1.0)
+        convert->func = impl->s16;
+      else
+        convert->func = convert_copy;
+      break;
+    case GST_AUDIO_FORMAT_S32:
+      convert->func = downmix ? impl->s32_mono : impl->s32;
+      scale *= 65536.0f;
+      break;
+    case GST_AUDIO_FORMAT_F32:
+      convert->func = downmix ? impl->f32_mono : impl->f32;
+      scale /= 32768.0f;
+      break;
+    default:
+      g_assert_not_reached ();
+      break;
+  }
+  convert->scale = scale;
+}
+
+/*
+ * Set up @convert for @in_channels of S16 into @format with @out_channels,
+ * which is either @in_channels or 1, scaled by a linear @gain.  Returns
+ * FALSE for anything else.
+ */
+gboolean
+gst_spotify_convert_init (GstSpotifyConvert * convert, gint in_channels,
+    GstAudioFormat format, gint out_channels, gdouble gain)
+{
+  guint width;
+
+  if (in_channels < 1 || in_channels > 2)
+    return FALSE;
+  if (out_channels != in_channels && out_channels != 1)
+    return FALSE;
+
+  switch (format) {
+    case GST_AUDIO_FORMAT_S16:
+      width = sizeof (gint16);
+      break;
+    case GST_AUDIO_FORMAT_S32:
+      width = sizeof (gint32);
+      break;
+    case GST_AUDIO_FORMAT_F32:
+      width = sizeof (gfloat);
+      break;
+    default:
+      return FALSE;
+  }
+
+  convert->format = format;
+  convert->in_channels = in_channels;
+  convert->out_channels = out_channels;
+  convert->gain = gain;
+  convert->in_bpf = in_channels * sizeof (gint16);
+  convert->out_bpf = out_channels * width;
+  gst_spotify_convert_select (convert);
+
+  return TRUE;
+}
+
+void
+gst_spotify_convert_set_gain (GstSpotifyConvert * convert, gdouble gain)
+{
+  convert->gain = gain;
+  gst_spotify_convert_select (convert);
+}
+
+/* Output bytes for @in_size bytes of whole input frames */
+guint
+gst_spotify_convert_get_out_size (GstSpotifyConvert * convert, guint in_size)
+{
+  return in_size / convert->in_bpf * convert->out_bpf;
+}
+
+/* Converts the whole frames in @in_size bytes of @src.  Returns the number
+ * of bytes written to @dest. */
+guint
+gst_spotify_convert_process (GstSpotifyConvert * convert, guint8 * dest,
+    const guint8 * src, guint in_size)
+{
+  guint frames = in_size / convert->in_bpf;
+
+  convert->func (dest, (const gint16 *) src, frames * convert->out_channels,
+      convert->scale);
+
+  return frames * convert->out_bpf;
+}
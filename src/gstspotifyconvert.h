@@ -0,0 +1,77 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _GST_SPOTIFY_CONVERT_H_
+#define _GST_SPOTIFY_CONVERT_H_
+
+#include <gst/gst.h>
+#include <gst/audio/audio.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Conversion of the interleaved native endian S16 that libspotify delivers
+ * into the negotiated sample format, optionally downmixed from stereo to
+ * mono and scaled by a linear gain.  It runs while audio is copied out of
+ * the ring, so it costs no extra pass over the samples.  The sample rate is
+ * never changed.
+ *
+ * The kernels are picked once per process for the best instruction set
+ * the CPU supports, see gst_spotify_convert_get_impl_name().
+ */
+typedef struct _GstSpotifyConvert GstSpotifyConvert;
+
+/* Writes @samples output samples to @dest, each an input sample or, when
+ * downmixing, the sum of a stereo pair, multiplied by @scale */
+typedef void (*GstSpotifyConvertFunc) (guint8 * dest, const gint16 * src,
+                                       guint samples, gfloat scale);
+
+struct _GstSpotifyConvert
+{
+  GstAudioFormat format;
+  gint           in_channels;
+  gint           out_channels;
+  gdouble        gain;
+
+  /*< private >*/
+  GstSpotifyConvertFunc func;
+  gfloat         scale;
+  guint          in_bpf;
+  guint          out_bpf;
+};
+
+gboolean        gst_spotify_convert_init (GstSpotifyConvert * convert,
+                                          gint in_channels,
+                                          GstAudioFormat format,
+                                          gint out_channels,
+                                          gdouble gain);
+void            gst_spotify_convert_set_gain (GstSpotifyConvert * convert,
+                                              gdouble gain);
+
+guint           gst_spotify_convert_get_out_size (GstSpotifyConvert * convert,
+                                                  guint in_size);
+guint           gst_spotify_convert_process (GstSpotifyConvert * convert,
+                                             guint8 * dest,
+                                             const guint8 * src,
+                                             guint in_size);
+
+const gchar *   gst_spotify_convert_get_impl_name (void);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,499 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <glib/gstdio.h>
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "gstspotifypcmcache.h"
+
+#define PCM_CACHE_MAGIC        "GSTSPCM1"
+/* Grown by doubling from here, about 47 s of 44.1 kHz stereo */
+#define PCM_CACHE_MIN_CAPACITY (8 * 1024 * 1024)
+
+/* Start of a cache file, followed by the interleaved native endian S16 */
+typedef struct _GstSpotifyPcmCacheHeader
+{
+  gchar   magic[8];
+  guint32 rate;
+  guint32 channels;
+  guint64 length;
+  guint8  reserved[8];
+} GstSpotifyPcmCacheHeader;
+
+#define PCM_CACHE_HEADER_SIZE  sizeof (GstSpotifyPcmCacheHeader)
+
+struct _GstSpotifyPcmCache
+{
+  gint     refcount;
+  GMutex   lock;
+  GCond    cond;
+
+  gint     fd;
+  gchar    *path;
+  /* File being spooled to, NULL once it replaced the cache file */
+  gchar    *tmp_path;
+  guint8   *map;
+  gsize    map_size;
+
+  /* Bytes of PCM after the header */
+  guint64  length;
+  gint     rate;
+  gint     channels;
+  gboolean complete;
+  gboolean failed;
+  guint    kicks;
+};
+
+#ifdef HAVE_SYS_MMAN_H
+
+/* Anything unexpected is respooled, and replaced once that completes */
+static gboolean
+gst_spotify_pcm_cache_check_header (const GstSpotifyPcmCacheHeader * header,
+    off_t size)
+{
+  return memcmp (header->magic, PCM_CACHE_MAGIC, sizeof (header->magic)) == 0
+      && header->rate != 0 && header->channels >= 1 && header->channels <= 2
+      && header->length <= size - PCM_CACHE_HEADER_SIZE;
+}
+
+static gboolean
+gst_spotify_pcm_cache_map_complete (GstSpotifyPcmCache * cache)
+{
+  GstSpotifyPcmCacheHeader header;
+  struct stat st;
+  guint8 *map;
+  gint fd;
+
+  fd = g_open (cache->path, O_RDONLY, 0);
+  if (fd < 0)
+    return FALSE;
+
+  if (fstat (fd, &st) < 0 || st.st_size < (off_t) PCM_CACHE_HEADER_SIZE)
+    goto invalid;
+
+  map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED)
+    goto invalid;
+
+  memcpy (&header, map, sizeof (header));
+  if (!gst_spotify_pcm_cache_check_header (&header, st.st_size)) {
+    munmap (map, st.st_size);
+    goto invalid;
+  }
+
+  cache->fd = fd;
+  cache->map = map;
+  cache->map_size = st.st_size;
+  cache->length = header.length;
+  cache->rate = header.rate;
+  cache->channels = header.channels;
+  cache->complete = TRUE;
+
+  return TRUE;
+
+invalid:
+  close (fd);
+  return FALSE;
+}
+
+/* Allocate disk blocks for @len bytes at @offset.  A sparse file would
+ * only run out of space when a store to the mapping faults. */
+static gboolean
+gst_spotify_pcm_cache_allocate (gint fd, off_t offset, off_t len)
+{
+#ifdef HAVE_POSIX_FALLOCATE
+  gint err;
+
+  do {
+    err = posix_fallocate (fd, offset, len);
+  } while (err == EINTR);
+
+  if (err != 0) {
+    errno = err;
+    return FALSE;
+  }
+  return TRUE;
+#else
+  static const guint8 zeros[64 * 1024];
+  ssize_t written;
+
+  while (len > 0) {
+    written = pwrite (fd, zeros, MIN (len, (off_t) sizeof (zeros)), offset);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return FALSE;
+    }
+    offset += written;
+    len -= written;
+  }
+  return TRUE;
+#endif
+}
+
+/* Make room for @size bytes of file, header included.  Called with the
+ * lock held, so readers never see the old mapping go away. */
+static gboolean
+gst_spotify_pcm_cache_reserve (GstSpotifyPcmCache * cache, guint64 size)
+{
+  gsize new_size = MAX (cache->map_size, PCM_CACHE_MIN_CAPACITY);
+  guint8 *map;
+
+  if (size <= cache->map_size)
+    return TRUE;
+
+  while (new_size < size)
+    new_size *= 2;
+
+  /* ENOSPC fails the spool here, before the mapping covers the blocks */
+  if (!gst_spotify_pcm_cache_allocate (cache->fd, cache->map_size,
+          new_size - cache->map_size))
+    return FALSE;
+
+  map = mmap (NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+      cache->fd, 0);
+  if (map == MAP_FAILED)
+    return FALSE;
+
+  if (cache->map)
+    munmap (cache->map, cache->map_size);
+  cache->map = map;
+  cache->map_size = new_size;
+
+  return TRUE;
+}
+
+#endif /* HAVE_SYS_MMAN_H */
+
+/*
+ * Open the cache file for @key in the directory @location, or start
+ * spooling a new one.  Returns NULL when neither is possible.
+ */
+GstSpotifyPcmCache *
+gst_spotify_pcm_cache_open (const gchar * location, const gchar * key)
+{
+#ifdef HAVE_SYS_MMAN_H
+  GstSpotifyPcmCache *cache;
+  gchar *name;
+
+  g_return_val_if_fail (location != NULL && key != NULL, NULL);
+
+  cache = g_new0 (GstSpotifyPcmCache, 1);
+  cache->refcount = 1;
+  cache->fd = -1;
+  g_mutex_init (&cache->lock);
+  g_cond_init (&cache->cond);
+
+  name = g_strconcat (key, ".pcm", NULL);
+  cache->path = g_build_filename (location, name, NULL);
+  g_free (name);
+
+  if (gst_spotify_pcm_cache_map_complete (cache))
+    return cache;
+
+  /* Spooled under a unique name, elements may share the location */
+  if (g_mkdir_with_parents (location, 0755) < 0)
+    goto failed;
+  cache->tmp_path = g_strconcat (cache->path, ".XXXXXX", NULL);
+  cache->fd = g_mkstemp (cache->tmp_path);
+  if (cache->fd < 0) {
+    g_free (cache->tmp_path);
+    cache->tmp_path = NULL;
+    goto failed;
+  }
+
+  return cache;
+
+failed:
+  gst_spotify_pcm_cache_unref (cache);
+  return NULL;
+#else
+  return NULL;
+#endif
+}
+
+/*
+ * Whether a complete cache file for @key is in @location.  Unlike
+ * gst_spotify_pcm_cache_open() this only looks, it creates nothing.
+ */
+gboolean
+gst_spotify_pcm_cache_exists (const gchar * location, const gchar * key)
+{
+#ifdef HAVE_SYS_MMAN_H
+  GstSpotifyPcmCacheHeader header;
+  struct stat st;
+  gchar *name, *path;
+  gboolean res = FALSE;
+  gint fd;
+
+  g_return_val_if_fail (location != NULL && key != NULL, FALSE);
+
+  name = g_strconcat (key, ".pcm", NULL);
+  path = g_build_filename (location, name, NULL);
+  g_free (name);
+  fd = g_open (path, O_RDONLY, 0);
+  g_free (path);
+  if (fd < 0)
+    return FALSE;
+
+  if (fstat (fd, &st) == 0 && st.st_size >= (off_t) PCM_CACHE_HEADER_SIZE &&
+      read (fd, &header, sizeof (header)) == sizeof (header))
+    res = gst_spotify_pcm_cache_check_header (&header, st.st_size);
+  close (fd);
+
+  return res;
+#else
+  return FALSE;
+#endif
+}
+
+GstSpotifyPcmCache *
+gst_spotify_pcm_cache_ref (GstSpotifyPcmCache * cache)
+{
+  g_atomic_int_inc (&cache->refcount);
+  return cache;
+}
+
+/* The last reference unmaps the file; a spool that never completed can't
+ * be resumed and is removed */
+void
+gst_spotify_pcm_cache_unref (GstSpotifyPcmCache * cache)
+{
+  if (cache == NULL || !g_atomic_int_dec_and_test (&cache->refcount))
+    return;
+
+#ifdef HAVE_SYS_MMAN_H
+  if (cache->map)
+    munmap (cache->map, cache->map_size);
+  if (cache->fd >= 0)
+    close (cache->fd);
+#endif
+  if (cache->tmp_path) {
+    g_unlink (cache->tmp_path);
+    g_free (cache->tmp_path);
+  }
+
+  g_mutex_clear (&cache->lock);
+  g_cond_clear (&cache->cond);
+  g_free (cache->path);
+  g_free (cache);
+}
+
+gboolean
+gst_spotify_pcm_cache_is_complete (GstSpotifyPcmCache * cache)
+{
+  gboolean complete;
+
+  g_mutex_lock (&cache->lock);
+  complete = cache->complete;
+  g_mutex_unlock (&cache->lock);
+
+  return complete;
+}
+
+/* FALSE until the format is known from the first write */
+gboolean
+gst_spotify_pcm_cache_get_format (GstSpotifyPcmCache * cache, gint * rate,
+    gint * channels)
+{
+  gboolean res;
+
+  g_mutex_lock (&cache->lock);
+  res = cache->rate > 0;
+  if (res) {
+    *rate = cache->rate;
+    *channels = cache->channels;
+  }
+  g_mutex_unlock (&cache->lock);
+
+  return res;
+}
+
+guint64
+gst_spotify_pcm_cache_get_length (GstSpotifyPcmCache * cache)
+{
+  guint64 length;
+
+  g_mutex_lock (&cache->lock);
+  length = cache->length;
+  g_mutex_unlock (&cache->lock);
+
+  return length;
+}
+
+/*
+ * Append @len bytes of PCM.  A track is spooled in one format only; a
+ * write in another one, or one whose disk space can't be reserved, fails
+ * the spool for good.
+ */
+gboolean
+gst_spotify_pcm_cache_write (GstSpotifyPcmCache * cache, gint rate,
+    gint channels, const guint8 * data, guint len)
+{
+  gboolean res = FALSE;
+
+  g_mutex_lock (&cache->lock);
+  if (cache->complete || cache->failed)
+    goto done;
+
+  if (cache->rate == 0) {
+    cache->rate = rate;
+    cache->channels = channels;
+  } else if (rate != cache->rate || channels != cache->channels) {
+    goto failed;
+  }
+
+#ifdef HAVE_SYS_MMAN_H
+  if (!gst_spotify_pcm_cache_reserve (cache,
+          PCM_CACHE_HEADER_SIZE + cache->length + len))
+    goto failed;
+#endif
+
+  memcpy (cache->map + PCM_CACHE_HEADER_SIZE + cache->length, data, len);
+  cache->length += len;
+  g_cond_broadcast (&cache->cond);
+  res = TRUE;
+
+done:
+  g_mutex_unlock (&cache->lock);
+  return res;
+
+failed:
+  cache->failed = TRUE;
+  g_cond_broadcast (&cache->cond);
+  goto done;
+}
+
+/* The whole track was written, store it as the cache file of its key */
+gboolean
+gst_spotify_pcm_cache_finish (GstSpotifyPcmCache * cache)
+{
+  GstSpotifyPcmCacheHeader header;
+  gboolean res = FALSE;
+
+  g_mutex_lock (&cache->lock);
+  if (cache->complete || cache->failed || cache->rate == 0) {
+    res = cache->complete;
+    goto done;
+  }
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, PCM_CACHE_MAGIC, sizeof (header.magic));
+  header.rate = cache->rate;
+  header.channels = cache->channels;
+  header.length = cache->length;
+
+#ifdef HAVE_SYS_MMAN_H
+  memcpy (cache->map, &header, sizeof (header));
+
+  /* Drop the slack of the last reservation, nothing reads past length */
+  if (ftruncate (cache->fd, PCM_CACHE_HEADER_SIZE + cache->length) < 0 ||
+      g_rename (cache->tmp_path, cache->path) < 0) {
+    cache->failed = TRUE;
+    goto done;
+  }
+#endif
+
+  g_free (cache->tmp_path);
+  cache->tmp_path = NULL;
+  cache->complete = TRUE;
+  res = TRUE;
+
+done:
+  g_cond_broadcast (&cache->cond);
+  g_mutex_unlock (&cache->lock);
+  return res;
+}
+
+/* Kicks so far.  Read it before checking whatever a kick signals, and
+ * pass it to gst_spotify_pcm_cache_wait(). */
+guint
+gst_spotify_pcm_cache_get_kicks (GstSpotifyPcmCache * cache)
+{
+  guint res;
+
+  g_mutex_lock (&cache->lock);
+  res = cache->kicks;
+  g_mutex_unlock (&cache->lock);
+
+  return res;
+}
+
+/*
+ * Wait until @length bytes are available, the spool ended or failed,
+ * @end_time (monotonic, -1 for none) passed or the cache was kicked after
+ * @kicks was read.  Returns the available length.
+ */
+guint64
+gst_spotify_pcm_cache_wait (GstSpotifyPcmCache * cache, guint64 length,
+    gint64 end_time, guint kicks)
+{
+  guint64 res;
+
+  g_mutex_lock (&cache->lock);
+  while (cache->length < length && !cache->complete && !cache->failed &&
+      cache->kicks == kicks) {
+    if (end_time < 0)
+      g_cond_wait (&cache->cond, &cache->lock);
+    else if (!g_cond_wait_until (&cache->cond, &cache->lock, end_time))
+      break;
+  }
+  res = cache->length;
+  g_mutex_unlock (&cache->lock);
+
+  return res;
+}
+
+/* Hands the available part of @len bytes at @offset to @func, returns how
+ * many that were */
+guint
+gst_spotify_pcm_cache_read_func (GstSpotifyPcmCache * cache, guint64 offset,
+    guint len, GstSpotifyRingReadFunc func, gpointer user_data)
+{
+  g_mutex_lock (&cache->lock);
+  if (offset >= cache->length)
+    len = 0;
+  else
+    len = MIN (len, cache->length - offset);
+  if (len > 0)
+    func (cache->map + PCM_CACHE_HEADER_SIZE + offset, len, user_data);
+  g_mutex_unlock (&cache->lock);
+
+  return len;
+}
+
+void
+gst_spotify_pcm_cache_kick (GstSpotifyPcmCache * cache)
+{
+  g_mutex_lock (&cache->lock);
+  cache->kicks++;
+  g_cond_broadcast (&cache->cond);
+  g_mutex_unlock (&cache->lock);
+}
@@ -0,0 +1,71 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _GST_SPOTIFY_PCM_CACHE_H_
+#define _GST_SPOTIFY_PCM_CACHE_H_
+
+#include <gst/gst.h>
+
+#include "gstspotifyring.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Memory mapped file of the PCM libspotify delivered for one track, for
+ * serving random access reads.  A complete file is simply mapped; otherwise
+ * the delivery thread spools into a temporary file that readers can follow
+ * while it grows, and which replaces the cache file once the whole track
+ * has been written.  Reads and writes take the cache's lock.
+ */
+typedef struct _GstSpotifyPcmCache GstSpotifyPcmCache;
+
+GstSpotifyPcmCache *gst_spotify_pcm_cache_open (const gchar * location,
+                                                const gchar * key);
+gboolean        gst_spotify_pcm_cache_exists (const gchar * location,
+                                              const gchar * key);
+GstSpotifyPcmCache *gst_spotify_pcm_cache_ref (GstSpotifyPcmCache * cache);
+void            gst_spotify_pcm_cache_unref (GstSpotifyPcmCache * cache);
+
+gboolean        gst_spotify_pcm_cache_is_complete (GstSpotifyPcmCache * cache);
+gboolean        gst_spotify_pcm_cache_get_format (GstSpotifyPcmCache * cache,
+                                                  gint * rate,
+                                                  gint * channels);
+guint64         gst_spotify_pcm_cache_get_length (GstSpotifyPcmCache * cache);
+
+/* writer side */
+gboolean        gst_spotify_pcm_cache_write (GstSpotifyPcmCache * cache,
+                                             gint rate, gint channels,
+                                             const guint8 * data, guint len);
+gboolean        gst_spotify_pcm_cache_finish (GstSpotifyPcmCache * cache);
+
+/* reader side */
+guint           gst_spotify_pcm_cache_get_kicks (GstSpotifyPcmCache * cache);
+guint64         gst_spotify_pcm_cache_wait (GstSpotifyPcmCache * cache,
+                                            guint64 length, gint64 end_time,
+                                            guint kicks);
+guint           gst_spotify_pcm_cache_read_func (GstSpotifyPcmCache * cache,
+                                                 guint64 offset, guint len,
+                                                 GstSpotifyRingReadFunc func,
+                                                 gpointer user_data);
+
+/* any thread, wakes up a reader blocked in gst_spotify_pcm_cache_wait() */
+void            gst_spotify_pcm_cache_kick (GstSpotifyPcmCache * cache);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,333 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "gstspotifyring.h"
+
+struct _GstSpotifyRing
+{
+  guint8  *data;
+  guint   mask;
+  guint   limit;
+
+  /* Free running positions, only the owning side stores to each */
+  gint    read_pos;
+  gint    write_pos;
+
+  /* Producer published start of valid data, and the consumer's copy of
+   * the generation it last skipped to */
+  gint    mark_pos;
+  gint    mark_gen;
+  gint    skipped_gen;
+
+  /* Same for clears, which any thread can ask for but only the consumer
+   * carries out */
+  gint    clear_pos;
+  gint    clear_gen;
+  gint    cleared_gen;
+
+  /* Level the consumer is sleeping for, 0 if it is not sleeping */
+  gint    wanted;
+  gint    kicks;
+  GMutex  lock;
+  GCond   cond;
+};
+
+/*
+ * @limit is the maximum number of queued bytes.  The storage is rounded up
+ * to a power of two so positions can wrap freely.
+ */
+GstSpotifyRing *
+gst_spotify_ring_new (guint limit)
+{
+  GstSpotifyRing *ring;
+  guint size = 1;
+
+  g_return_val_if_fail (limit > 0 && limit <= G_MAXINT / 2 + 1, NULL);
+
+  while (size < limit)
+    size <<= 1;
+
+  ring = g_new0 (GstSpotifyRing, 1);
+  ring->data = g_malloc (size);
+  ring->mask = size - 1;
+  ring->limit = limit;
+  g_mutex_init (&ring->lock);
+  g_cond_init (&ring->cond);
+
+  return ring;
+}
+
+void
+gst_spotify_ring_free (GstSpotifyRing * ring)
+{
+  if (ring == NULL)
+    return;
+
+  g_mutex_clear (&ring->lock);
+  g_cond_clear (&ring->cond);
+  g_free (ring->data);
+  g_free (ring);
+}
+
+guint
+gst_spotify_ring_get_limit (GstSpotifyRing * ring)
+{
+  return ring->limit;
+}
+
+/* Read position once a pending clear is carried out */
+static guint
+gst_spotify_ring_get_clear_pos (GstSpotifyRing * ring, guint read_pos)
+{
+  guint clear_pos;
+
+  if (G_LIKELY (g_atomic_int_get (&ring->clear_gen) ==
+          g_atomic_int_get (&ring->cleared_gen)))
+    return read_pos;
+
+  clear_pos = g_atomic_int_get (&ring->clear_pos);
+  return (gint) (clear_pos - read_pos) > 0 ? clear_pos : read_pos;
+}
+
+/* Consumer side: carry out a clear asked for by another thread */
+static void
+gst_spotify_ring_apply_clear (GstSpotifyRing * ring)
+{
+  gint gen = g_atomic_int_get (&ring->clear_gen);
+
+  if (G_LIKELY (gen == ring->cleared_gen))
+    return;
+
+  g_atomic_int_set (&ring->read_pos,
+      gst_spotify_ring_get_clear_pos (ring, ring->read_pos));
+  g_atomic_int_set (&ring->cleared_gen, gen);
+}
+
+/* Queued bytes, not counting those a pending clear drops */
+guint
+gst_spotify_ring_get_level (GstSpotifyRing * ring)
+{
+  guint write_pos = g_atomic_int_get (&ring->write_pos);
+  guint read_pos = g_atomic_int_get (&ring->read_pos);
+
+  return write_pos - gst_spotify_ring_get_clear_pos (ring, read_pos);
+}
+
+/* Free running count of bytes written, any thread */
+guint
+gst_spotify_ring_get_write_offset (GstSpotifyRing * ring)
+{
+  return g_atomic_int_get (&ring->write_pos);
+}
+
+/* Free running count of bytes read or dropped, any thread */
+guint
+gst_spotify_ring_get_read_offset (GstSpotifyRing * ring)
+{
+  return gst_spotify_ring_get_clear_pos (ring,
+      g_atomic_int_get (&ring->read_pos));
+}
+
+/* Storage dropped by a pending clear is only free once the consumer has
+ * moved past it */
+guint
+gst_spotify_ring_get_space (GstSpotifyRing * ring)
+{
+  guint level = g_atomic_int_get (&ring->write_pos) -
+      g_atomic_int_get (&ring->read_pos);
+
+  return level < ring->limit ? ring->limit - level : 0;
+}
+
+/* Returns the number of bytes written, which is less than @len when the
+ * ring does not have room for all of it */
+guint
+gst_spotify_ring_write (GstSpotifyRing * ring, const guint8 * data, guint len)
+{
+  guint write_pos, offset, chunk;
+  gint wanted;
+
+  len = MIN (len, gst_spotify_ring_get_space (ring));
+  if (len == 0)
+    return 0;
+
+  write_pos = ring->write_pos;
+  offset = write_pos & ring->mask;
+  chunk = MIN (len, ring->mask + 1 - offset);
+  memcpy (ring->data + offset, data, chunk);
+  memcpy (ring->data, data + chunk, len - chunk);
+
+  /* Publish the data, then see if the consumer is waiting for it.  Both
+   * atomics are full barriers, which pairs with gst_spotify_ring_wait() */
+  g_atomic_int_set (&ring->write_pos, write_pos + len);
+
+  wanted = g_atomic_int_get (&ring->wanted);
+  if (G_UNLIKELY (wanted > 0 &&
+          gst_spotify_ring_get_level (ring) >= (guint) wanted)) {
+    g_mutex_lock (&ring->lock);
+    g_cond_signal (&ring->cond);
+    g_mutex_unlock (&ring->lock);
+  }
+
+  return len;
+}
+
+/* Returns the number of bytes read, at most the current level */
+guint
+gst_spotify_ring_read (GstSpotifyRing * ring, guint8 * data, guint len)
+{
+  guint read_pos, offset, chunk;
+
+  gst_spotify_ring_apply_clear (ring);
+  len = MIN (len, gst_spotify_ring_get_level (ring));
+  if (len == 0)
+    return 0;
+
+  read_pos = ring->read_pos;
+  offset = read_pos & ring->mask;
+  chunk = MIN (len, ring->mask + 1 - offset);
+  memcpy (data, ring->data + offset, chunk);
+  memcpy (data + chunk, ring->data, len - chunk);
+
+  g_atomic_int_set (&ring->read_pos, read_pos + len);
+
+  return len;
+}
+
+/* Like gst_spotify_ring_read(), but hands the data to @func in place
+ * instead of copying it, in two runs where the storage wraps.  The split
+ * need not fall on a frame boundary, @func has to carry partial data
+ * over. */
+guint
+gst_spotify_ring_read_func (GstSpotifyRing * ring, guint len,
+    GstSpotifyRingReadFunc func, gpointer user_data)
+{
+  guint read_pos, offset, chunk;
+
+  gst_spotify_ring_apply_clear (ring);
+  len = MIN (len, gst_spotify_ring_get_level (ring));
+  if (len == 0)
+    return 0;
+
+  read_pos = ring->read_pos;
+  offset = read_pos & ring->mask;
+  chunk = MIN (len, ring->mask + 1 - offset);
+  func (ring->data + offset, chunk, user_data);
+  if (len > chunk)
+    func (ring->data, len - chunk, user_data);
+
+  g_atomic_int_set (&ring->read_pos, read_pos + len);
+
+  return len;
+}
+
+/* Producer side: mark everything written so far as stale, the consumer
+ * drops it in its next gst_spotify_ring_skip_to_mark() */
+void
+gst_spotify_ring_mark (GstSpotifyRing * ring)
+{
+  g_atomic_int_set (&ring->mark_pos, ring->write_pos);
+  g_atomic_int_inc (&ring->mark_gen);
+}
+
+/* Consumer side: drop data written before the last mark.  Returns TRUE if
+ * a new mark was found. */
+gboolean
+gst_spotify_ring_skip_to_mark (GstSpotifyRing * ring)
+{
+  gint gen = g_atomic_int_get (&ring->mark_gen);
+  guint mark_pos, read_pos;
+
+  gst_spotify_ring_apply_clear (ring);
+  if (gen == ring->skipped_gen)
+    return FALSE;
+
+  mark_pos = g_atomic_int_get (&ring->mark_pos);
+  read_pos = ring->read_pos;
+  /* Never move backwards over data that was already read */
+  if ((gint) (mark_pos - read_pos) > 0)
+    g_atomic_int_set (&ring->read_pos, mark_pos);
+  ring->skipped_gen = gen;
+
+  return TRUE;
+}
+
+/* Any thread: drop everything queued so far.  The consumer carries it
+ * out on its next call, until then the data is only hidden from the
+ * level. */
+void
+gst_spotify_ring_clear (GstSpotifyRing * ring)
+{
+  g_atomic_int_set (&ring->clear_pos, g_atomic_int_get (&ring->write_pos));
+  g_atomic_int_inc (&ring->clear_gen);
+}
+
+/* Kicks so far.  Read it before checking whatever a kick signals, and
+ * pass it to gst_spotify_ring_wait(), so that a kick in between is not
+ * lost. */
+guint
+gst_spotify_ring_get_kicks (GstSpotifyRing * ring)
+{
+  return g_atomic_int_get (&ring->kicks);
+}
+
+/*
+ * Sleep until at least @level bytes are queued, gst_spotify_ring_kick() is
+ * called after @kicks was read or @end_time (monotonic, -1 for none)
+ * passes.  Returns TRUE if the level was reached.
+ */
+gboolean
+gst_spotify_ring_wait (GstSpotifyRing * ring, guint level, gint64 end_time,
+    guint kicks)
+{
+  gboolean res;
+
+  level = CLAMP (level, 1, ring->limit);
+
+  gst_spotify_ring_apply_clear (ring);
+
+  g_mutex_lock (&ring->lock);
+  g_atomic_int_set (&ring->wanted, level);
+  while (!(res = gst_spotify_ring_get_level (ring) >= level) &&
+      kicks == (guint) ring->kicks) {
+    if (end_time < 0)
+      g_cond_wait (&ring->cond, &ring->lock);
+    else if (!g_cond_wait_until (&ring->cond, &ring->lock, end_time))
+      break;
+  }
+  g_atomic_int_set (&ring->wanted, 0);
+  res = gst_spotify_ring_get_level (ring) >= level;
+  g_mutex_unlock (&ring->lock);
+
+  return res;
+}
+
+void
+gst_spotify_ring_kick (GstSpotifyRing * ring)
+{
+  g_mutex_lock (&ring->lock);
+  g_atomic_int_inc (&ring->kicks);
+  g_cond_broadcast (&ring->cond);
+  g_mutex_unlock (&ring->lock);
+}
@@ -0,0 +1,71 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _GST_SPOTIFY_RING_H_
+#define _GST_SPOTIFY_RING_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Single-producer/single-consumer byte ring used to hand PCM from the
+ * libspotify delivery thread to the streaming thread.  Reads and writes
+ * never take a lock; the consumer only sleeps on the ring's condition when
+ * it is starved, and the producer only signals it when a sleeping consumer
+ * can be satisfied.
+ */
+typedef struct _GstSpotifyRing GstSpotifyRing;
+
+/* Called with contiguous runs of queued data, in order */
+typedef void (*GstSpotifyRingReadFunc) (const guint8 * data, guint len,
+                                        gpointer user_data);
+
+GstSpotifyRing *gst_spotify_ring_new (guint limit);
+void            gst_spotify_ring_free (GstSpotifyRing * ring);
+
+guint           gst_spotify_ring_get_limit (GstSpotifyRing * ring);
+guint           gst_spotify_ring_get_level (GstSpotifyRing * ring);
+guint           gst_spotify_ring_get_space (GstSpotifyRing * ring);
+guint           gst_spotify_ring_get_write_offset (GstSpotifyRing * ring);
+guint           gst_spotify_ring_get_read_offset (GstSpotifyRing * ring);
+
+/* producer side */
+guint           gst_spotify_ring_write (GstSpotifyRing * ring,
+                                        const guint8 * data, guint len);
+void            gst_spotify_ring_mark (GstSpotifyRing * ring);
+
+/* consumer side */
+guint           gst_spotify_ring_read (GstSpotifyRing * ring,
+                                       guint8 * data, guint len);
+guint           gst_spotify_ring_read_func (GstSpotifyRing * ring, guint len,
+                                            GstSpotifyRingReadFunc func,
+                                            gpointer user_data);
+gboolean        gst_spotify_ring_skip_to_mark (GstSpotifyRing * ring);
+guint           gst_spotify_ring_get_kicks (GstSpotifyRing * ring);
+gboolean        gst_spotify_ring_wait (GstSpotifyRing * ring, guint level,
+                                       gint64 end_time, guint kicks);
+
+/* any thread; clears are carried out by the consumer */
+void            gst_spotify_ring_clear (GstSpotifyRing * ring);
+/* any thread, wakes up a consumer blocked in gst_spotify_ring_wait() */
+void            gst_spotify_ring_kick (GstSpotifyRing * ring);
+
+G_END_DECLS
+
+#endif
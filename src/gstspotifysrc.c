@@ -29,49 +29,274 @@
 #include <libspotify/api.h>
 
 #include <string.h>
-#include <unistd.h>
 #include <stdio.h>
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
 
 #include "gstspotifysrc.h"
+#include "gstspotifyring.h"
+#include "gstspotifyconvert.h"
+#include "gstspotifypcmcache.h"
+#include "gstspotifyvorbis.h"
 
 typedef struct _GstSpotifySessionContext
 {
-  GCond          cond;
+  GCond          event_cond;
   GThread        *thread;
   GMutex         mutex;
+
+  /* Main loop wakeups; a separate lock since libspotify notifies from
+   * inside sp_session_process_events() as well as from its own threads */
+  GMutex         notify_lock;
+  GCond          cond;
+  gboolean       notify_pending;
+  guint64        loop_iterations;
+  guint64        loop_wakeups;
+
   sp_session     *session;
+  gchar          *key;
+  gint           refcount;
+  GWeakRef       src;
+  gint64         linger_deadline;
+  guint8         appkey[321];
   gboolean       destroy;
   gboolean       logged_in;
+  gboolean       logging_in;
+  sp_error       login_error;
   gboolean       logged_out;
   gboolean       play_token_lost;
-  gboolean       end_of_track;
+  /* Element messages the main loop posts once it dropped the mutex */
+  gint           messages_pending;
+  /* Set from libspotify's audio thread, the main loop moves on to the
+   * next track under the context mutex */
+  gint           end_of_track;
   sp_error       connection_error;
   sp_error       streaming_error;
+  gchar          *cache_location;
+  gchar          *settings_location;
+  /* Credentials of the current lease, to log in again with; an account
+   * from the accounts property never uses the element's blob */
+  gchar          *user;
+  gchar          *password;
+  gboolean       account;
+  /* CPU the main loop thread runs on, -1 when not pinned */
+  gint           cpu;
 } GstSpotifySessionContext;
 
+/* Element settings that a session is created and logged in with */
+typedef struct _GstSpotifySessionConfig
+{
+  const gchar    *user;
+  const gchar    *password;
+  const gchar    *credentials_blob;
+  gboolean       remember_me;
+  const gchar    *appkey_file;
+  const gchar    *cache_location;
+  const gchar    *settings_location;
+  guint          cache_size;
+  GstSpotifyBitrate bitrate;
+  gboolean       volume_normalization;
+  GstSpotifyConnectionType connection_type;
+  gboolean       sync_over_mobile;
+  guint          login_timeout;
+  /* "user:password" entries leased from instead of user and password */
+  gchar          **accounts;
+  gboolean       session_affinity;
+} GstSpotifySessionConfig;
+
+/* Track metadata, cached by track link across sessions */
+typedef struct _GstSpotifyTrackInfo
+{
+  gchar          *link;
+  gchar          *title;
+  gchar          **artists;
+  gchar          *album;
+  gint64         duration;
+  gboolean       available;
+} GstSpotifyTrackInfo;
+
+/* Track requested through the prefetch action, waiting for its metadata,
+ * then for its message to be posted */
+typedef struct _GstSpotifySrcWarmup
+{
+  gchar     *uri;
+  sp_track  *track;
+  gboolean  loaded;
+  guint     pending;
+} GstSpotifySrcWarmup;
+
+#ifdef HAVE_VORBISENC
+/* Start of a buffer fed to the encoder, packets are timed by these */
+typedef struct _GstSpotifySrcVorbisChunk
+{
+  guint64      granulepos;
+  GstClockTime timestamp;
+} GstSpotifySrcVorbisChunk;
+#endif
+
+/* What create() has to do about a session failure, worst last */
+enum
+{
+  GST_SPOTIFY_SRC_RECOVER_NONE,
+  /* Reload unless audio arrives again within load-timeout */
+  GST_SPOTIFY_SRC_RECOVER_STALLED,
+  GST_SPOTIFY_SRC_RECOVER_NOW,
+  GST_SPOTIFY_SRC_RECOVER_FATAL
+};
+
+/* Output position while converting out of the ring */
+typedef struct _GstSpotifySrcConvertRun
+{
+  GstSpotifyConvert *convert;
+  guint8    *dest;
+  /* A frame split where the ring storage wraps */
+  guint     bpf;
+  guint     n_partial;
+  guint8    partial[4];
+} GstSpotifySrcConvertRun;
+
+/* Ring offset at which the next track's audio starts */
+typedef struct _GstSpotifySrcBoundary
+{
+  guint     offset;
+  gint64    duration;
+  GstTagList *tags;
+} GstSpotifySrcBoundary;
+
 struct _GstSpotifySrcPrivate
 {
-  GCond        cond;
   GMutex       mutex;
-  GQueue       *queue;
+  GstSpotifyRing *ring;
 
   GstCaps   *caps;
   gint64    size;
   guint64   max_bytes;
+  GstClockTime max_time;
+  gdouble   low_watermark;
+  gdouble   high_watermark;
+  gboolean  bulk;
   gchar     *user;
   gchar     *pass;
+  /* Also updated from libspotify, protected by the object lock */
+  gchar     *credentials_blob;
+  /* Set from libspotify when the blob changed, notified from our own
+   * threads, atomic */
+  gint      credentials_changed;
+  gboolean  remember_me;
   gchar     *uri;
   gchar     *appkey_file;
+  gchar     *cache_location;
+  gchar     *settings_location;
+  gchar     *pcm_cache_location;
+  guint     cache_size;
+  GstSpotifyBitrate bitrate;
+  gboolean  volume_normalization;
+  GstSpotifyOutputFormat output_format;
+  gdouble   gain;
+  /* Applied to a running session too, protected by mutex */
+  GstSpotifyConnectionType connection_type;
+  gboolean  sync_over_mobile;
+  guint     login_timeout;
+  guint     load_timeout;
+  guint     session_linger;
+  gchar     **accounts;
+  gboolean  session_affinity;
+  GstClockTime buffer_duration;
+  guint     block_size;
+  guint     low_level;
+  guint     high_level;
+
+  /* Format libspotify delivers, changed by the delivery thread only while
+   * the ring is empty and read atomically */
+  gint     rate;
+  gint     channels;
+  gint     format_changed;
+  /* Negotiated output, streaming thread only */
+  GstSpotifyConvert convert;
+#ifdef HAVE_VORBISENC
+  gfloat    vorbis_quality;
+  /* Set while encoding, fed from the converter in F32 */
+  GstSpotifyVorbis *vorbis;
+  GQueue    vorbis_packets;
+  GQueue    vorbis_chunks;
+  guint64   vorbis_fed;
+  gboolean  vorbis_headers_pending;
+  gboolean  vorbis_eos;
+#endif
+
+  /* Shared with the delivery thread, accessed atomically */
+  gint     flushing;
+  /* Set by unlock() and stop(), makes session waits for logging in and
+   * loading give up, atomic */
+  gint     cancel;
+  gint     is_eos;
+  gint     is_full;
+  /* Last seek requested, and the last one libspotify has flushed for */
+  gint     seek_seqnum;
+  gint     delivery_seqnum;
+
+  /* Written by the streaming thread, read atomically by queries */
+  gint     buffering;
+  gint     buffering_percent;
+
+  /* Underruns libspotify has not been told about yet, atomic */
+  gint     unreported_stutter;
+
+  /* Raised by session callbacks, cleared by the streaming thread, atomic */
+  gint     recover;
+  guint    max_reconnects;
+
+  /* Counters for the stats property, accessed atomically */
+  gint     buffers_pushed;
+  gint     underruns;
+  gint     deliveries;
+  gint     deliveries_dropped;
+  gint     deliveries_rejected;
+  gint     reconnects;
+  gint     tracks_delivered;
+  /* Monotonic time of the last start, protected by mutex */
+  gint64   start_time;
 
-  gboolean flushing;
   gboolean started;
-  gboolean is_eos;
   gboolean is_first_seek;
-  guint64  queued_bytes;
+  gboolean live_resync;
+  guint     seek_timeout;
+  gboolean  seek_pending;
+  gint64    seek_start;
+  GstClockTime seek_latency;
+  /* Times create() waited for data, streaming thread only */
   guint64  stutter;
+  GstClockTime login_latency;
+  GstClockTime load_latency;
+  /* Stored under the object lock, for the buffering query */
   GstClockTime buffer_timestamp;
+  /* Position in the current track, where a reconnect resumes */
+  GstClockTime track_position;
+  /* Tags of the track now starting, pushed with its first buffer */
+  GstTagList *tags;
 
   GstSpotifySessionContext *spotify_context;
+  /* Logs in and loads for an asynchronous start, joined by stop() */
+  GThread   *start_thread;
+  /* Track spooled for random access while started, replaced under the
+   * object lock since the delivery thread takes its own reference */
+  GstSpotifyPcmCache *pcm_cache;
+
+  /* Play queue, also used from libspotify callbacks on the session thread,
+   * which hold the context mutex.  Never held while waiting on a session. */
+  GMutex    tracks_lock;
+  GPtrArray *tracks;
+  guint     track_index;
+  gint      prefetched;
+  gchar     *next_uri;
+  gboolean  switch_pending;
+  GQueue    boundaries;
+  gint      n_boundaries;
+  GQueue    warmups;
+  GQueue    warmups_done;
 
   GDestroyNotify notify;
 };
@@ -79,10 +304,65 @@ struct _GstSpotifySrcPrivate
 GST_DEBUG_CATEGORY_STATIC (spotify_src_debug);
 #define GST_CAT_DEFAULT spotify_src_debug
 
+/*
+ * Queue events for tracers, logged to the GST_TRACER category like the
+ * core tracers' records (GST_DEBUG=GST_TRACER:7).  Unlike the debug log of
+ * this element, checking whether they are wanted is a single comparison.
+ */
+#if GST_CHECK_VERSION (1, 8, 0) && !defined (GST_DISABLE_GST_DEBUG)
+static GstTracerRecord *spotify_trace_enqueue;
+static GstTracerRecord *spotify_trace_dequeue;
+static GstTracerRecord *spotify_trace_underrun;
+static GstTracerRecord *spotify_trace_seek;
+
+#define SPOTIFY_TRACE(record, ...) G_STMT_START {                 \
+  if (G_UNLIKELY (_gst_debug_min >= GST_LEVEL_TRACE))             \
+    gst_tracer_record_log (spotify_trace_##record, __VA_ARGS__);  \
+} G_STMT_END
+#else
+#define SPOTIFY_TRACE(record, ...) G_STMT_START { } G_STMT_END
+#endif
+
 #define DEFAULT_PROP_MAX_BYTES     1000000
+#define DEFAULT_PROP_MAX_TIME      0
+#define DEFAULT_PROP_LOW_WATERMARK  0.01
+#define DEFAULT_PROP_HIGH_WATERMARK 0.99
+/* Size of a typical libspotify delivery, 2048 frames of stereo S16 */
+#define DEFAULT_BUFFER_SIZE        (2048 * 2 * sizeof(gint16))
 #define DEFAULT_PROP_USER          g_getenv("SPOTIFY_USER")
 #define DEFAULT_PROP_PASS          g_getenv("SPOTIFY_PASS")
 #define DEFAULT_PROP_APPKEY_FILE   g_getenv("SPOTIFY_APPKEY")
+#define DEFAULT_PROP_CREDENTIALS_BLOB NULL
+#define DEFAULT_PROP_REMEMBER_ME   FALSE
+#define DEFAULT_PROP_LOGIN_TIMEOUT 10000
+#define DEFAULT_PROP_LOAD_TIMEOUT  10000
+#define DEFAULT_PROP_SESSION_LINGER 30000
+#define DEFAULT_PROP_SESSION_AFFINITY FALSE
+#define DEFAULT_PROP_BUFFER_DURATION 0
+#define DEFAULT_PROP_IS_LIVE       FALSE
+#define DEFAULT_PROP_ASYNC_START   FALSE
+#define DEFAULT_PROP_BULK          FALSE
+#define DEFAULT_PROP_SEEK_TIMEOUT  1000
+#define DEFAULT_PROP_CACHE_LOCATION    NULL
+#define DEFAULT_PROP_SETTINGS_LOCATION NULL
+#define DEFAULT_PROP_PCM_CACHE_LOCATION NULL
+#define DEFAULT_PROP_CACHE_SIZE    0
+#define DEFAULT_PROP_BITRATE       GST_SPOTIFY_BITRATE_160K
+#define DEFAULT_PROP_VOLUME_NORMALIZATION FALSE
+#define DEFAULT_PROP_OUTPUT_FORMAT GST_SPOTIFY_OUTPUT_FORMAT_AUTO
+#define DEFAULT_PROP_GAIN          1.0
+#define DEFAULT_PROP_VORBIS_QUALITY 0.3
+#define DEFAULT_PROP_CONNECTION_TYPE GST_SPOTIFY_CONNECTION_TYPE_UNKNOWN
+#define DEFAULT_PROP_SYNC_OVER_MOBILE FALSE
+#define DEFAULT_PROP_MAX_RECONNECTS 5
+/* Upper bound on a main loop sleep, in milliseconds */
+#define SPOTIFY_LOOP_MAX_TIMEOUT   5000
+/* Least audio the queue holds in bulk mode */
+#define SPOTIFY_BULK_QUEUE_TIME    (60 * GST_SECOND)
+/* Reconnect backoff, doubling from the first to the last delay in ms */
+#define SPOTIFY_RECONNECT_DELAY_MIN 500
+#define SPOTIFY_RECONNECT_DELAY_MAX 30000
+#define SPOTIFY_TRACK_CACHE_SIZE   256
 #define DEFAULT_PROP_URI           \
 	"spotify://spotify:track:27jdUE1EYDSXZqhjuNxLem"
 
@@ -91,16 +371,64 @@ enum
   PROP_0,
   PROP_USER,
   PROP_PASS,
+  PROP_CREDENTIALS_BLOB,
+  PROP_REMEMBER_ME,
   PROP_APPKEY_FILE,
   PROP_URI,
+  PROP_LOGIN_TIMEOUT,
+  PROP_LOAD_TIMEOUT,
+  PROP_SESSION_LINGER,
+  PROP_ACCOUNTS,
+  PROP_SESSION_AFFINITY,
+  PROP_BUFFER_DURATION,
+  PROP_MAX_BYTES,
+  PROP_MAX_TIME,
+  PROP_LOW_WATERMARK,
+  PROP_HIGH_WATERMARK,
+  PROP_IS_LIVE,
+  PROP_ASYNC_START,
+  PROP_BULK,
+  PROP_LOOP_ITERATIONS,
+  PROP_LOOP_WAKEUPS,
+  PROP_SEEK_TIMEOUT,
+  PROP_SEEK_LATENCY,
+  PROP_MAX_RECONNECTS,
+  PROP_NEXT_URI,
+  PROP_CACHE_LOCATION,
+  PROP_SETTINGS_LOCATION,
+  PROP_PCM_CACHE_LOCATION,
+  PROP_CACHE_SIZE,
+  PROP_BITRATE,
+  PROP_VOLUME_NORMALIZATION,
+  PROP_OUTPUT_FORMAT,
+  PROP_GAIN,
+#ifdef HAVE_VORBISENC
+  PROP_VORBIS_QUALITY,
+#endif
+  PROP_CONNECTION_TYPE,
+  PROP_SYNC_OVER_MOBILE,
+  PROP_STATS,
   PROP_LAST
 };
 
-/*
- * Spotify library does not provide user data with callbacks, so we
- * have to store our context globally.
- */
-static GstSpotifySrc *g_spotifysrc = NULL;
+enum
+{
+  SIGNAL_ABOUT_TO_FINISH,
+  SIGNAL_PREFETCH,
+  SIGNAL_OFFLINE_SYNC,
+  LAST_SIGNAL
+};
+
+static guint gst_spotify_src_signals[LAST_SIGNAL] = { 0 };
+
+/* Encoded output comes after raw, which is preferred */
+#ifdef HAVE_VORBISENC
+#define SPOTIFY_VORBIS_CAPS "; audio/x-vorbis, " \
+            "rate = (int) [ 1, MAX ], " \
+            "channels = (int) [ 1, 2 ]"
+#else
+#define SPOTIFY_VORBIS_CAPS ""
+#endif
 
 static GstStaticPadTemplate gst_spotify_src_template =
 GST_STATIC_PAD_TEMPLATE ("src",
@@ -108,17 +436,87 @@ GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS ("audio/x-raw, "
             // This line will most probably break source hilighting :/
-            "format = (string) " GST_AUDIO_NE(S16) ", "
-            "endianness = (int) { 1234 }, "
-            "signed = (boolean) { TRUE }, "
-            "width = (int) 16, "
-            "depth = (int) 16, "
-            "rate = (int) 44100, "
-            "channels = (int) 2")
+            "format = (string) { " GST_AUDIO_NE(S16) ", "
+                GST_AUDIO_NE(S32) ", " GST_AUDIO_NE(F32) " }, "
+            "layout = (string) interleaved, "
+            "rate = (int) [ 1, MAX ], "
+            "channels = (int) [ 1, 2 ]"
+            SPOTIFY_VORBIS_CAPS)
     );
 
 static void gst_spotify_src_uri_handler_init (gpointer g_iface,
     gpointer iface_data);
+static gboolean gst_spotify_src_prefetch_uris (GstSpotifySrc * spotifysrc,
+    gchar ** uris);
+static gboolean gst_spotify_src_offline_sync_uris (GstSpotifySrc * spotifysrc,
+    gchar ** uris, gboolean offline);
+
+GType
+gst_spotify_bitrate_get_type (void)
+{
+  static GType bitrate_type = 0;
+  static const GEnumValue bitrates[] = {
+    {GST_SPOTIFY_BITRATE_96K, "96 kbit/s", "96"},
+    {GST_SPOTIFY_BITRATE_160K, "160 kbit/s", "160"},
+    {GST_SPOTIFY_BITRATE_320K, "320 kbit/s", "320"},
+    {0, NULL, NULL},
+  };
+
+  if (g_once_init_enter (&bitrate_type)) {
+    GType tmp = g_enum_register_static ("GstSpotifyBitrate", bitrates);
+    g_once_init_leave (&bitrate_type, tmp);
+  }
+
+  return bitrate_type;
+}
+
+GType
+gst_spotify_output_format_get_type (void)
+{
+  static GType output_format_type = 0;
+  static const GEnumValue output_formats[] = {
+    {GST_SPOTIFY_OUTPUT_FORMAT_AUTO, "Negotiated", "auto"},
+    {GST_SPOTIFY_OUTPUT_FORMAT_S16, "Signed 16 bit", "s16"},
+    {GST_SPOTIFY_OUTPUT_FORMAT_S32, "Signed 32 bit", "s32"},
+    {GST_SPOTIFY_OUTPUT_FORMAT_F32, "32 bit float", "f32"},
+#ifdef HAVE_VORBISENC
+    {GST_SPOTIFY_OUTPUT_FORMAT_VORBIS, "Vorbis", "vorbis"},
+#endif
+    {0, NULL, NULL},
+  };
+
+  if (g_once_init_enter (&output_format_type)) {
+    GType tmp = g_enum_register_static ("GstSpotifyOutputFormat",
+        output_formats);
+    g_once_init_leave (&output_format_type, tmp);
+  }
+
+  return output_format_type;
+}
+
+GType
+gst_spotify_connection_type_get_type (void)
+{
+  static GType connection_type_type = 0;
+  static const GEnumValue connection_types[] = {
+    {GST_SPOTIFY_CONNECTION_TYPE_UNKNOWN, "Unknown", "unknown"},
+    {GST_SPOTIFY_CONNECTION_TYPE_NONE, "No connection, offline", "none"},
+    {GST_SPOTIFY_CONNECTION_TYPE_MOBILE, "Mobile", "mobile"},
+    {GST_SPOTIFY_CONNECTION_TYPE_MOBILE_ROAMING, "Roaming mobile",
+        "mobile-roaming"},
+    {GST_SPOTIFY_CONNECTION_TYPE_WIFI, "Wireless LAN", "wifi"},
+    {GST_SPOTIFY_CONNECTION_TYPE_WIRED, "Ethernet", "wired"},
+    {0, NULL, NULL},
+  };
+
+  if (g_once_init_enter (&connection_type_type)) {
+    GType tmp = g_enum_register_static ("GstSpotifyConnectionType",
+        connection_types);
+    g_once_init_leave (&connection_type_type, tmp);
+  }
+
+  return connection_type_type;
+}
 
 static void gst_spotify_src_dispose (GObject * object);
 static void gst_spotify_src_finalize (GObject * object);
@@ -138,23 +536,197 @@ static gboolean gst_spotify_src_do_seek (GstBaseSrc * src, GstSegment * segment)
 static gboolean gst_spotify_src_is_seekable (GstBaseSrc * src);
 static gboolean gst_spotify_src_do_get_size (GstBaseSrc * src, guint64 * size);
 static gboolean gst_spotify_src_query (GstBaseSrc * src, GstQuery * query);
+static gboolean gst_spotify_src_decide_allocation (GstBaseSrc * src,
+    GstQuery * query);
+static GstCaps *gst_spotify_src_fixate (GstBaseSrc * src, GstCaps * caps);
+static gboolean gst_spotify_src_set_caps (GstBaseSrc * src, GstCaps * caps);
 static gboolean
 gst_spotify_src_set_uri (GstSpotifySrc *spotifysrc, const gchar *uri);
 
 static void
 gst_spotify_src_end_of_stream (GstSpotifySrc * spotifysrc);
+static GstStructure *
+gst_spotify_src_get_stats (GstSpotifySrc * spotifysrc);
+static GstBuffer *
+gst_spotify_src_alloc_buffer (GstSpotifySrc * spotifysrc, guint size);
+static GstCaps *
+gst_spotify_src_get_caps (GstSpotifySrc * spotifysrc, GstCaps * filter);
+static gboolean
+gst_spotify_src_set_vorbis_caps (GstSpotifySrc * spotifysrc,
+    const GstStructure * structure);
+static GstFlowReturn
+gst_spotify_src_create_pcm (GstBaseSrc * bsrc, guint64 offset, guint size,
+    GstBuffer ** buf);
+#ifdef HAVE_VORBISENC
+static void
+gst_spotify_src_clear_vorbis (GstSpotifySrc * spotifysrc);
+static void
+gst_spotify_src_reset_vorbis (GstSpotifySrc * spotifysrc);
+static GstFlowReturn
+gst_spotify_src_create_vorbis (GstSpotifySrc * spotifysrc, guint64 offset,
+    guint size, GstBuffer ** buf);
+#endif
+static GstClockTime
+gst_spotify_src_bytes_to_time (GstSpotifySrc * spotifysrc, guint64 bytes);
+static void
+gst_spotify_src_convert_run (const guint8 * data, guint len,
+    gpointer user_data);
+static void
+gst_spotify_src_update_buffering (GstSpotifySrc * spotifysrc, guint level);
+static void
+gst_spotify_src_resync_live (GstSpotifySrc * spotifysrc,
+    GstClockTime duration);
+static gboolean
+gst_spotify_src_wait_seek (GstSpotifySrc * spotifysrc, guint kicks);
+static gchar *
+gst_spotify_src_get_pcm_cache_key (const gchar * link);
+static GstSpotifyPcmCache *
+gst_spotify_src_open_pcm_cache (GstSpotifySrc * spotifysrc,
+    const gchar * link);
+static GstFlowReturn
+gst_spotify_src_create_cached (GstSpotifySrc * spotifysrc, guint64 offset,
+    guint size, GstBuffer ** buf);
+static gboolean
+gst_spotify_src_get_cached_size (GstSpotifySrc * spotifysrc, guint64 * size);
+static void
+gst_spotify_src_session_failed (GstSpotifySrc * spotifysrc, gint recover);
+static gboolean
+gst_spotify_src_recover (GstSpotifySrc * spotifysrc);
+static guint
+gst_spotify_src_check_boundary (GstSpotifySrc * spotifysrc);
+static void
+gst_spotify_src_process_warmups (GstSpotifySrc * spotifysrc,
+    GstSpotifySessionContext * context);
+static void
+gst_spotify_src_clear_warmups (GstSpotifySrc * spotifysrc,
+    GstSpotifySessionContext * context);
+static void
+gst_spotify_src_post_warmups (GstSpotifySrc * spotifysrc);
+static void
+gst_spotify_src_track_started (GstSpotifySrc * spotifysrc,
+    GstSpotifySessionContext * context, gboolean locked);
+static gboolean
+gst_spotify_src_next_track (GstSpotifySrc * spotifysrc,
+    GstSpotifySessionContext * context);
+static void
+gst_spotify_src_update_connection (GstSpotifySrc * spotifysrc);
+static void
+gst_spotify_src_set_credentials_blob (GstSpotifySrc * spotifysrc,
+    const gchar * blob);
+static void
+gst_spotify_src_notify_credentials (GstSpotifySrc * spotifysrc);
+static void
+gst_spotify_src_post_offline_status (GstSpotifySrc * spotifysrc,
+    GstSpotifySessionContext * context);
 
 /* Spotify API calls */
-static gboolean spotify_create(char *appkey_file);
+static GstSpotifySessionContext *spotify_session_acquire(GstSpotifySrc *src,
+                                   const GstSpotifySessionConfig *config,
+                                   GstClockTime *login_latency);
+static void spotify_session_release(GstSpotifySessionContext *context,
+                                    guint linger);
+static GstSpotifySessionContext *spotify_session_ref(
+                                   GstSpotifySessionContext *context);
+static void spotify_session_cancel(GstSpotifySrc *src);
+static void spotify_session_get_loop_stats(GstSpotifySessionContext *context,
+                                           guint64 *iterations,
+                                           guint64 *wakeups);
+static GstSpotifySrc *spotify_session_get_src(sp_session *session);
+static GstSpotifySessionContext *spotify_create(
+                                   const GstSpotifySessionConfig *config,
+                                   gint cpu);
 static gboolean spotify_destroy(GstSpotifySessionContext *context);
 static gboolean spotify_login(GstSpotifySessionContext *context,
                               const char *user,
-                              const char *password);
+                              const char *password,
+                              const char *blob,
+                              gboolean remember_me,
+                              guint timeout);
 static gboolean spotify_seek(GstSpotifySessionContext *context, int offset);
-static gboolean spotify_play(GstSpotifySessionContext *context, const char *link);
+static gboolean spotify_resolve(GstSpotifySessionContext *context,
+                                const char *link, guint timeout,
+                                GPtrArray *tracks);
+static void spotify_release_tracks(GstSpotifySessionContext *context,
+                                   GPtrArray *tracks);
+static gboolean spotify_set_offline(GstSpotifySessionContext *context,
+                                    const char *link, gboolean offline,
+                                    guint timeout,
+                                    sp_playlist_offline_status *status,
+                                    int *progress);
+static void spotify_set_connection_locked(GstSpotifySessionContext *context,
+                                          GstSpotifyConnectionType type,
+                                          gboolean sync_over_mobile);
+static sp_track *spotify_track_from_link_locked(const char *link);
+static gboolean spotify_load_track_locked(GstSpotifySessionContext *context,
+                                          sp_track *spt, gint64 *duration);
+static GstSpotifyTrackInfo *spotify_track_info_get_locked(
+    GstSpotifySessionContext *context, sp_track *spt);
+static void spotify_track_info_free(GstSpotifyTrackInfo *info);
+static GstTagList *spotify_track_tags_locked(GstSpotifySessionContext *context,
+                                             sp_track *spt);
+static gboolean spotify_play(GstSpotifySessionContext *context, sp_track *spt,
+                             guint timeout, gint64 *duration);
 static gboolean spotify_stop(GstSpotifySessionContext *context);
 
 #define parent_class gst_spotify_src_parent_class
+#if GST_CHECK_VERSION (1, 8, 0) && !defined (GST_DISABLE_GST_DEBUG)
+static GstStructure *
+gst_spotify_src_trace_value (GType type, const gchar * description)
+{
+  return gst_structure_new ("value",
+      "type", G_TYPE_GTYPE, type,
+      "description", G_TYPE_STRING, description, NULL);
+}
+
+static GstTracerRecord *
+gst_spotify_src_trace_record (const gchar * name, const gchar * field,
+    GType type, const gchar * description, const gchar * field2,
+    GType type2, const gchar * description2)
+{
+  GstTracerRecord *record;
+
+  record = gst_tracer_record_new (name,
+      "element", GST_TYPE_STRUCTURE, gst_structure_new ("scope",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          "related-to", GST_TYPE_TRACER_VALUE_SCOPE,
+          GST_TRACER_VALUE_SCOPE_ELEMENT, NULL),
+      field, GST_TYPE_STRUCTURE,
+      gst_spotify_src_trace_value (type, description),
+      field2, GST_TYPE_STRUCTURE,
+      gst_spotify_src_trace_value (type2, description2), NULL);
+#if GST_CHECK_VERSION (1, 10, 0)
+  GST_OBJECT_FLAG_SET (record, GST_OBJECT_FLAG_MAY_BE_LEAKED);
+#endif
+
+  return record;
+}
+#endif
+
+/* Records live as long as the class */
+static void
+gst_spotify_src_init_tracing (void)
+{
+#if GST_CHECK_VERSION (1, 8, 0) && !defined (GST_DISABLE_GST_DEBUG)
+  spotify_trace_enqueue = gst_spotify_src_trace_record (
+      "spotifysrc-enqueue.class",
+      "bytes", G_TYPE_UINT, "audio queued from a libspotify delivery",
+      "level", G_TYPE_UINT, "bytes in the queue afterwards");
+  spotify_trace_dequeue = gst_spotify_src_trace_record (
+      "spotifysrc-dequeue.class",
+      "bytes", G_TYPE_UINT, "audio taken from the queue for a buffer",
+      "level", G_TYPE_UINT, "bytes in the queue afterwards");
+  spotify_trace_underrun = gst_spotify_src_trace_record (
+      "spotifysrc-underrun.class",
+      "underruns", G_TYPE_UINT, "underruns since start",
+      "pushed", G_TYPE_UINT, "buffers pushed since start");
+  spotify_trace_seek = gst_spotify_src_trace_record (
+      "spotifysrc-seek.class",
+      "position", G_TYPE_UINT64, "track position sought to, in nanoseconds",
+      "latency", G_TYPE_UINT64, "time until the first buffer after the "
+      "seek, in nanoseconds");
+#endif
+}
+
 G_DEFINE_TYPE_EXTENDED (GstSpotifySrc, gst_spotify_src, GST_TYPE_BASE_SRC, 0,
     G_IMPLEMENT_INTERFACE(GST_TYPE_URI_HANDLER, gst_spotify_src_uri_handler_init));
 
@@ -179,14 +751,273 @@ gst_spotify_src_class_init (GstSpotifySrcClass * klass)
       g_param_spec_string ("pass", "Password", "Password for premium Spotify account",
 	      DEFAULT_PROP_PASS, G_PARAM_READWRITE));
 
+  g_object_class_install_property (gobject_class, PROP_CREDENTIALS_BLOB,
+      g_param_spec_string ("credentials-blob", "Credentials blob",
+          "Login credentials from an earlier session, preferred over the "
+          "password.  Updated after logging in and notified once start, "
+          "stop or the streaming thread sees it, so it can be saved for the "
+          "next start",
+          DEFAULT_PROP_CREDENTIALS_BLOB, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_REMEMBER_ME,
+      g_param_spec_boolean ("remember-me", "Remember me",
+          "Have libspotify store the credentials in the settings location "
+          "for logging in without a password later",
+          DEFAULT_PROP_REMEMBER_ME, G_PARAM_READWRITE));
+
   g_object_class_install_property (gobject_class, PROP_URI,
-      g_param_spec_string ("uri", "URI", "A Spotify track URI",
+      g_param_spec_string ("uri", "URI",
+          "A Spotify track, album or playlist URI",
           DEFAULT_PROP_URI, G_PARAM_READWRITE));
 
   g_object_class_install_property (gobject_class, PROP_APPKEY_FILE,
       g_param_spec_string ("spotifykeyfile", "Spotify app key File", "Path to spotify key file",
           DEFAULT_PROP_APPKEY_FILE, G_PARAM_READWRITE));
 
+  g_object_class_install_property (gobject_class, PROP_LOGIN_TIMEOUT,
+      g_param_spec_uint ("login-timeout", "Login timeout",
+          "Time to wait for the Spotify login to complete (in milliseconds)",
+          0, G_MAXUINT, DEFAULT_PROP_LOGIN_TIMEOUT, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_LOAD_TIMEOUT,
+      g_param_spec_uint ("load-timeout", "Track load timeout",
+          "Time to wait for the track metadata to load (in milliseconds)",
+          0, G_MAXUINT, DEFAULT_PROP_LOAD_TIMEOUT, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_SESSION_LINGER,
+      g_param_spec_uint ("session-linger", "Session linger",
+          "Time an idle Spotify session stays logged in for reuse by the next "
+          "start (in milliseconds, 0 = release the session on stop)",
+          0, G_MAXUINT, DEFAULT_PROP_SESSION_LINGER, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_ACCOUNTS,
+      g_param_spec_boxed ("accounts", "Accounts",
+          "\"user:password\" entries to log in with in place of user and "
+          "pass, preferring the account of an idle session.  libspotify "
+          "allows one session per process, so this does not add streams",
+          G_TYPE_STRV, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_SESSION_AFFINITY,
+      g_param_spec_boolean ("session-affinity", "Session affinity",
+          "Pin the main loop thread of a new session to a CPU picked from "
+          "the process ID, spreading processes started side by side, "
+          "where supported",
+          DEFAULT_PROP_SESSION_AFFINITY, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_BUFFER_DURATION,
+      g_param_spec_uint64 ("buffer-duration", "Buffer duration",
+          "Duration of the output buffers, libspotify deliveries are "
+          "accumulated until this much audio is available (in nanoseconds, "
+          "0 = push whatever has been delivered)",
+          0, G_MAXUINT64, DEFAULT_PROP_BUFFER_DURATION, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_BYTES,
+      g_param_spec_uint64 ("max-bytes", "Max bytes",
+          "Maximum amount of decoded audio queued ahead of the streaming "
+          "thread (in bytes)",
+          2 * sizeof(gint16), G_MAXINT / 2, DEFAULT_PROP_MAX_BYTES,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_TIME,
+      g_param_spec_uint64 ("max-time", "Max time",
+          "Maximum amount of decoded audio queued ahead of the streaming "
+          "thread, the smaller of max-bytes and max-time applies "
+          "(in nanoseconds, 0 = max-bytes only)",
+          0, G_MAXUINT64, DEFAULT_PROP_MAX_TIME, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_LOW_WATERMARK,
+      g_param_spec_double ("low-watermark", "Low watermark",
+          "Queue fill level, as a fraction of the maximum, below which "
+          "buffering starts",
+          0.0, 1.0, DEFAULT_PROP_LOW_WATERMARK, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_HIGH_WATERMARK,
+      g_param_spec_double ("high-watermark", "High watermark",
+          "Queue fill level, as a fraction of the maximum, at which "
+          "buffering completes",
+          0.0, 1.0, DEFAULT_PROP_HIGH_WATERMARK, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_IS_LIVE,
+      g_param_spec_boolean ("is-live", "Is live",
+          "Act as a live source, timestamping buffers against the pipeline "
+          "clock and reporting the queue latency (disables seeking)",
+          DEFAULT_PROP_IS_LIVE, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_ASYNC_START,
+      g_param_spec_boolean ("async-start", "Async start",
+          "Log in and load the track in a thread of its own, so that the "
+          "state change to PAUSED doesn't block on the network",
+          DEFAULT_PROP_ASYNC_START, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_BULK,
+      g_param_spec_boolean ("bulk", "Bulk",
+          "Decode as fast as libspotify can instead of pacing for playback, "
+          "queueing at least a minute of audio (for non-synchronized "
+          "pipelines)",
+          DEFAULT_PROP_BULK, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_LOOP_ITERATIONS,
+      g_param_spec_uint64 ("loop-iterations", "Loop iterations",
+          "Number of times the main loop of the leased Spotify session has "
+          "processed events",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE));
+
+  g_object_class_install_property (gobject_class, PROP_LOOP_WAKEUPS,
+      g_param_spec_uint64 ("loop-wakeups", "Loop wakeups",
+          "Number of times the main loop of the leased Spotify session was "
+          "woken before its timeout",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE));
+
+  g_object_class_install_property (gobject_class, PROP_SEEK_TIMEOUT,
+      g_param_spec_uint ("seek-timeout", "Seek timeout",
+          "Time to wait for libspotify to flush its old data after a seek, "
+          "after which whatever it delivers is played (in milliseconds)",
+          0, G_MAXUINT, DEFAULT_PROP_SEEK_TIMEOUT, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_SEEK_LATENCY,
+      g_param_spec_uint64 ("seek-latency", "Seek latency",
+          "Time from the last seek until its first buffer was pushed "
+          "(in nanoseconds)",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE));
+
+  g_object_class_install_property (gobject_class, PROP_NEXT_URI,
+      g_param_spec_string ("next-uri", "Next URI",
+          "A Spotify track URI to play gaplessly once the queued tracks "
+          "have finished, usually set from about-to-finish",
+          NULL, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_RECONNECTS,
+      g_param_spec_uint ("max-reconnects", "Max reconnects",
+          "Attempts at resuming the stream after libspotify stopped "
+          "streaming, with exponential backoff (0 = fail right away)",
+          0, G_MAXUINT, DEFAULT_PROP_MAX_RECONNECTS, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_CACHE_LOCATION,
+      g_param_spec_string ("cache-location", "Cache location",
+          "Directory for the libspotify audio and metadata cache, shared by "
+          "all sessions using it (NULL = user cache directory)",
+          DEFAULT_PROP_CACHE_LOCATION, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_SETTINGS_LOCATION,
+      g_param_spec_string ("settings-location", "Settings location",
+          "Directory for the libspotify settings "
+          "(NULL = user configuration directory)",
+          DEFAULT_PROP_SETTINGS_LOCATION, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_PCM_CACHE_LOCATION,
+      g_param_spec_string ("pcm-cache-location", "PCM cache location",
+          "Directory to keep the decoded audio of track URIs in, for pull "
+          "mode and seeks by byte offset (NULL = stream without caching)",
+          DEFAULT_PROP_PCM_CACHE_LOCATION, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_CACHE_SIZE,
+      g_param_spec_uint ("cache-size", "Cache size",
+          "Maximum size of the libspotify cache "
+          "(in megabytes, 0 = 10% of the free disk space)",
+          0, G_MAXUINT, DEFAULT_PROP_CACHE_SIZE, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_BITRATE,
+      g_param_spec_enum ("bitrate", "Bitrate",
+          "Preferred streaming and offline sync bitrate",
+          GST_TYPE_SPOTIFY_BITRATE, DEFAULT_PROP_BITRATE, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_VOLUME_NORMALIZATION,
+      g_param_spec_boolean ("volume-normalization", "Volume normalization",
+          "Let libspotify normalize the track loudness",
+          DEFAULT_PROP_VOLUME_NORMALIZATION, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_OUTPUT_FORMAT,
+      g_param_spec_enum ("output-format", "Output format",
+          "Sample format to produce, converted from the delivered S16",
+          GST_TYPE_SPOTIFY_OUTPUT_FORMAT, DEFAULT_PROP_OUTPUT_FORMAT,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_GAIN,
+      g_param_spec_double ("gain", "Gain",
+          "Linear gain applied while converting (1.0 = unchanged)",
+          0.0, 10.0, DEFAULT_PROP_GAIN, G_PARAM_READWRITE));
+
+#ifdef HAVE_VORBISENC
+  g_object_class_install_property (gobject_class, PROP_VORBIS_QUALITY,
+      g_param_spec_float ("vorbis-quality", "Vorbis quality",
+          "Quality of Vorbis output, from -0.1 (lowest) to 1.0 (highest)",
+          -0.1, 1.0, DEFAULT_PROP_VORBIS_QUALITY, G_PARAM_READWRITE));
+#endif
+
+  g_object_class_install_property (gobject_class, PROP_CONNECTION_TYPE,
+      g_param_spec_enum ("connection-type", "Connection type",
+          "Network the host is on, none plays from the offline store only",
+          GST_TYPE_SPOTIFY_CONNECTION_TYPE, DEFAULT_PROP_CONNECTION_TYPE,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_SYNC_OVER_MOBILE,
+      g_param_spec_boolean ("sync-over-mobile", "Sync over mobile",
+          "Allow offline playlists to sync over a mobile connection",
+          DEFAULT_PROP_SYNC_OVER_MOBILE, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Counters and latencies since the last start",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE));
+
+  /**
+   * GstSpotifySrc::about-to-finish:
+   * @spotifysrc: the spotifysrc
+   *
+   * Emitted when the last queued track starts playing, so that the next one
+   * can be set with the next-uri property and preloaded in time.  This is
+   * emitted from a libspotify thread; handlers should only set next-uri.
+   */
+  gst_spotify_src_signals[SIGNAL_ABOUT_TO_FINISH] =
+      g_signal_new ("about-to-finish", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST, G_STRUCT_OFFSET (GstSpotifySrcClass, about_to_finish),
+      NULL, NULL, NULL, G_TYPE_NONE, 0);
+
+  /**
+   * GstSpotifySrc::prefetch:
+   * @spotifysrc: the spotifysrc
+   * @uris: (array zero-terminated=1): Spotify track URIs
+   *
+   * Load the metadata of @uris in the background, so that playing them
+   * later doesn't wait for it.  Their audio is not prefetched, since
+   * libspotify keeps a single prefetch slot for the next queued track.  A
+   * "spotify-prefetch" element message with the uri, whether its metadata
+   * loaded and the number of tracks still pending is posted for each
+   * track.  Only works while the element is started.
+   *
+   * Returns: %FALSE if the element has no session to prefetch with
+   */
+  gst_spotify_src_signals[SIGNAL_PREFETCH] =
+      g_signal_new ("prefetch", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+      G_STRUCT_OFFSET (GstSpotifySrcClass, prefetch),
+      NULL, NULL, NULL, G_TYPE_BOOLEAN, 1, G_TYPE_STRV);
+
+  /**
+   * GstSpotifySrc::offline-sync:
+   * @spotifysrc: the spotifysrc
+   * @uris: (array zero-terminated=1): Spotify playlist URIs
+   * @offline: whether to store the playlists or drop them again
+   *
+   * Have libspotify keep @uris in its encrypted offline store, so they can
+   * be played with connection-type set to none.  Each playlist is waited
+   * for up to load-timeout, then a "spotify-offline-sync" element message
+   * with the uri, whether the mode was set, its offline status and download
+   * progress is posted.  Sync progress is reported with
+   * "spotify-offline-status" messages.  Only works while the element is
+   * started.
+   *
+   * Returns: %FALSE if the element has no session to sync with
+   */
+  gst_spotify_src_signals[SIGNAL_OFFLINE_SYNC] =
+      g_signal_new ("offline-sync", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+      G_STRUCT_OFFSET (GstSpotifySrcClass, offline_sync),
+      NULL, NULL, NULL, G_TYPE_BOOLEAN, 2, G_TYPE_STRV, G_TYPE_BOOLEAN);
+
+  klass->prefetch = gst_spotify_src_prefetch_uris;
+  klass->offline_sync = gst_spotify_src_offline_sync_uris;
+
   basesrc_class->create = gst_spotify_src_create;
   basesrc_class->start = gst_spotify_src_start;
   basesrc_class->stop = gst_spotify_src_stop;
@@ -196,6 +1027,9 @@ gst_spotify_src_class_init (GstSpotifySrcClass * klass)
   basesrc_class->is_seekable = gst_spotify_src_is_seekable;
   basesrc_class->get_size = gst_spotify_src_do_get_size;
   basesrc_class->query = gst_spotify_src_query;
+  basesrc_class->decide_allocation = gst_spotify_src_decide_allocation;
+  basesrc_class->fixate = gst_spotify_src_fixate;
+  basesrc_class->set_caps = gst_spotify_src_set_caps;
 
   gst_element_class_add_pad_template (element_class,
     gst_static_pad_template_get (&gst_spotify_src_template));
@@ -208,6 +1042,7 @@ gst_spotify_src_class_init (GstSpotifySrcClass * klass)
     "Liam Wickins <liam9534@gmail.com>");
 
   GST_DEBUG_CATEGORY_INIT (spotify_src_debug, "spotify", 0, "spotifysrc element");
+  gst_spotify_src_init_tracing ();
 
   g_type_class_add_private (klass, sizeof (GstSpotifySrcPrivate));
 }
@@ -220,32 +1055,75 @@ gst_spotify_src_init (GstSpotifySrc * spotifysrc)
   priv = spotifysrc->priv = G_TYPE_INSTANCE_GET_PRIVATE (
         spotifysrc, GST_TYPE_SPOTIFY_SRC, GstSpotifySrcPrivate);
 
-  priv->queue = g_queue_new ();
-
   priv->max_bytes = DEFAULT_PROP_MAX_BYTES;
+  priv->max_time = DEFAULT_PROP_MAX_TIME;
+  priv->low_watermark = DEFAULT_PROP_LOW_WATERMARK;
+  priv->high_watermark = DEFAULT_PROP_HIGH_WATERMARK;
+  priv->bulk = DEFAULT_PROP_BULK;
   priv->size = -1;
   priv->spotify_context = NULL;
   priv->user = g_strdup(DEFAULT_PROP_USER);
   priv->pass = g_strdup(DEFAULT_PROP_PASS);
+  priv->credentials_blob = g_strdup(DEFAULT_PROP_CREDENTIALS_BLOB);
+  priv->remember_me = DEFAULT_PROP_REMEMBER_ME;
   priv->uri = g_strdup(DEFAULT_PROP_URI);
   priv->appkey_file = g_strdup(DEFAULT_PROP_APPKEY_FILE);
+  priv->login_timeout = DEFAULT_PROP_LOGIN_TIMEOUT;
+  priv->load_timeout = DEFAULT_PROP_LOAD_TIMEOUT;
+  priv->session_linger = DEFAULT_PROP_SESSION_LINGER;
+  priv->session_affinity = DEFAULT_PROP_SESSION_AFFINITY;
+  priv->buffer_duration = DEFAULT_PROP_BUFFER_DURATION;
+  priv->seek_timeout = DEFAULT_PROP_SEEK_TIMEOUT;
+  priv->max_reconnects = DEFAULT_PROP_MAX_RECONNECTS;
+  priv->cache_location = g_strdup(DEFAULT_PROP_CACHE_LOCATION);
+  priv->settings_location = g_strdup(DEFAULT_PROP_SETTINGS_LOCATION);
+  priv->pcm_cache_location = g_strdup(DEFAULT_PROP_PCM_CACHE_LOCATION);
+  priv->cache_size = DEFAULT_PROP_CACHE_SIZE;
+  priv->bitrate = DEFAULT_PROP_BITRATE;
+  priv->volume_normalization = DEFAULT_PROP_VOLUME_NORMALIZATION;
+  priv->output_format = DEFAULT_PROP_OUTPUT_FORMAT;
+  priv->gain = DEFAULT_PROP_GAIN;
+  priv->connection_type = DEFAULT_PROP_CONNECTION_TYPE;
+  priv->sync_over_mobile = DEFAULT_PROP_SYNC_OVER_MOBILE;
   priv->caps = NULL; /* FIXME: Do we need to set this? */
+  /* What libspotify delivers in practice, until told otherwise */
+  priv->rate = 44100;
+  priv->channels = 2;
+  gst_spotify_convert_init (&priv->convert, priv->channels,
+      GST_AUDIO_FORMAT_S16, priv->channels, priv->gain);
+  priv->tracks = g_ptr_array_new ();
+  g_queue_init (&priv->boundaries);
+  g_queue_init (&priv->warmups);
+  g_queue_init (&priv->warmups_done);
+#ifdef HAVE_VORBISENC
+  priv->vorbis_quality = DEFAULT_PROP_VORBIS_QUALITY;
+  g_queue_init (&priv->vorbis_packets);
+  g_queue_init (&priv->vorbis_chunks);
+#endif
 
-  /* Set global context for spotify session to use */
-  g_spotifysrc = spotifysrc;
-
-  gst_base_src_set_live (GST_BASE_SRC (spotifysrc), FALSE);
+  gst_base_src_set_live (GST_BASE_SRC (spotifysrc), DEFAULT_PROP_IS_LIVE);
+  gst_base_src_set_async (GST_BASE_SRC (spotifysrc), DEFAULT_PROP_ASYNC_START);
 }
 
 static void
 gst_spotify_src_flush_queued (GstSpotifySrc * src)
 {
-  GstBuffer *buf;
   GstSpotifySrcPrivate *priv = src->priv;
-
-  while ((buf = g_queue_pop_head (priv->queue)))
-    gst_buffer_unref (buf);
-  priv->queued_bytes = 0;
+  GstSpotifySrcBoundary *boundary;
+
+  if (priv->ring)
+    gst_spotify_ring_clear (priv->ring);
+
+  /* Whatever libspotify plays now is the last track that started */
+  g_mutex_lock (&priv->tracks_lock);
+  while ((boundary = g_queue_pop_head (&priv->boundaries))) {
+    priv->size = boundary->duration;
+    if (boundary->tags)
+      gst_tag_list_unref (boundary->tags);
+    g_slice_free (GstSpotifySrcBoundary, boundary);
+  }
+  g_atomic_int_set (&priv->n_boundaries, 0);
+  g_mutex_unlock (&priv->tracks_lock);
 }
 
 static void
@@ -258,6 +1136,10 @@ gst_spotify_src_dispose (GObject * obj)
     gst_caps_unref (priv->caps);
     priv->caps = NULL;
   }
+  if (priv->tags) {
+    gst_tag_list_unref (priv->tags);
+    priv->tags = NULL;
+  }
   gst_spotify_src_flush_queued (spotifysrc);
 
   G_OBJECT_CLASS (parent_class)->dispose (obj);
@@ -269,12 +1151,23 @@ gst_spotify_src_finalize (GObject * obj)
   GstSpotifySrc *spotifysrc = GST_SPOTIFY_SRC_CAST (obj);
   GstSpotifySrcPrivate *priv = spotifysrc->priv;
 
-  spotify_destroy(priv->spotify_context);
+  /* Left over when an asynchronous start failed without a stop */
+  if (priv->start_thread)
+    g_thread_join (priv->start_thread);
+  spotify_session_release(priv->spotify_context, priv->session_linger);
+  priv->spotify_context = NULL;
   g_free (priv->user);
   g_free (priv->pass);
+  g_free (priv->credentials_blob);
+  g_strfreev (priv->accounts);
   g_free (priv->appkey_file);
   g_free (priv->uri);
-  g_queue_free (priv->queue);
+  g_free (priv->next_uri);
+  g_free (priv->cache_location);
+  g_free (priv->settings_location);
+  g_free (priv->pcm_cache_location);
+  g_ptr_array_free (priv->tracks, TRUE);
+  gst_spotify_ring_free (priv->ring);
 
   G_OBJECT_CLASS (parent_class)->finalize (obj);
 }
@@ -295,6 +1188,15 @@ gst_spotify_src_set_property (GObject * object, guint prop_id,
         g_free(priv->pass);
         priv->pass = g_value_dup_string(value);
       break;
+    case PROP_CREDENTIALS_BLOB:
+      GST_OBJECT_LOCK (spotifysrc);
+      g_free(priv->credentials_blob);
+      priv->credentials_blob = g_value_dup_string(value);
+      GST_OBJECT_UNLOCK (spotifysrc);
+      break;
+    case PROP_REMEMBER_ME:
+      priv->remember_me = g_value_get_boolean(value);
+      break;
     case PROP_APPKEY_FILE:
         g_free(priv->appkey_file);
         priv->appkey_file = g_value_dup_string(value);
@@ -302,6 +1204,114 @@ gst_spotify_src_set_property (GObject * object, guint prop_id,
     case PROP_URI:
       gst_spotify_src_set_uri(spotifysrc, g_value_get_string(value));
       break;
+    case PROP_LOGIN_TIMEOUT:
+      priv->login_timeout = g_value_get_uint(value);
+      break;
+    case PROP_LOAD_TIMEOUT:
+      priv->load_timeout = g_value_get_uint(value);
+      break;
+    case PROP_SESSION_LINGER:
+      priv->session_linger = g_value_get_uint(value);
+      break;
+    case PROP_ACCOUNTS:
+      g_strfreev(priv->accounts);
+      priv->accounts = g_value_dup_boxed(value);
+      break;
+    case PROP_SESSION_AFFINITY:
+      priv->session_affinity = g_value_get_boolean(value);
+      break;
+    case PROP_BUFFER_DURATION:
+      priv->buffer_duration = g_value_get_uint64(value);
+      break;
+    case PROP_MAX_BYTES:
+      priv->max_bytes = g_value_get_uint64(value);
+      break;
+    case PROP_MAX_TIME:
+      priv->max_time = g_value_get_uint64(value);
+      break;
+    case PROP_LOW_WATERMARK:
+      priv->low_watermark = g_value_get_double(value);
+      break;
+    case PROP_HIGH_WATERMARK:
+      priv->high_watermark = g_value_get_double(value);
+      break;
+    case PROP_IS_LIVE:
+      gst_base_src_set_live (GST_BASE_SRC (spotifysrc),
+          g_value_get_boolean(value));
+      break;
+    case PROP_ASYNC_START:
+      gst_base_src_set_async (GST_BASE_SRC (spotifysrc),
+          g_value_get_boolean(value));
+      break;
+    case PROP_BULK:
+      priv->bulk = g_value_get_boolean(value);
+      break;
+    case PROP_SEEK_TIMEOUT:
+      priv->seek_timeout = g_value_get_uint(value);
+      break;
+    case PROP_MAX_RECONNECTS:
+      priv->max_reconnects = g_value_get_uint(value);
+      break;
+    case PROP_CACHE_LOCATION:
+      g_free(priv->cache_location);
+      priv->cache_location = g_value_dup_string(value);
+      break;
+    case PROP_SETTINGS_LOCATION:
+      g_free(priv->settings_location);
+      priv->settings_location = g_value_dup_string(value);
+      break;
+    case PROP_PCM_CACHE_LOCATION:
+      GST_OBJECT_LOCK (spotifysrc);
+      g_free(priv->pcm_cache_location);
+      priv->pcm_cache_location = g_value_dup_string(value);
+      GST_OBJECT_UNLOCK (spotifysrc);
+      break;
+    case PROP_CACHE_SIZE:
+      priv->cache_size = g_value_get_uint(value);
+      break;
+    case PROP_BITRATE:
+      priv->bitrate = g_value_get_enum(value);
+      break;
+    case PROP_VOLUME_NORMALIZATION:
+      priv->volume_normalization = g_value_get_boolean(value);
+      break;
+    case PROP_OUTPUT_FORMAT:
+      GST_OBJECT_LOCK (spotifysrc);
+      priv->output_format = g_value_get_enum(value);
+      GST_OBJECT_UNLOCK (spotifysrc);
+      gst_pad_mark_reconfigure (GST_BASE_SRC_PAD (spotifysrc));
+      break;
+    case PROP_GAIN:
+      /* picked up by the next buffer */
+      GST_OBJECT_LOCK (spotifysrc);
+      priv->gain = g_value_get_double(value);
+      GST_OBJECT_UNLOCK (spotifysrc);
+      break;
+#ifdef HAVE_VORBISENC
+    case PROP_VORBIS_QUALITY:
+      GST_OBJECT_LOCK (spotifysrc);
+      priv->vorbis_quality = g_value_get_float(value);
+      GST_OBJECT_UNLOCK (spotifysrc);
+      break;
+#endif
+    case PROP_CONNECTION_TYPE:
+      g_mutex_lock(&priv->mutex);
+      priv->connection_type = g_value_get_enum(value);
+      gst_spotify_src_update_connection(spotifysrc);
+      g_mutex_unlock(&priv->mutex);
+      break;
+    case PROP_SYNC_OVER_MOBILE:
+      g_mutex_lock(&priv->mutex);
+      priv->sync_over_mobile = g_value_get_boolean(value);
+      gst_spotify_src_update_connection(spotifysrc);
+      g_mutex_unlock(&priv->mutex);
+      break;
+    case PROP_NEXT_URI:
+      g_mutex_lock(&priv->tracks_lock);
+      g_free(priv->next_uri);
+      priv->next_uri = g_value_dup_string(value);
+      g_mutex_unlock(&priv->tracks_lock);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -322,12 +1332,137 @@ gst_spotify_src_get_property (GObject * object, guint prop_id, GValue * value,
   case PROP_PASS:
 	g_value_set_string(value, priv->pass);
     break;
+  case PROP_CREDENTIALS_BLOB:
+    GST_OBJECT_LOCK (spotifysrc);
+    g_value_set_string(value, priv->credentials_blob);
+    GST_OBJECT_UNLOCK (spotifysrc);
+    break;
+  case PROP_REMEMBER_ME:
+    g_value_set_boolean(value, priv->remember_me);
+    break;
   case PROP_APPKEY_FILE:
 	g_value_set_string(value, priv->appkey_file);
     break;
   case PROP_URI:
 	g_value_set_string(value, priv->uri);
     break;
+  case PROP_LOGIN_TIMEOUT:
+    g_value_set_uint(value, priv->login_timeout);
+    break;
+  case PROP_LOAD_TIMEOUT:
+    g_value_set_uint(value, priv->load_timeout);
+    break;
+  case PROP_SESSION_LINGER:
+    g_value_set_uint(value, priv->session_linger);
+    break;
+  case PROP_ACCOUNTS:
+    g_value_set_boxed(value, priv->accounts);
+    break;
+  case PROP_SESSION_AFFINITY:
+    g_value_set_boolean(value, priv->session_affinity);
+    break;
+  case PROP_BUFFER_DURATION:
+    g_value_set_uint64(value, priv->buffer_duration);
+    break;
+  case PROP_MAX_BYTES:
+    g_value_set_uint64(value, priv->max_bytes);
+    break;
+  case PROP_MAX_TIME:
+    g_value_set_uint64(value, priv->max_time);
+    break;
+  case PROP_LOW_WATERMARK:
+    g_value_set_double(value, priv->low_watermark);
+    break;
+  case PROP_HIGH_WATERMARK:
+    g_value_set_double(value, priv->high_watermark);
+    break;
+  case PROP_IS_LIVE:
+    g_value_set_boolean(value, gst_base_src_is_live (GST_BASE_SRC (spotifysrc)));
+    break;
+  case PROP_ASYNC_START:
+    g_value_set_boolean(value, gst_base_src_is_async (GST_BASE_SRC (spotifysrc)));
+    break;
+  case PROP_BULK:
+    g_value_set_boolean(value, priv->bulk);
+    break;
+  case PROP_LOOP_ITERATIONS:
+  case PROP_LOOP_WAKEUPS:
+  {
+    guint64 iterations = 0, wakeups = 0;
+
+    g_mutex_lock(&priv->mutex);
+    if (priv->spotify_context)
+      spotify_session_get_loop_stats(priv->spotify_context, &iterations,
+                                     &wakeups);
+    g_mutex_unlock(&priv->mutex);
+    g_value_set_uint64(value,
+                       prop_id == PROP_LOOP_ITERATIONS ? iterations : wakeups);
+    break;
+  }
+  case PROP_SEEK_TIMEOUT:
+    g_value_set_uint(value, priv->seek_timeout);
+    break;
+  case PROP_MAX_RECONNECTS:
+    g_value_set_uint(value, priv->max_reconnects);
+    break;
+  case PROP_SEEK_LATENCY:
+    g_value_set_uint64(value, priv->seek_latency);
+    break;
+  case PROP_STATS:
+    g_value_take_boxed(value, gst_spotify_src_get_stats(spotifysrc));
+    break;
+  case PROP_CACHE_LOCATION:
+    g_value_set_string(value, priv->cache_location);
+    break;
+  case PROP_SETTINGS_LOCATION:
+    g_value_set_string(value, priv->settings_location);
+    break;
+  case PROP_PCM_CACHE_LOCATION:
+    GST_OBJECT_LOCK (spotifysrc);
+    g_value_set_string(value, priv->pcm_cache_location);
+    GST_OBJECT_UNLOCK (spotifysrc);
+    break;
+  case PROP_CACHE_SIZE:
+    g_value_set_uint(value, priv->cache_size);
+    break;
+  case PROP_BITRATE:
+    g_value_set_enum(value, priv->bitrate);
+    break;
+  case PROP_VOLUME_NORMALIZATION:
+    g_value_set_boolean(value, priv->volume_normalization);
+    break;
+  case PROP_OUTPUT_FORMAT:
+    GST_OBJECT_LOCK (spotifysrc);
+    g_value_set_enum(value, priv->output_format);
+    GST_OBJECT_UNLOCK (spotifysrc);
+    break;
+  case PROP_GAIN:
+    GST_OBJECT_LOCK (spotifysrc);
+    g_value_set_double(value, priv->gain);
+    GST_OBJECT_UNLOCK (spotifysrc);
+    break;
+#ifdef HAVE_VORBISENC
+  case PROP_VORBIS_QUALITY:
+    GST_OBJECT_LOCK (spotifysrc);
+    g_value_set_float(value, priv->vorbis_quality);
+    GST_OBJECT_UNLOCK (spotifysrc);
+    break;
+#endif
+  case PROP_CONNECTION_TYPE:
+    g_mutex_lock(&priv->mutex);
+    g_value_set_enum(value, priv->connection_type);
+    g_mutex_unlock(&priv->mutex);
+    break;
+  case PROP_SYNC_OVER_MOBILE:
+    g_mutex_lock(&priv->mutex);
+    g_value_set_boolean(value, priv->sync_over_mobile);
+    g_mutex_unlock(&priv->mutex);
+    break;
+  case PROP_NEXT_URI:
+    g_mutex_lock(&priv->tracks_lock);
+    g_value_set_string(value, priv->next_uri);
+    g_mutex_unlock(&priv->tracks_lock);
+    break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -340,10 +1475,17 @@ gst_spotify_src_unlock (GstBaseSrc * bsrc)
   GstSpotifySrc *spotifysrc = GST_SPOTIFY_SRC_CAST (bsrc);
   GstSpotifySrcPrivate *priv = spotifysrc->priv;
 
+  /* Before taking the lock, which a login or load may be holding */
+  g_atomic_int_set (&priv->cancel, TRUE);
+  spotify_session_cancel (spotifysrc);
+
   g_mutex_lock(&priv->mutex);
   GST_DEBUG_OBJECT (spotifysrc, "unlock start");
-  priv->flushing = TRUE;
-  g_cond_broadcast(&priv->cond);
+  g_atomic_int_set (&priv->flushing, TRUE);
+  if (priv->ring)
+    gst_spotify_ring_kick (priv->ring);
+  if (priv->pcm_cache)
+    gst_spotify_pcm_cache_kick (priv->pcm_cache);
   g_mutex_unlock(&priv->mutex);
 
   return TRUE;
@@ -357,44 +1499,251 @@ gst_spotify_src_unlock_stop (GstBaseSrc * bsrc)
 
   g_mutex_lock(&priv->mutex);
   GST_DEBUG_OBJECT (spotifysrc, "unlock stop");
-  priv->flushing = FALSE;
-  g_cond_broadcast(&priv->cond);
+  g_atomic_int_set (&priv->flushing, FALSE);
+  g_atomic_int_set (&priv->cancel, FALSE);
+  /* a live source is unlocked when paused, catch up with the clock */
+  priv->live_resync = TRUE;
   g_mutex_unlock(&priv->mutex);
 
   return TRUE;
 }
 
+/* Log in and load the track, in start() or its own thread */
 static gboolean
-gst_spotify_src_start (GstBaseSrc * bsrc)
+gst_spotify_src_do_start (GstBaseSrc * bsrc)
 {
   GstSpotifySrc *spotifysrc = GST_SPOTIFY_SRC_CAST (bsrc);
   GstSpotifySrcPrivate *priv = spotifysrc->priv;
-  gboolean has_created, has_logged_in, has_started;
+  GstSpotifySessionContext *context;
+  GstTagList *tags;
+  GstSpotifyPcmCache *cache, *old_cache;
+  gchar *location;
+  gboolean res;
+  guint limit, bpf;
+  gint rate;
+  gint64 begin;
 
   g_mutex_lock(&priv->mutex);
   GST_DEBUG_OBJECT (spotifysrc, "starting");
   priv->is_first_seek = TRUE;
-  priv->flushing = FALSE;
+  g_atomic_int_set (&priv->flushing, FALSE);
+  g_atomic_int_set (&priv->is_eos, FALSE);
+  g_atomic_int_set (&priv->is_full, FALSE);
+  g_atomic_int_set (&priv->buffering, TRUE);
+  g_atomic_int_set (&priv->buffering_percent, -1);
+  g_atomic_int_set (&priv->unreported_stutter, 0);
   priv->stutter = 0;
+  g_atomic_int_set (&priv->buffers_pushed, 0);
+  g_atomic_int_set (&priv->underruns, 0);
+  g_atomic_int_set (&priv->deliveries, 0);
+  g_atomic_int_set (&priv->deliveries_dropped, 0);
+  g_atomic_int_set (&priv->deliveries_rejected, 0);
+  g_atomic_int_set (&priv->reconnects, 0);
+  g_atomic_int_set (&priv->tracks_delivered, 0);
+  g_atomic_int_set (&priv->recover, GST_SPOTIFY_SRC_RECOVER_NONE);
+  priv->start_time = g_get_monotonic_time ();
+  GST_OBJECT_LOCK (spotifysrc);
   priv->buffer_timestamp = 0;
+  GST_OBJECT_UNLOCK (spotifysrc);
+  priv->track_position = 0;
+  priv->live_resync = TRUE;
+  g_atomic_int_set (&priv->seek_seqnum, 0);
+  g_atomic_int_set (&priv->delivery_seqnum, 0);
+  priv->seek_pending = FALSE;
+  priv->seek_start = 0;
+  priv->seek_latency = 0;
+
+  /* Sized for the format of the last delivery, the next track is most
+   * likely the same */
+  rate = g_atomic_int_get (&priv->rate);
+  bpf = g_atomic_int_get (&priv->channels) * sizeof(gint16);
+
+  /* No session is delivering yet, so the ring can be replaced safely */
+  limit = CLAMP (priv->max_bytes, 2 * sizeof(gint16), G_MAXINT / 2);
+  if (priv->max_time)
+    limit = CLAMP (gst_util_uint64_scale (priv->max_time, rate, GST_SECOND) *
+        bpf, 2 * sizeof(gint16), limit);
+  /* Room for libspotify to run ahead of a pipeline that isn't draining */
+  if (priv->bulk)
+    limit = MAX (limit, MIN (gst_util_uint64_scale (SPOTIFY_BULK_QUEUE_TIME,
+                rate, GST_SECOND) * bpf, G_MAXINT / 2));
+  if (priv->ring == NULL || gst_spotify_ring_get_limit (priv->ring) != limit) {
+    GstSpotifyRing *old_ring;
+
+    /* The buffering query looks at the ring under the object lock */
+    GST_OBJECT_LOCK (spotifysrc);
+    old_ring = priv->ring;
+    priv->ring = gst_spotify_ring_new (limit);
+    GST_OBJECT_UNLOCK (spotifysrc);
+    gst_spotify_ring_free (old_ring);
+  } else {
+    gst_spotify_ring_clear (priv->ring);
+  }
 
-  has_created = has_logged_in = has_started = FALSE;
-  if (!(has_created = spotify_create(priv->appkey_file)) ||
-      !(has_logged_in = spotify_login(priv->spotify_context, priv->user, priv->pass)) ||
-      !(has_started = spotify_play(priv->spotify_context, gst_uri_get_location(priv->uri))))
-  {
-    if (!has_created) GST_DEBUG_OBJECT(spotifysrc, "Could not instantiate Spotify");
-    if (!has_logged_in) GST_DEBUG_OBJECT(spotifysrc, "Could not log in to Spotify");
-    if (!has_started) GST_DEBUG_OBJECT(spotifysrc, "Could not play track URI");
+  /* 0 pushes out whatever has been delivered */
+  priv->block_size = gst_util_uint64_scale_int (priv->buffer_duration, rate,
+      GST_SECOND) * bpf;
+  if (priv->buffer_duration && priv->block_size == 0)
+    priv->block_size = 2 * sizeof(gint16);
+  priv->block_size = MIN (priv->block_size, limit & ~(2 * sizeof(gint16) - 1));
+
+  priv->low_level = limit * MIN (priv->low_watermark, priv->high_watermark);
+  priv->high_level = limit * priv->high_watermark;
+
+  cache = NULL;
+  if (priv->pcm_cache_location) {
+    location = gst_uri_get_location(priv->uri);
+    cache = gst_spotify_src_open_pcm_cache(spotifysrc, location);
+    g_free(location);
+  }
+
+  /* Left over when the last start() failed */
+  GST_OBJECT_LOCK (spotifysrc);
+  old_cache = priv->pcm_cache;
+  priv->pcm_cache = cache;
+  GST_OBJECT_UNLOCK (spotifysrc);
+  gst_spotify_pcm_cache_unref (old_cache);
+
+  /* A track that was spooled completely needs no session at all */
+  if (priv->pcm_cache && gst_spotify_pcm_cache_is_complete(priv->pcm_cache)) {
+    gint channels;
+
+    gst_spotify_pcm_cache_get_format(priv->pcm_cache, &rate, &channels);
+    GST_DEBUG_OBJECT (spotifysrc, "serving %s from the PCM cache, %d Hz, "
+        "%d channels", priv->uri, rate, channels);
+    g_atomic_int_set (&priv->rate, rate);
+    g_atomic_int_set (&priv->channels, channels);
+    g_atomic_int_set (&priv->format_changed, TRUE);
+    priv->started = TRUE;
+    g_mutex_unlock(&priv->mutex);
+
+    gst_base_src_set_format (bsrc, GST_FORMAT_BYTES);
+    return TRUE;
+  }
+
+  /* Reusing a lingering session skips the login altogether, and leaves the
+   * latency of the last one */
+  if (priv->spotify_context == NULL) {
+    GstSpotifySessionConfig config;
+    gchar *blob;
+
+    /* Can be replaced from libspotify while logging in */
+    GST_OBJECT_LOCK (spotifysrc);
+    blob = g_strdup (priv->credentials_blob);
+    GST_OBJECT_UNLOCK (spotifysrc);
+
+    config.user = priv->user;
+    config.password = priv->pass;
+    config.credentials_blob = blob;
+    config.remember_me = priv->remember_me;
+    config.appkey_file = priv->appkey_file;
+    config.cache_location = priv->cache_location;
+    config.settings_location = priv->settings_location;
+    config.cache_size = priv->cache_size;
+    config.bitrate = priv->bitrate;
+    config.volume_normalization = priv->volume_normalization;
+    config.connection_type = priv->connection_type;
+    config.sync_over_mobile = priv->sync_over_mobile;
+    config.login_timeout = priv->login_timeout;
+    config.accounts = priv->accounts;
+    config.session_affinity = priv->session_affinity;
+    priv->spotify_context = spotify_session_acquire(spotifysrc, &config,
+                                                    &priv->login_latency);
+    g_free (blob);
+  }
+  if (priv->spotify_context == NULL) {
+    GST_DEBUG_OBJECT(spotifysrc, "Could not log in to Spotify");
+    g_mutex_unlock(&priv->mutex);
+    return FALSE;
+  }
 
+  begin = g_get_monotonic_time ();
+  location = gst_uri_get_location(priv->uri);
+  res = spotify_resolve(priv->spotify_context, location, priv->load_timeout,
+                        priv->tracks);
+  g_free(location);
+
+  g_mutex_lock(&priv->tracks_lock);
+  priv->track_index = 0;
+  priv->prefetched = 0;
+  priv->switch_pending = FALSE;
+  g_mutex_unlock(&priv->tracks_lock);
+
+  if (!res || !spotify_play(priv->spotify_context,
+                            g_ptr_array_index(priv->tracks, 0),
+                            priv->load_timeout, &priv->size)) {
+    GST_DEBUG_OBJECT(spotifysrc, "Could not play track URI");
+    spotify_release_tracks(priv->spotify_context, priv->tracks);
+    spotify_session_release(priv->spotify_context, priv->session_linger);
+    priv->spotify_context = NULL;
     g_mutex_unlock(&priv->mutex);
     return FALSE;
   }
 
+  priv->load_latency = (g_get_monotonic_time () - begin) * GST_USECOND;
+  GST_DEBUG_OBJECT (spotifysrc, "login took %" GST_TIME_FORMAT ", loading %"
+      GST_TIME_FORMAT, GST_TIME_ARGS (priv->login_latency),
+      GST_TIME_ARGS (priv->load_latency));
+
+  /* Whatever libspotify has not loaded yet comes from the metadata cache */
+  g_mutex_lock(&priv->spotify_context->mutex);
+  tags = spotify_track_tags_locked(priv->spotify_context,
+                                   g_ptr_array_index(priv->tracks, 0));
+  g_mutex_unlock(&priv->spotify_context->mutex);
+
+  GST_OBJECT_LOCK (spotifysrc);
+  if (priv->tags)
+    gst_tag_list_unref (priv->tags);
+  priv->tags = tags;
+  GST_OBJECT_UNLOCK (spotifysrc);
+
   priv->started = TRUE;
+  context = priv->spotify_context;
   g_mutex_unlock(&priv->mutex);
 
-  gst_base_src_set_format (bsrc, GST_FORMAT_TIME);
+  gst_spotify_src_notify_credentials (spotifysrc);
+
+  /* State changes are serialized, stop() can't release the session here */
+  gst_spotify_src_track_started (spotifysrc, context, FALSE);
+
+  /* Spooled audio is read by byte offset */
+  gst_base_src_set_format (bsrc,
+      priv->pcm_cache ? GST_FORMAT_BYTES : GST_FORMAT_TIME);
+
+  return TRUE;
+}
+
+static gpointer
+gst_spotify_src_start_thread (GstSpotifySrc * spotifysrc)
+{
+  GstBaseSrc *bsrc = GST_BASE_SRC (spotifysrc);
+
+  gst_base_src_start_complete (bsrc,
+      gst_spotify_src_do_start (bsrc) ? GST_FLOW_OK : GST_FLOW_ERROR);
+
+  return NULL;
+}
+
+/* basesrc waits for gst_base_src_start_complete() when async */
+static gboolean
+gst_spotify_src_start (GstBaseSrc * bsrc)
+{
+  GstSpotifySrc *spotifysrc = GST_SPOTIFY_SRC_CAST (bsrc);
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+
+  /* Left set by the unlock() before the last stop() */
+  g_atomic_int_set (&priv->cancel, FALSE);
+
+  if (!gst_base_src_is_async (bsrc))
+    return gst_spotify_src_do_start (bsrc);
+
+  /* Left over when the last start failed without a stop */
+  if (priv->start_thread)
+    g_thread_join (priv->start_thread);
+
+  GST_DEBUG_OBJECT (spotifysrc, "starting asynchronously");
+  priv->start_thread = g_thread_new ("spotify-start",
+      (GThreadFunc) gst_spotify_src_start_thread, spotifysrc);
 
   return TRUE;
 }
@@ -404,26 +1753,71 @@ gst_spotify_src_stop (GstBaseSrc * bsrc)
 {
   GstSpotifySrc *spotifysrc = GST_SPOTIFY_SRC_CAST (bsrc);
   GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstSpotifyPcmCache *cache;
+
+  /* A start still logging in or loading gives up right away */
+  g_atomic_int_set (&priv->cancel, TRUE);
+  spotify_session_cancel (spotifysrc);
+  if (priv->start_thread) {
+    if (priv->start_thread != g_thread_self ())
+      g_thread_join (priv->start_thread);
+    else
+      g_thread_unref (priv->start_thread);
+    priv->start_thread = NULL;
+  }
 
   g_mutex_lock(&priv->mutex);
   GST_DEBUG_OBJECT (spotifysrc, "stopping");
-  priv->is_eos = FALSE;
-  priv->flushing = TRUE;
-
-  spotify_stop(priv->spotify_context);
+  g_atomic_int_set (&priv->is_eos, FALSE);
+  g_atomic_int_set (&priv->flushing, TRUE);
+
+  if (priv->spotify_context) {
+    spotify_stop(priv->spotify_context);
+    gst_spotify_src_clear_warmups(spotifysrc, priv->spotify_context);
+    spotify_release_tracks(priv->spotify_context, priv->tracks);
+    spotify_session_release(priv->spotify_context, priv->session_linger);
+    priv->spotify_context = NULL;
+  }
+  /* Reset total track size */
+  priv->size = -1;
   gst_spotify_src_flush_queued (spotifysrc);
-  spotify_destroy(priv->spotify_context);
+
+#ifdef HAVE_VORBISENC
+  gst_spotify_src_clear_vorbis (spotifysrc);
+#endif
+
+  /* An unfinished spool is dropped with the last reference */
+  GST_OBJECT_LOCK (spotifysrc);
+  cache = priv->pcm_cache;
+  priv->pcm_cache = NULL;
+  GST_OBJECT_UNLOCK (spotifysrc);
+  gst_spotify_pcm_cache_unref (cache);
+
+  GST_OBJECT_LOCK (spotifysrc);
+  if (priv->tags) {
+    gst_tag_list_unref (priv->tags);
+    priv->tags = NULL;
+  }
+  GST_OBJECT_UNLOCK (spotifysrc);
 
   priv->started = FALSE;
   g_mutex_unlock(&priv->mutex);
 
+  gst_spotify_src_notify_credentials (spotifysrc);
+
   return TRUE;
 }
 
 static gboolean
 gst_spotify_src_is_seekable (GstBaseSrc * src)
 {
-  return TRUE;
+  GstSpotifySrc *spotifysrc = GST_SPOTIFY_SRC_CAST (src);
+
+  if (spotifysrc->priv->pcm_cache)
+    return TRUE;
+
+  /* Live timestamps follow the clock, not the track position */
+  return !gst_base_src_is_live (src);
 }
 
 static gboolean
@@ -431,6 +1825,10 @@ gst_spotify_src_do_get_size (GstBaseSrc * src, guint64 * size)
 {
   GstSpotifySrc *spotifysrc = GST_SPOTIFY_SRC_CAST (src);
 
+  /* In bytes of output when reading from the PCM cache */
+  if (spotifysrc->priv->pcm_cache)
+    return gst_spotify_src_get_cached_size (spotifysrc, size);
+
   /* This track size is loaded upon a play request and stored
    * in priv->size
    */
@@ -442,6 +1840,8 @@ gst_spotify_src_do_get_size (GstBaseSrc * src, guint64 * size)
 static gboolean
 gst_spotify_src_query (GstBaseSrc * src, GstQuery * query)
 {
+  GstSpotifySrc *spotifysrc = GST_SPOTIFY_SRC_CAST (src);
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
   gboolean res;
 
   switch (GST_QUERY_TYPE (query)) {
@@ -453,21 +1853,86 @@ gst_spotify_src_query (GstBaseSrc * src, GstQuery * query)
       /* Query the parent class for the defaults */
       res = gst_base_src_query_latency (src, &live, &min, &max);
 
-      /* FIXME: Can we get spotify latency? */
+      /* A buffer is pushed once a whole block has been delivered, and up
+       * to the full queue may be waiting in front of it */
+      if (res && live && priv->ring) {
+        min = gst_spotify_src_bytes_to_time (spotifysrc,
+            priv->block_size ? priv->block_size : DEFAULT_BUFFER_SIZE);
+        max = gst_spotify_src_bytes_to_time (spotifysrc,
+            gst_spotify_ring_get_limit (priv->ring));
+        max = MAX (min, max);
+      }
+      GST_DEBUG_OBJECT (spotifysrc, "latency live %d min %" GST_TIME_FORMAT
+          " max %" GST_TIME_FORMAT, live, GST_TIME_ARGS (min),
+          GST_TIME_ARGS (max));
+
       gst_query_set_latency (query, live, min, max);
       break;
     }
+    case GST_QUERY_BUFFERING:
+    {
+      GstClockTime start, queued;
+      guint level;
+
+      /* start() replaces the ring under the object lock */
+      GST_OBJECT_LOCK (spotifysrc);
+      if (priv->ring == NULL) {
+        GST_OBJECT_UNLOCK (spotifysrc);
+        res = GST_BASE_SRC_CLASS (parent_class)->query (src, query);
+        break;
+      }
+      level = gst_spotify_ring_get_level (priv->ring);
+      start = priv->buffer_timestamp;
+      GST_OBJECT_UNLOCK (spotifysrc);
+      queued = gst_spotify_src_bytes_to_time (spotifysrc, level);
+
+      if (gst_base_src_is_live (src))
+        gst_query_set_buffering_percent (query, FALSE, 100);
+      else
+        gst_query_set_buffering_percent (query,
+            g_atomic_int_get (&priv->buffering),
+            MAX (g_atomic_int_get (&priv->buffering_percent), 0));
+      gst_query_set_buffering_stats (query, GST_BUFFERING_STREAM, -1, -1, -1);
+      gst_query_set_buffering_range (query, GST_FORMAT_TIME, start,
+          start + queued, -1);
+      res = TRUE;
+      break;
+    }
     case GST_QUERY_SCHEDULING:
     {
+      gchar *cache_location = NULL, *location = NULL, *key;
+      gboolean seekable;
+
+      /* Asked before starting as well, so look for a complete cache of the
+       * URI without creating one */
+      GST_OBJECT_LOCK (spotifysrc);
+      seekable = priv->pcm_cache != NULL;
+      if (!seekable && priv->pcm_cache_location && priv->uri) {
+        cache_location = g_strdup (priv->pcm_cache_location);
+        location = gst_uri_get_location (priv->uri);
+      }
+      GST_OBJECT_UNLOCK (spotifysrc);
+      key = gst_spotify_src_get_pcm_cache_key (location);
+      if (cache_location && key)
+        seekable = gst_spotify_pcm_cache_exists (cache_location, key);
+      g_free (key);
+      g_free (cache_location);
+      g_free (location);
+      if (seekable) {
+        gst_query_set_scheduling (query, GST_SCHEDULING_FLAG_SEEKABLE, 1, -1,
+            0);
+        gst_query_add_scheduling_mode (query, GST_PAD_MODE_PULL);
+      }
       gst_query_add_scheduling_mode (query, GST_PAD_MODE_PUSH);
       res = TRUE;
       break;
     }
     case GST_QUERY_CAPS:
     {
-      GstCaps *caps;
+      GstCaps *caps, *filter;
 
-      caps = gst_static_pad_template_get_caps (&gst_spotify_src_template);
+      gst_query_parse_caps (query, &filter);
+      caps = gst_spotify_src_get_caps (spotifysrc, filter);
       gst_query_set_caps_result (query, caps);
       gst_caps_unref (caps);
       res = TRUE;
@@ -481,6 +1946,429 @@ gst_spotify_src_query (GstBaseSrc * src, GstQuery * query)
   return res;
 }
 
+/* Formats we can produce from what libspotify delivers now: any of the
+ * template formats, or the output-format, at the delivered rate,
+ * downmixed to mono or not.  Reads from the PCM cache are raw only. */
+static GstCaps *
+gst_spotify_src_get_caps (GstSpotifySrc * spotifysrc, GstCaps * filter)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstSpotifyOutputFormat output_format;
+  GstCaps *caps, *result;
+  const gchar *format;
+
+  caps = gst_static_pad_template_get_caps (&gst_spotify_src_template);
+  caps = gst_caps_make_writable (caps);
+  gst_caps_set_simple (caps, "rate", G_TYPE_INT,
+      g_atomic_int_get (&priv->rate), NULL);
+  if (g_atomic_int_get (&priv->channels) == 1)
+    gst_caps_set_simple (caps, "channels", G_TYPE_INT, 1, NULL);
+
+  GST_OBJECT_LOCK (spotifysrc);
+  output_format = priv->output_format;
+  GST_OBJECT_UNLOCK (spotifysrc);
+  switch (output_format) {
+    case GST_SPOTIFY_OUTPUT_FORMAT_S16:
+      format = GST_AUDIO_NE (S16);
+      break;
+    case GST_SPOTIFY_OUTPUT_FORMAT_S32:
+      format = GST_AUDIO_NE (S32);
+      break;
+    case GST_SPOTIFY_OUTPUT_FORMAT_F32:
+      format = GST_AUDIO_NE (F32);
+      break;
+    default:
+      format = NULL;
+      break;
+  }
+
+  /* Raw comes first */
+  if (format || priv->pcm_cache)
+    caps = gst_caps_truncate (caps);
+  if (format)
+    gst_caps_set_simple (caps, "format", G_TYPE_STRING, format, NULL);
+  if (output_format == GST_SPOTIFY_OUTPUT_FORMAT_VORBIS) {
+    if (gst_caps_get_size (caps) > 1) {
+      gst_caps_remove_structure (caps, 0);
+    } else {
+      gst_caps_unref (caps);
+      caps = gst_caps_new_empty ();
+    }
+  }
+
+  if (filter) {
+    result = gst_caps_intersect_full (filter, caps, GST_CAPS_INTERSECT_FIRST);
+    gst_caps_unref (caps);
+    caps = result;
+  }
+
+  return caps;
+}
+
+/* Prefer passing the delivered audio through untouched */
+static GstCaps *
+gst_spotify_src_fixate (GstBaseSrc * src, GstCaps * caps)
+{
+  GstSpotifySrc *spotifysrc = GST_SPOTIFY_SRC_CAST (src);
+  GstStructure *structure;
+
+  caps = gst_caps_truncate (gst_caps_make_writable (caps));
+  structure = gst_caps_get_structure (caps, 0);
+  if (gst_structure_has_name (structure, "audio/x-raw"))
+    gst_structure_fixate_field_string (structure, "format",
+        GST_AUDIO_NE (S16));
+  gst_structure_fixate_field_nearest_int (structure, "channels",
+      g_atomic_int_get (&spotifysrc->priv->channels));
+
+  return GST_BASE_SRC_CLASS (parent_class)->fixate (src, caps);
+}
+
+static gboolean
+gst_spotify_src_set_caps (GstBaseSrc * src, GstCaps * caps)
+{
+  GstSpotifySrc *spotifysrc = GST_SPOTIFY_SRC_CAST (src);
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstAudioInfo info;
+  gdouble gain;
+
+  if (gst_structure_has_name (gst_caps_get_structure (caps, 0),
+          "audio/x-vorbis"))
+    return gst_spotify_src_set_vorbis_caps (spotifysrc,
+        gst_caps_get_structure (caps, 0));
+
+  if (!gst_audio_info_from_caps (&info, caps))
+    goto invalid_caps;
+
+  /* Delivered audio is never resampled */
+  if (GST_AUDIO_INFO_RATE (&info) != g_atomic_int_get (&priv->rate))
+    goto invalid_caps;
+
+  GST_OBJECT_LOCK (spotifysrc);
+  gain = priv->gain;
+  GST_OBJECT_UNLOCK (spotifysrc);
+
+  if (!gst_spotify_convert_init (&priv->convert,
+          g_atomic_int_get (&priv->channels), GST_AUDIO_INFO_FORMAT (&info),
+          GST_AUDIO_INFO_CHANNELS (&info), gain))
+    goto invalid_caps;
+
+  GST_DEBUG_OBJECT (spotifysrc, "producing %" GST_PTR_FORMAT " with %s "
+      "kernels", caps, gst_spotify_convert_get_impl_name ());
+#ifdef HAVE_VORBISENC
+  gst_spotify_src_clear_vorbis (spotifysrc);
+#endif
+
+  return TRUE;
+
+  /* ERRORS */
+invalid_caps:
+  {
+    GST_WARNING_OBJECT (spotifysrc, "unsupported caps %" GST_PTR_FORMAT, caps);
+    return FALSE;
+  }
+}
+
+/* Our own caps again once the stream headers were added keep the
+ * encoder, anything else starts a new stream */
+static gboolean
+gst_spotify_src_set_vorbis_caps (GstSpotifySrc * spotifysrc,
+    const GstStructure * structure)
+{
+#ifdef HAVE_VORBISENC
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstSpotifyVorbis *vorbis;
+  gint rate, channels;
+  gdouble gain;
+  gfloat quality;
+
+  if (!gst_structure_get_int (structure, "rate", &rate) ||
+      !gst_structure_get_int (structure, "channels", &channels) ||
+      rate != g_atomic_int_get (&priv->rate))
+    goto invalid_caps;
+
+  if (priv->vorbis && gst_structure_has_field (structure, "streamheader") &&
+      gst_spotify_vorbis_get_rate (priv->vorbis) == rate &&
+      gst_spotify_vorbis_get_channels (priv->vorbis) == channels)
+    return TRUE;
+
+  GST_OBJECT_LOCK (spotifysrc);
+  gain = priv->gain;
+  quality = priv->vorbis_quality;
+  GST_OBJECT_UNLOCK (spotifysrc);
+
+  if (!gst_spotify_convert_init (&priv->convert,
+          g_atomic_int_get (&priv->channels), GST_AUDIO_FORMAT_F32, channels,
+          gain))
+    goto invalid_caps;
+
+  vorbis = gst_spotify_vorbis_new (rate, channels, quality);
+  if (vorbis == NULL)
+    goto invalid_caps;
+
+  gst_spotify_src_clear_vorbis (spotifysrc);
+  priv->vorbis = vorbis;
+  priv->vorbis_headers_pending = TRUE;
+
+  GST_DEBUG_OBJECT (spotifysrc, "encoding Vorbis at quality %.1f, %d Hz, "
+      "%d channels", quality, rate, channels);
+
+  return TRUE;
+
+  /* ERRORS */
+invalid_caps:
+  {
+    GST_WARNING_OBJECT (spotifysrc, "unsupported caps %" GST_PTR_FORMAT,
+        structure);
+    return FALSE;
+  }
+#else
+  return FALSE;
+#endif
+}
+
+#ifdef HAVE_VORBISENC
+/* Drop packets not pushed yet and what they were timed by */
+static void
+gst_spotify_src_flush_vorbis (GstSpotifySrc * spotifysrc)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstBuffer *buf;
+
+  while ((buf = g_queue_pop_head (&priv->vorbis_packets)))
+    gst_buffer_unref (buf);
+  while (!g_queue_is_empty (&priv->vorbis_chunks))
+    g_slice_free (GstSpotifySrcVorbisChunk,
+        g_queue_pop_head (&priv->vorbis_chunks));
+}
+
+static void
+gst_spotify_src_clear_vorbis (GstSpotifySrc * spotifysrc)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+
+  gst_spotify_src_flush_vorbis (spotifysrc);
+  gst_spotify_vorbis_free (priv->vorbis);
+  priv->vorbis = NULL;
+  priv->vorbis_fed = 0;
+  priv->vorbis_headers_pending = FALSE;
+  priv->vorbis_eos = FALSE;
+}
+
+/* A seek starts a new stream with fresh headers.  The old encoder still
+ * holds back audio from before the seek, which would come out at the new
+ * position and overlap into the new audio. */
+static void
+gst_spotify_src_reset_vorbis (GstSpotifySrc * spotifysrc)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstSpotifyVorbis *vorbis;
+  gfloat quality;
+
+  gst_spotify_src_flush_vorbis (spotifysrc);
+  if (priv->vorbis == NULL)
+    return;
+
+  GST_OBJECT_LOCK (spotifysrc);
+  quality = priv->vorbis_quality;
+  GST_OBJECT_UNLOCK (spotifysrc);
+
+  vorbis = gst_spotify_vorbis_new (gst_spotify_vorbis_get_rate (priv->vorbis),
+      gst_spotify_vorbis_get_channels (priv->vorbis), quality);
+  gst_spotify_src_clear_vorbis (spotifysrc);
+  priv->vorbis = vorbis;
+  priv->vorbis_headers_pending = (vorbis != NULL);
+}
+
+/* Stream headers go into the caps for muxers and out ahead of the audio */
+static void
+gst_spotify_src_queue_vorbis_headers (GstSpotifySrc * spotifysrc)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstBaseSrc *bsrc = GST_BASE_SRC (spotifysrc);
+  GValue array = G_VALUE_INIT;
+  GstCaps *caps;
+  guint i;
+
+  priv->vorbis_headers_pending = FALSE;
+  caps = gst_pad_get_current_caps (GST_BASE_SRC_PAD (bsrc));
+  if (caps == NULL)
+    return;
+  caps = gst_caps_make_writable (caps);
+
+  g_value_init (&array, GST_TYPE_ARRAY);
+  for (i = 0; i < 3; i++) {
+    GstBuffer *header = gst_spotify_vorbis_get_header (priv->vorbis, i);
+    GValue value = G_VALUE_INIT;
+
+    g_value_init (&value, GST_TYPE_BUFFER);
+    gst_value_set_buffer (&value, header);
+    gst_value_array_append_value (&array, &value);
+    g_value_unset (&value);
+    g_queue_push_tail (&priv->vorbis_packets, header);
+  }
+  gst_structure_set_value (gst_caps_get_structure (caps, 0), "streamheader",
+      &array);
+  g_value_unset (&array);
+
+  if (!gst_base_src_set_caps (bsrc, caps))
+    GST_WARNING_OBJECT (spotifysrc, "could not add the stream headers");
+  gst_caps_unref (caps);
+}
+
+/* Feed converted audio, NULL ending the stream, and queue the packets it
+ * completes.  Packets are timed by the buffer their first sample was in,
+ * so timestamps follow seeks and track changes. */
+static void
+gst_spotify_src_encode_vorbis (GstSpotifySrc * spotifysrc, GstBuffer * pcm)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstSpotifySrcVorbisChunk *chunk;
+  GstBuffer *packet;
+  GstMapInfo info;
+  guint64 start, end;
+  guint n_frames;
+  gint rate, channels;
+
+  rate = gst_spotify_vorbis_get_rate (priv->vorbis);
+  channels = gst_spotify_vorbis_get_channels (priv->vorbis);
+
+  if (pcm) {
+    gst_buffer_map (pcm, &info, GST_MAP_READ);
+    n_frames = info.size / (channels * sizeof(gfloat));
+    if (n_frames > 0) {
+      chunk = g_slice_new (GstSpotifySrcVorbisChunk);
+      chunk->granulepos = priv->vorbis_fed;
+      chunk->timestamp = GST_BUFFER_TIMESTAMP (pcm);
+      g_queue_push_tail (&priv->vorbis_chunks, chunk);
+
+      gst_spotify_vorbis_write (priv->vorbis, (const gfloat *) info.data,
+          n_frames);
+      priv->vorbis_fed += n_frames;
+    }
+    gst_buffer_unmap (pcm, &info);
+  } else {
+    gst_spotify_vorbis_write (priv->vorbis, NULL, 0);
+  }
+
+  while ((packet = gst_spotify_vorbis_pull (priv->vorbis, &start))) {
+    end = GST_BUFFER_OFFSET_END (packet);
+
+    while (g_queue_get_length (&priv->vorbis_chunks) > 1) {
+      GstSpotifySrcVorbisChunk *next =
+          g_queue_peek_nth (&priv->vorbis_chunks, 1);
+
+      if (next->granulepos > start)
+        break;
+      g_slice_free (GstSpotifySrcVorbisChunk,
+          g_queue_pop_head (&priv->vorbis_chunks));
+    }
+
+    /* Audio from before a seek may still be coming out */
+    chunk = g_queue_peek_head (&priv->vorbis_chunks);
+    if (chunk && GST_CLOCK_TIME_IS_VALID (chunk->timestamp)) {
+      if (start >= chunk->granulepos)
+        GST_BUFFER_TIMESTAMP (packet) = chunk->timestamp +
+            gst_util_uint64_scale_int (start - chunk->granulepos, GST_SECOND,
+            rate);
+      else
+        GST_BUFFER_TIMESTAMP (packet) = chunk->timestamp;
+    }
+    if (end > start)
+      GST_BUFFER_DURATION (packet) =
+          gst_util_uint64_scale_int (end - start, GST_SECOND, rate);
+
+    g_queue_push_tail (&priv->vorbis_packets, packet);
+  }
+}
+
+/* The encoder holds audio back until it completes a packet, so this may
+ * take several buffers of PCM */
+static GstFlowReturn
+gst_spotify_src_create_vorbis (GstSpotifySrc * spotifysrc, guint64 offset,
+    guint size, GstBuffer ** buf)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstFlowReturn ret;
+  GstBuffer *pcm;
+
+  while (g_queue_is_empty (&priv->vorbis_packets)) {
+    if (priv->vorbis_eos)
+      return GST_FLOW_EOS;
+
+    ret = gst_spotify_src_create_pcm (GST_BASE_SRC (spotifysrc), offset,
+        size, &pcm);
+    if (ret == GST_FLOW_EOS) {
+      pcm = NULL;
+      priv->vorbis_eos = TRUE;
+    } else if (ret != GST_FLOW_OK) {
+      return ret;
+    }
+
+    /* Renegotiated to raw while reading */
+    if (G_UNLIKELY (priv->vorbis == NULL)) {
+      *buf = pcm;
+      return ret;
+    }
+
+    if (G_UNLIKELY (priv->vorbis_headers_pending))
+      gst_spotify_src_queue_vorbis_headers (spotifysrc);
+    gst_spotify_src_encode_vorbis (spotifysrc, pcm);
+    if (pcm)
+      gst_buffer_unref (pcm);
+  }
+
+  *buf = g_queue_pop_head (&priv->vorbis_packets);
+  return GST_FLOW_OK;
+}
+#endif
+
+static gboolean
+gst_spotify_src_decide_allocation (GstBaseSrc * src, GstQuery * query)
+{
+  GstSpotifySrc *spotifysrc = GST_SPOTIFY_SRC_CAST (src);
+  GstBufferPool *pool = NULL;
+  GstStructure *config;
+  GstCaps *caps;
+  guint size, min, max;
+  gboolean update;
+
+  gst_query_parse_allocation (query, &caps, NULL);
+
+  update = gst_query_get_n_allocation_pools (query) > 0;
+  if (update) {
+    gst_query_parse_nth_allocation_pool (query, 0, &pool, &size, &min, &max);
+  } else {
+    size = min = max = 0;
+  }
+
+  if (pool == NULL)
+    pool = gst_buffer_pool_new ();
+
+  /* Buffers are recycled while queued, so let the pool grow as needed */
+  size = MAX (size, gst_spotify_convert_get_out_size (&spotifysrc->priv->convert,
+          spotifysrc->priv->block_size ? spotifysrc->priv->block_size :
+          DEFAULT_BUFFER_SIZE));
+  max = 0;
+
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps, size, min, max);
+  if (!gst_buffer_pool_set_config (pool, config)) {
+    GST_WARNING_OBJECT (spotifysrc, "failed to configure buffer pool");
+    gst_object_unref (pool);
+    return FALSE;
+  }
+
+  GST_DEBUG_OBJECT (spotifysrc, "using buffer pool %p with size %u", pool, size);
+
+  if (update)
+    gst_query_set_nth_allocation_pool (query, 0, pool, size, min, max);
+  else
+    gst_query_add_allocation_pool (query, pool, size, min, max);
+  gst_object_unref (pool);
+
+  return GST_BASE_SRC_CLASS (parent_class)->decide_allocation (src, query);
+}
+
 /* will be called in push mode */
 static gboolean
 gst_spotify_src_do_seek (GstBaseSrc * src, GstSegment * segment)
@@ -490,6 +2378,10 @@ gst_spotify_src_do_seek (GstBaseSrc * src, GstSegment * segment)
   gint64 desired_position;
   gboolean res = FALSE;
 
+  /* create() reads from the cache at whatever offset it is asked for */
+  if (priv->pcm_cache)
+    return TRUE;
+
   desired_position = segment->position;
 
   /* This is to workaround a bug in spotify since we can't allow
@@ -502,7 +2394,7 @@ gst_spotify_src_do_seek (GstBaseSrc * src, GstSegment * segment)
   }
 
   /* Avoid seeking again if we are already at the desired position */
-  if (priv->buffer_timestamp == desired_position)
+  if (priv->buffer_timestamp == desired_position && !priv->seek_pending)
   {
     GST_DEBUG_OBJECT (spotifysrc, "already at position %" G_GINT64_FORMAT,
                       desired_position);
@@ -512,20 +2404,43 @@ gst_spotify_src_do_seek (GstBaseSrc * src, GstSegment * segment)
   GST_DEBUG_OBJECT (spotifysrc, "seeking to %" G_GINT64_FORMAT ", format %s",
       desired_position, gst_format_get_name (segment->format));
 
+  /* The flush delivery can arrive before spotify_seek() returns, so it
+   * must already find the new seqnum or it would be taken for the flush
+   * of an earlier seek */
+  g_mutex_lock(&priv->mutex);
+  g_atomic_int_inc (&priv->seek_seqnum);
+  priv->seek_pending = TRUE;
+  priv->seek_start = g_get_monotonic_time ();
+  g_mutex_unlock(&priv->mutex);
+
   res = spotify_seek(priv->spotify_context, (desired_position / GST_MSECOND));
 
   if (res) {
+    /* Don't wait for the new data here, create() drops deliveries until
+     * libspotify has flushed for this seek */
     g_mutex_lock(&priv->mutex);
     GST_DEBUG_OBJECT (spotifysrc, "flushing queue");
     gst_spotify_src_flush_queued (spotifysrc);
-    priv->is_eos = FALSE;
+    g_atomic_int_set (&priv->is_eos, FALSE);
+    g_atomic_int_set (&priv->is_full, FALSE);
+    g_atomic_int_set (&priv->buffering, TRUE);
+    g_atomic_int_set (&priv->buffering_percent, -1);
+    GST_OBJECT_LOCK (spotifysrc);
     priv->buffer_timestamp = desired_position;
-    GST_DEBUG_OBJECT (spotifysrc, "Waiting for seek to arrive...");
-    g_cond_wait(&priv->cond, &priv->mutex);
-    GST_DEBUG_OBJECT (spotifysrc, "Seek has arrived...");
+    GST_OBJECT_UNLOCK (spotifysrc);
+    priv->track_position = desired_position;
     g_mutex_unlock(&priv->mutex);
+#ifdef HAVE_VORBISENC
+    gst_spotify_src_reset_vorbis (spotifysrc);
+#endif
   } else {
+    /* No flush delivery is coming, keep taking what is queued */
     GST_WARNING_OBJECT (spotifysrc, "seek failed");
+    g_mutex_lock(&priv->mutex);
+    priv->seek_pending = FALSE;
+    g_atomic_int_set (&priv->delivery_seqnum,
+        g_atomic_int_get (&priv->seek_seqnum));
+    g_mutex_unlock(&priv->mutex);
   }
 
   return res;
@@ -536,9 +2451,38 @@ gst_spotify_src_create (GstBaseSrc * bsrc, guint64 offset, guint size,
     GstBuffer ** buf)
 {
   GstSpotifySrc *spotifysrc = GST_SPOTIFY_SRC_CAST (bsrc);
+
+  /* libspotify may have logged in again while recovering */
+  gst_spotify_src_notify_credentials (spotifysrc);
+
+#ifdef HAVE_VORBISENC
+  if (spotifysrc->priv->vorbis)
+    return gst_spotify_src_create_vorbis (spotifysrc, offset, size, buf);
+#endif
+
+  return gst_spotify_src_create_pcm (bsrc, offset, size, buf);
+}
+
+/* A buffer of converted audio, from the queue or the PCM cache */
+static GstFlowReturn
+gst_spotify_src_create_pcm (GstBaseSrc * bsrc, guint64 offset, guint size,
+    GstBuffer ** buf)
+{
+  GstSpotifySrc *spotifysrc = GST_SPOTIFY_SRC_CAST (bsrc);
   GstSpotifySrcPrivate *priv = spotifysrc->priv;
-  GstFlowReturn ret;
+  GstClockTime duration;
+  GstMapInfo info;
   GstCaps *caps;
+  GstTagList *tags;
+  GstSpotifySrcConvertRun run;
+  gdouble gain;
+  guint level, wanted, bpf, rate, kicks, buf_size = 0;
+  gint64 stall_end = 0;
+  gint recover;
+  gboolean underrun = FALSE;
+
+  if (priv->pcm_cache)
+    return gst_spotify_src_create_cached (spotifysrc, offset, size, buf);
 
   GST_OBJECT_LOCK (spotifysrc);
   caps = priv->caps ? gst_caps_ref (priv->caps) : NULL;
@@ -556,62 +2500,174 @@ gst_spotify_src_create (GstBaseSrc * bsrc, guint64 offset, guint size,
     GST_OBJECT_UNLOCK (spotifysrc);
   }
 
-  g_mutex_lock(&priv->mutex);
   /* check flushing first */
-  if (G_UNLIKELY (priv->flushing))
+  if (G_UNLIKELY (g_atomic_int_get (&priv->flushing)))
     goto flushing;
 
+  wanted = priv->block_size ? priv->block_size : 1;
   while (TRUE) {
-    /* return data as long as we have some */
-    if (!g_queue_is_empty (priv->queue)) {
-      guint buf_size;
+    /* before the flags below, so a kick after checking them is not lost */
+    kicks = gst_spotify_ring_get_kicks (priv->ring);
+
+    /* whatever is queued may predate the last seek */
+    if (G_UNLIKELY (priv->seek_pending) &&
+        !gst_spotify_src_wait_seek (spotifysrc, kicks)) {
+      if (G_UNLIKELY (g_atomic_int_get (&priv->flushing)))
+        goto flushing;
+      continue;
+    }
 
-      *buf = g_queue_pop_head (priv->queue);
-      buf_size = gst_buffer_get_size (*buf);
+    /* return data as long as we have enough */
+    level = gst_spotify_ring_get_level (priv->ring);
+    gst_spotify_src_update_buffering (spotifysrc, level);
 
-      GST_DEBUG_OBJECT (spotifysrc, "we have buffer %p of size %u", *buf, buf_size);
+    /* the end of a track goes out as a short buffer right away */
+    if (G_UNLIKELY (g_atomic_int_get (&priv->n_boundaries) > 0)) {
+      guint remaining = gst_spotify_src_check_boundary (spotifysrc);
 
-      priv->queued_bytes -= buf_size;
+      if (level >= remaining) {
+        level = remaining;
+        break;
+      }
+    }
 
-      ret = GST_FLOW_OK;
+    if (level >= wanted)
       break;
-    } else {
 
-      /* we can be flushing now because we released the lock above */
-      if (G_UNLIKELY (priv->flushing))
-        goto flushing;
+    /* a block close to max-bytes may never fit, push what we have */
+    if (level > 0 && g_atomic_int_get (&priv->is_full))
+      break;
 
-      /* if we have a buffer now, continue the loop and try to return it. In
-       * random-access mode (where a buffer is normally pushed in the above
-       * signal) we can still be empty because the pushed buffer got flushed or
-       * when the application pushes the requested buffer later, we support both
-       * possibilities. */
-      if (!g_queue_is_empty (priv->queue))
-        continue;
+    if (G_UNLIKELY (g_atomic_int_get (&priv->flushing)))
+      goto flushing;
 
-      /* no buffer yet, maybe we are EOS, if not, block for more data. */
+    /* check EOS, the last buffer may be short */
+    if (G_UNLIKELY (g_atomic_int_get (&priv->is_eos))) {
+      level = gst_spotify_ring_get_level (priv->ring);
+      if (level == 0)
+        goto eos;
+      break;
     }
 
-    /* check EOS */
-    if (G_UNLIKELY (priv->is_eos))
-      goto eos;
+    /* libspotify stopped streaming, once the queue has been played out */
+    recover = g_atomic_int_get (&priv->recover);
+    if (G_UNLIKELY (recover == GST_SPOTIFY_SRC_RECOVER_STALLED)) {
+      if (stall_end == 0)
+        stall_end = g_get_monotonic_time () +
+            priv->load_timeout * G_TIME_SPAN_MILLISECOND;
+      if (g_get_monotonic_time () >= stall_end)
+        recover = GST_SPOTIFY_SRC_RECOVER_NOW;
+    }
+    if (G_UNLIKELY (recover == GST_SPOTIFY_SRC_RECOVER_FATAL))
+      goto session_failed;
+    if (G_UNLIKELY (recover == GST_SPOTIFY_SRC_RECOVER_NOW)) {
+      if (!gst_spotify_src_recover (spotifysrc)) {
+        if (G_UNLIKELY (g_atomic_int_get (&priv->flushing)))
+          goto flushing;
+        goto session_failed;
+      }
+      stall_end = 0;
+      continue;
+    }
 
     /* nothing to return, wait a while for new data or flushing. */
-    GST_DEBUG_OBJECT (spotifysrc, "Waiting for data...");
+    GST_LOG_OBJECT (spotifysrc, "Waiting for data...");
     priv->stutter++;
-    g_cond_wait(&priv->cond, &priv->mutex);
+    /* ran dry while playing, rather than filling up after start or seek.
+     * Counted once until data arrives again, however often it waits. */
+    if (level > 0) {
+      underrun = FALSE;
+    } else if (!underrun && !priv->seek_start &&
+        g_atomic_int_get (&priv->buffers_pushed) > 0) {
+      underrun = TRUE;
+      g_atomic_int_inc (&priv->underruns);
+      g_atomic_int_inc (&priv->unreported_stutter);
+      SPOTIFY_TRACE (underrun, GST_OBJECT_NAME (spotifysrc),
+          (guint) g_atomic_int_get (&priv->underruns),
+          (guint) g_atomic_int_get (&priv->buffers_pushed));
+    }
+    gst_spotify_ring_wait (priv->ring, wanted, stall_end ? stall_end : -1,
+        kicks);
   }
 
-  g_mutex_unlock(&priv->mutex);
+  /* Queued audio is all in the last delivered format */
+  if (G_UNLIKELY (g_atomic_int_get (&priv->format_changed))) {
+    g_atomic_int_set (&priv->format_changed, FALSE);
+    GST_DEBUG_OBJECT (spotifysrc, "delivered format changed, renegotiating");
+    if (!gst_base_src_negotiate (bsrc))
+      goto not_negotiated;
+  }
+  /* The producer can switch formats as soon as the ring is read empty */
+  bpf = g_atomic_int_get (&priv->channels) * sizeof(gint16);
+  rate = g_atomic_int_get (&priv->rate);
+
+  GST_OBJECT_LOCK (spotifysrc);
+  gain = priv->gain;
+  GST_OBJECT_UNLOCK (spotifysrc);
+  if (G_UNLIKELY (gain != priv->convert.gain))
+    gst_spotify_convert_set_gain (&priv->convert, gain);
+
+  buf_size = priv->block_size ? priv->block_size : DEFAULT_BUFFER_SIZE;
+  buf_size = MIN (buf_size, level);
+  buf_size -= buf_size % bpf;
+
+  *buf = gst_spotify_src_alloc_buffer (spotifysrc,
+      gst_spotify_convert_get_out_size (&priv->convert, buf_size));
+  if (G_UNLIKELY (*buf == NULL))
+    goto alloc_failed;
+
+  /* Converted straight out of the ring */
+  gst_buffer_map (*buf, &info, GST_MAP_WRITE);
+  run.convert = &priv->convert;
+  run.dest = info.data;
+  run.bpf = bpf;
+  run.n_partial = 0;
+  gst_spotify_ring_read_func (priv->ring, buf_size,
+      gst_spotify_src_convert_run, &run);
+  gst_buffer_unmap (*buf, &info);
+  SPOTIFY_TRACE (dequeue, GST_OBJECT_NAME (spotifysrc), buf_size,
+      gst_spotify_ring_get_level (priv->ring));
+
+  duration = gst_util_uint64_scale (buf_size / bpf, GST_SECOND, rate);
+  if (gst_base_src_is_live (bsrc) && priv->live_resync)
+    gst_spotify_src_resync_live (spotifysrc, duration);
+  GST_OBJECT_LOCK (spotifysrc);
+  GST_BUFFER_TIMESTAMP (*buf) = priv->buffer_timestamp;
+  priv->buffer_timestamp += duration;
+  GST_OBJECT_UNLOCK (spotifysrc);
+  GST_BUFFER_DURATION (*buf) = duration;
+  priv->track_position += duration;
+
+  if (G_UNLIKELY (priv->seek_start)) {
+    priv->seek_latency = (g_get_monotonic_time () - priv->seek_start) *
+        GST_USECOND;
+    priv->seek_start = 0;
+    SPOTIFY_TRACE (seek, GST_OBJECT_NAME (spotifysrc),
+        (guint64) GST_BUFFER_TIMESTAMP (*buf), (guint64) priv->seek_latency);
+    GST_DEBUG_OBJECT (spotifysrc, "seek latency %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (priv->seek_latency));
+  }
+
+  GST_OBJECT_LOCK (spotifysrc);
+  tags = priv->tags;
+  priv->tags = NULL;
+  GST_OBJECT_UNLOCK (spotifysrc);
+  if (G_UNLIKELY (tags)) {
+    GST_DEBUG_OBJECT (spotifysrc, "pushing tags %" GST_PTR_FORMAT, tags);
+    gst_pad_push_event (GST_BASE_SRC_PAD (bsrc), gst_event_new_tag (tags));
+  }
+
+  GST_LOG_OBJECT (spotifysrc, "we have buffer %p of size %u", *buf, buf_size);
+  g_atomic_int_inc (&priv->buffers_pushed);
+
   if (caps)
     gst_caps_unref (caps);
-  return ret;
+  return GST_FLOW_OK;
 
   /* ERRORS */
 flushing:
   {
     GST_DEBUG_OBJECT (spotifysrc, "we are flushing");
-    g_mutex_unlock(&priv->mutex);
     if (caps)
       gst_caps_unref (caps);
     return GST_FLOW_FLUSHING;
@@ -619,81 +2675,1219 @@ flushing:
 eos:
   {
     GST_DEBUG_OBJECT (spotifysrc, "we are EOS");
-    g_mutex_unlock(&priv->mutex);
     if (caps)
       gst_caps_unref (caps);
     return GST_FLOW_EOS;
   }
+alloc_failed:
+  {
+    GST_ERROR_OBJECT (spotifysrc, "failed to allocate %u bytes", buf_size);
+    if (caps)
+      gst_caps_unref (caps);
+    return GST_FLOW_ERROR;
+  }
+not_negotiated:
+  {
+    GST_ERROR_OBJECT (spotifysrc, "could not negotiate delivered format");
+    if (caps)
+      gst_caps_unref (caps);
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+session_failed:
+  {
+    if (g_atomic_int_get (&priv->recover) == GST_SPOTIFY_SRC_RECOVER_FATAL)
+      GST_ELEMENT_ERROR (spotifysrc, RESOURCE, BUSY,
+          ("Playback was stopped because this account is playing elsewhere"),
+          (NULL));
+    else
+      GST_ELEMENT_ERROR (spotifysrc, RESOURCE, READ,
+          ("Could not resume streaming from Spotify"),
+          ("gave up after %u attempts", priv->max_reconnects));
+    if (caps)
+      gst_caps_unref (caps);
+    return GST_FLOW_ERROR;
+  }
 }
 
-static guint gst_spotify_src_alloc_and_queue(GstSpotifySrc * spotifysrc,
-                                             guint num_frames,
-                                             const void * data_frames,
-                                             guint data_size)
+/* Only single tracks are cached, keyed by their link.  NULL for other
+ * links. */
+static gchar *
+gst_spotify_src_get_pcm_cache_key (const gchar * link)
 {
-  GstSpotifySrcPrivate *priv;
+  if (link == NULL || !g_str_has_prefix (link, "spotify:track:"))
+    return NULL;
 
-  priv = spotifysrc->priv;
+  return g_strdelimit (g_strdup (link), ":", '_');
+}
 
-  g_mutex_lock(&priv->mutex);
+static GstSpotifyPcmCache *
+gst_spotify_src_open_pcm_cache (GstSpotifySrc * spotifysrc,
+    const gchar * link)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstSpotifyPcmCache *cache;
+  gchar *key;
 
-  /* can't accept buffers when we are flushing or EOS */
-  if (priv->flushing)
-    goto flushing;
+  key = gst_spotify_src_get_pcm_cache_key (link);
+  if (key == NULL) {
+    GST_WARNING_OBJECT (spotifysrc, "only track URIs use the PCM cache");
+    return NULL;
+  }
 
-  if (priv->is_eos)
-    goto eos;
+  cache = gst_spotify_pcm_cache_open (priv->pcm_cache_location, key);
+  g_free (key);
 
-  if (priv->max_bytes && priv->queued_bytes >= priv->max_bytes) {
-    GST_DEBUG_OBJECT (spotifysrc,
-        "queue filled (%" G_GUINT64_FORMAT " >= %" G_GUINT64_FORMAT ")",
-        priv->queued_bytes, priv->max_bytes);
-    g_mutex_unlock(&priv->mutex);
-    return 0;
+  if (cache == NULL)
+    GST_WARNING_OBJECT (spotifysrc, "could not open the PCM cache in %s",
+        priv->pcm_cache_location);
+
+  return cache;
+}
+
+/* Read @size bytes of output at @offset from the PCM cache, waiting for
+ * them to be spooled if needed */
+static GstFlowReturn
+gst_spotify_src_create_cached (GstSpotifySrc * spotifysrc, guint64 offset,
+    guint size, GstBuffer ** buf)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstSpotifyPcmCache *cache = priv->pcm_cache;
+  GstSpotifySrcConvertRun run;
+  GstMapInfo info;
+  guint64 in_offset, available;
+  guint in_bpf, out_bpf, in_len, out_size, kicks;
+  gint rate, channels;
+  gdouble gain;
+
+  /* The format is known once the first delivery was spooled.  The kicks
+   * are read before the flags, so a kick after checking them is not lost */
+  for (;;) {
+    kicks = gst_spotify_pcm_cache_get_kicks (cache);
+    if (gst_spotify_pcm_cache_get_format (cache, &rate, &channels))
+      break;
+    if (g_atomic_int_get (&priv->flushing))
+      return GST_FLOW_FLUSHING;
+    if (g_atomic_int_get (&priv->is_eos))
+      return GST_FLOW_EOS;
+    gst_spotify_pcm_cache_wait (cache, 1, -1, kicks);
   }
 
-  /* Allocate buffer and copy spotify data into buffer */
-  GstBuffer *buffer = gst_buffer_new_allocate (NULL, data_size, NULL);
-  if (!buffer)
-  {
-      GST_DEBUG_OBJECT (spotifysrc, "gst_buffer allocation failed");
-      g_mutex_unlock(&priv->mutex);
-      return 0;
+  if (G_UNLIKELY (g_atomic_int_get (&priv->format_changed))) {
+    g_atomic_int_set (&priv->format_changed, FALSE);
+    GST_DEBUG_OBJECT (spotifysrc, "spooled format changed, renegotiating");
+    if (!gst_base_src_negotiate (GST_BASE_SRC (spotifysrc))) {
+      GST_ERROR_OBJECT (spotifysrc, "could not negotiate spooled format");
+      return GST_FLOW_NOT_NEGOTIATED;
+    }
   }
 
-  GstMapInfo info;
-  gst_buffer_map(buffer, &info, GST_MAP_WRITE);
-  memcpy (info.data, (guint8 *)data_frames, info.size);
-  gst_buffer_unmap(buffer, &info);
-
-  GstClockTime duration = gst_util_uint64_scale(num_frames, GST_SECOND, 44100);
-  GST_BUFFER_DURATION(buffer) = duration;
-  GST_BUFFER_TIMESTAMP(buffer) = priv->buffer_timestamp;
-
-  GST_DEBUG_OBJECT (spotifysrc, "queueing buffer %p", buffer);
-  gst_buffer_ref (buffer);
-  g_queue_push_tail (priv->queue, buffer);
-  priv->queued_bytes += gst_buffer_get_size (buffer);
-  GST_DEBUG_OBJECT (spotifysrc,
-                    "queued bytes = %" G_GUINT64_FORMAT " ts = %" G_GUINT64_FORMAT,
-                    priv->queued_bytes, priv->buffer_timestamp);
-  priv->buffer_timestamp += duration;
-  g_cond_broadcast(&priv->cond);
-  g_mutex_unlock(&priv->mutex);
+  GST_OBJECT_LOCK (spotifysrc);
+  gain = priv->gain;
+  GST_OBJECT_UNLOCK (spotifysrc);
+  if (G_UNLIKELY (gain != priv->convert.gain))
+    gst_spotify_convert_set_gain (&priv->convert, gain);
+
+  /* Offsets are in whole output frames */
+  in_bpf = channels * sizeof(gint16);
+  out_bpf = gst_spotify_convert_get_out_size (&priv->convert, in_bpf);
+  in_offset = offset / out_bpf * in_bpf;
+  in_len = MAX (size / out_bpf, 1) * in_bpf;
+
+  kicks = gst_spotify_pcm_cache_get_kicks (cache);
+  available = gst_spotify_pcm_cache_get_length (cache);
+  while (available < in_offset + in_len) {
+    if (gst_spotify_pcm_cache_is_complete (cache) ||
+        g_atomic_int_get (&priv->is_eos)) {
+      available = gst_spotify_pcm_cache_get_length (cache);
+      break;
+    }
+    if (g_atomic_int_get (&priv->flushing))
+      return GST_FLOW_FLUSHING;
+    GST_LOG_OBJECT (spotifysrc, "waiting for %" G_GUINT64_FORMAT " bytes to "
+        "be spooled", in_offset + in_len);
+    available =
+        gst_spotify_pcm_cache_wait (cache, in_offset + in_len, -1, kicks);
+    kicks = gst_spotify_pcm_cache_get_kicks (cache);
+  }
 
-  return num_frames;
+  if (in_offset >= available)
+    return GST_FLOW_EOS;
+  in_len = MIN (in_len, available - in_offset);
+
+  out_size = gst_spotify_convert_get_out_size (&priv->convert, in_len);
+  *buf = gst_spotify_src_alloc_buffer (spotifysrc, out_size);
+  if (G_UNLIKELY (*buf == NULL)) {
+    GST_ERROR_OBJECT (spotifysrc, "failed to allocate %u bytes", out_size);
+    return GST_FLOW_ERROR;
+  }
+
+  gst_buffer_map (*buf, &info, GST_MAP_WRITE);
+  run.convert = &priv->convert;
+  run.dest = info.data;
+  run.bpf = in_bpf;
+  run.n_partial = 0;
+  gst_spotify_pcm_cache_read_func (cache, in_offset, in_len,
+      gst_spotify_src_convert_run, &run);
+  gst_buffer_unmap (*buf, &info);
+
+  GST_BUFFER_OFFSET (*buf) = in_offset / in_bpf * out_bpf;
+  GST_BUFFER_OFFSET_END (*buf) = GST_BUFFER_OFFSET (*buf) + out_size;
+  GST_BUFFER_TIMESTAMP (*buf) =
+      gst_spotify_src_bytes_to_time (spotifysrc, in_offset);
+  GST_BUFFER_DURATION (*buf) =
+      gst_spotify_src_bytes_to_time (spotifysrc, in_len);
+
+  GST_LOG_OBJECT (spotifysrc, "read %u bytes at %" G_GUINT64_FORMAT
+      " from the PCM cache", in_len, in_offset);
+  g_atomic_int_inc (&priv->buffers_pushed);
+
+  return GST_FLOW_OK;
+}
+
+/* Exact once spooled completely, until then an upper bound from the track
+ * duration so reads aren't cut short */
+static gboolean
+gst_spotify_src_get_cached_size (GstSpotifySrc * spotifysrc, guint64 * size)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  guint64 frames;
+  guint out_bpf;
+  gint rate, channels;
+
+  if (!gst_spotify_pcm_cache_get_format (priv->pcm_cache, &rate, &channels)) {
+    rate = g_atomic_int_get (&priv->rate);
+    channels = g_atomic_int_get (&priv->channels);
+  }
+  out_bpf = gst_spotify_convert_get_out_size (&priv->convert,
+      channels * sizeof(gint16));
+
+  if (gst_spotify_pcm_cache_is_complete (priv->pcm_cache)) {
+    frames = gst_spotify_pcm_cache_get_length (priv->pcm_cache) /
+        (channels * sizeof(gint16));
+  } else if (priv->size > 0) {
+    frames = gst_util_uint64_scale_ceil (priv->size + GST_SECOND, rate,
+        GST_SECOND);
+  } else {
+    return FALSE;
+  }
+
+  *size = frames * out_bpf;
+  return TRUE;
+}
+
+static void
+gst_spotify_src_post_warmup (GstSpotifySrc * spotifysrc, const gchar * uri,
+    gboolean loaded, guint pending)
+{
+  GstStructure *s;
+
+  GST_DEBUG_OBJECT (spotifysrc, "metadata of %s %s, %u pending", uri,
+      loaded ? "loaded" : "not found", pending);
+  s = gst_structure_new ("spotify-prefetch",
+      "uri", G_TYPE_STRING, uri,
+      "metadata-loaded", G_TYPE_BOOLEAN, loaded,
+      "pending", G_TYPE_UINT, pending, NULL);
+  gst_element_post_message (GST_ELEMENT (spotifysrc),
+      gst_message_new_element (GST_OBJECT (spotifysrc), s));
+}
+
+static void
+gst_spotify_src_post_offline_sync (GstSpotifySrc * spotifysrc,
+    const gchar * uri, gboolean offline, gboolean applied,
+    sp_playlist_offline_status status, gint progress)
+{
+  static const gchar *status_names[] = {
+    "no", "yes", "downloading", "waiting"
+  };
+  const gchar *name = "no";
+  GstStructure *s;
+
+  if ((guint) status < G_N_ELEMENTS (status_names))
+    name = status_names[status];
+
+  GST_DEBUG_OBJECT (spotifysrc, "offline mode of %s %s, %s at %d%%", uri,
+      applied ? "set" : "not set", name, progress);
+  s = gst_structure_new ("spotify-offline-sync",
+      "uri", G_TYPE_STRING, uri,
+      "offline", G_TYPE_BOOLEAN, offline,
+      "applied", G_TYPE_BOOLEAN, applied,
+      "status", G_TYPE_STRING, name,
+      "progress", G_TYPE_INT, progress, NULL);
+  gst_element_post_message (GST_ELEMENT (spotifysrc),
+      gst_message_new_element (GST_OBJECT (spotifysrc), s));
+}
+
+/* Called from libspotify with the context mutex held */
+static void
+gst_spotify_src_post_offline_status (GstSpotifySrc * spotifysrc,
+    GstSpotifySessionContext * context)
+{
+  sp_offline_sync_status status;
+  GstStructure *s;
+
+  /* Left untouched while nothing is syncing */
+  memset (&status, 0, sizeof (status));
+  sp_offline_sync_get_status (context->session, &status);
+
+  s = gst_structure_new ("spotify-offline-status",
+      "syncing", G_TYPE_BOOLEAN, (gboolean) status.syncing,
+      "playlists", G_TYPE_INT, sp_offline_num_playlists (context->session),
+      "tracks-to-sync", G_TYPE_INT,
+      sp_offline_tracks_to_sync (context->session),
+      "queued-tracks", G_TYPE_INT, status.queued_tracks,
+      "queued-bytes", G_TYPE_UINT64, (guint64) status.queued_bytes,
+      "done-tracks", G_TYPE_INT, status.done_tracks,
+      "done-bytes", G_TYPE_UINT64, (guint64) status.done_bytes,
+      "copied-tracks", G_TYPE_INT, status.copied_tracks,
+      "copied-bytes", G_TYPE_UINT64, (guint64) status.copied_bytes,
+      "willnotcopy-tracks", G_TYPE_INT, status.willnotcopy_tracks,
+      "error-tracks", G_TYPE_INT, status.error_tracks,
+      "time-left", G_TYPE_INT, sp_offline_time_left (context->session),
+      NULL);
+  GST_LOG_OBJECT (spotifysrc, "offline status %" GST_PTR_FORMAT, s);
+  gst_element_post_message (GST_ELEMENT (spotifysrc),
+      gst_message_new_element (GST_OBJECT (spotifysrc), s));
+}
+
+/* Keep the blob libspotify logged in with for the next start.  Called
+ * from libspotify with the context mutex held, when notify handlers could
+ * not use the element, so they are told later. */
+static void
+gst_spotify_src_set_credentials_blob (GstSpotifySrc * spotifysrc,
+    const gchar * blob)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+
+  GST_OBJECT_LOCK (spotifysrc);
+  g_free (priv->credentials_blob);
+  priv->credentials_blob = g_strdup (blob);
+  GST_OBJECT_UNLOCK (spotifysrc);
+
+  g_atomic_int_set (&priv->credentials_changed, TRUE);
+}
+
+/* Notify a blob stored from libspotify, called without any lock held */
+static void
+gst_spotify_src_notify_credentials (GstSpotifySrc * spotifysrc)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+
+  if (G_UNLIKELY (g_atomic_int_compare_and_exchange
+          (&priv->credentials_changed, TRUE, FALSE)))
+    g_object_notify (G_OBJECT (spotifysrc), "credentials-blob");
+}
+
+/* Apply the connection settings to a running session, called with the
+ * element mutex held */
+static void
+gst_spotify_src_update_connection (GstSpotifySrc * spotifysrc)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstSpotifySessionContext *context = priv->spotify_context;
+
+  if (context == NULL)
+    return;
+
+  GST_DEBUG_OBJECT (spotifysrc, "connection type %d, sync over mobile %d",
+      priv->connection_type, priv->sync_over_mobile);
+  g_mutex_lock (&context->mutex);
+  spotify_set_connection_locked (context, priv->connection_type,
+      priv->sync_over_mobile);
+  g_mutex_unlock (&context->mutex);
+}
+
+static void
+gst_spotify_src_free_warmup (GstSpotifySrcWarmup * warmup)
+{
+  g_free (warmup->uri);
+  g_slice_free (GstSpotifySrcWarmup, warmup);
+}
+
+/*
+ * Retire the requested tracks whose metadata has arrived.  Their audio is
+ * not prefetched: libspotify has a single prefetch slot, which belongs to
+ * the gapless prefetch of the next queued track.  Called with the context
+ * mutex held, so the messages are posted later by
+ * gst_spotify_src_post_warmups().
+ */
+static void
+gst_spotify_src_process_warmups (GstSpotifySrc * spotifysrc,
+    GstSpotifySessionContext * context)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstSpotifySrcWarmup *warmup;
+  GList *l, *next;
+  GQueue done = G_QUEUE_INIT;
+  guint pending;
+
+  g_mutex_lock (&priv->tracks_lock);
+  for (l = priv->warmups.head; l; l = next) {
+    next = l->next;
+    warmup = l->data;
+    if (!sp_track_is_loaded (warmup->track))
+      continue;
+
+    sp_track_release (warmup->track);
+    warmup->track = NULL;
+    warmup->loaded = TRUE;
+    g_queue_unlink (&priv->warmups, l);
+    g_queue_push_tail_link (&done, l);
+  }
+  pending = g_queue_get_length (&priv->warmups);
+
+  while ((warmup = g_queue_pop_head (&done))) {
+    warmup->pending = pending;
+    g_queue_push_tail (&priv->warmups_done, warmup);
+  }
+  if (!g_queue_is_empty (&priv->warmups_done))
+    g_atomic_int_set (&context->messages_pending, TRUE);
+  g_mutex_unlock (&priv->tracks_lock);
+}
+
+/* Post the messages of retired tracks, without any lock held */
+static void
+gst_spotify_src_post_warmups (GstSpotifySrc * spotifysrc)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstSpotifySrcWarmup *warmup;
+
+  for (;;) {
+    g_mutex_lock (&priv->tracks_lock);
+    warmup = g_queue_pop_head (&priv->warmups_done);
+    g_mutex_unlock (&priv->tracks_lock);
+    if (warmup == NULL)
+      break;
+
+    gst_spotify_src_post_warmup (spotifysrc, warmup->uri, warmup->loaded,
+        warmup->pending);
+    gst_spotify_src_free_warmup (warmup);
+  }
+}
+
+static void
+gst_spotify_src_clear_warmups (GstSpotifySrc * spotifysrc,
+    GstSpotifySessionContext * context)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstSpotifySrcWarmup *warmup;
+
+  g_mutex_lock (&context->mutex);
+  g_mutex_lock (&priv->tracks_lock);
+  while ((warmup = g_queue_pop_head (&priv->warmups))) {
+    sp_track_release (warmup->track);
+    gst_spotify_src_free_warmup (warmup);
+  }
+  while ((warmup = g_queue_pop_head (&priv->warmups_done)))
+    gst_spotify_src_free_warmup (warmup);
+  g_mutex_unlock (&priv->tracks_lock);
+  g_mutex_unlock (&context->mutex);
+}
+
+static gboolean
+gst_spotify_src_prefetch_uris (GstSpotifySrc * spotifysrc, gchar ** uris)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstSpotifySessionContext *context;
+  GstSpotifySrcWarmup *warmup;
+  sp_track *track;
+  gchar *location;
+  guint i;
+
+  g_mutex_lock (&priv->mutex);
+  context = priv->spotify_context;
+  if (context == NULL || !priv->started) {
+    g_mutex_unlock (&priv->mutex);
+    GST_WARNING_OBJECT (spotifysrc, "can't prefetch before starting");
+    return FALSE;
+  }
+
+  g_mutex_lock (&context->mutex);
+  for (i = 0; uris && uris[i]; i++) {
+    location = gst_uri_get_location (uris[i]);
+    track = location ? spotify_track_from_link_locked (location) : NULL;
+    g_free (location);
+
+    warmup = g_slice_new0 (GstSpotifySrcWarmup);
+    warmup->uri = g_strdup (uris[i]);
+    warmup->track = track;
+    g_mutex_lock (&priv->tracks_lock);
+    if (track) {
+      g_queue_push_tail (&priv->warmups, warmup);
+    } else {
+      /* Reported as not loaded */
+      warmup->pending = g_queue_get_length (&priv->warmups);
+      g_queue_push_tail (&priv->warmups_done, warmup);
+    }
+    g_mutex_unlock (&priv->tracks_lock);
+  }
+
+  /* Cached metadata is available right away, the rest is picked up from
+   * metadata_updated */
+  gst_spotify_src_process_warmups (spotifysrc, context);
+  g_mutex_unlock (&context->mutex);
+  g_mutex_unlock (&priv->mutex);
+
+  gst_spotify_src_post_warmups (spotifysrc);
+
+  return TRUE;
+}
+
+static gboolean
+gst_spotify_src_offline_sync_uris (GstSpotifySrc * spotifysrc, gchar ** uris,
+    gboolean offline)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstSpotifySessionContext *context;
+  sp_playlist_offline_status status;
+  gchar *location;
+  gboolean applied;
+  gint progress;
+  guint i, timeout, linger;
+
+  /* A reference of our own keeps the session while the playlists load,
+   * without holding up seeks and state changes */
+  g_mutex_lock (&priv->mutex);
+  if (priv->spotify_context == NULL || !priv->started) {
+    g_mutex_unlock (&priv->mutex);
+    GST_WARNING_OBJECT (spotifysrc, "can't sync offline before starting");
+    return FALSE;
+  }
+  context = spotify_session_ref (priv->spotify_context);
+  timeout = priv->load_timeout;
+  linger = priv->session_linger;
+  g_mutex_unlock (&priv->mutex);
+
+  for (i = 0; uris && uris[i]; i++) {
+    status = SP_PLAYLIST_OFFLINE_STATUS_NO;
+    progress = 0;
+    location = gst_uri_get_location (uris[i]);
+    applied = location && spotify_set_offline (context, location, offline,
+        timeout, &status, &progress);
+    g_free (location);
+
+    gst_spotify_src_post_offline_sync (spotifysrc, uris[i], offline, applied,
+        status, progress);
+  }
+
+  spotify_session_release (context, linger);
+
+  return TRUE;
+}
+
+/* Called from the streaming thread whenever a track boundary is queued.
+ * Starts a new segment once all audio of the previous track was pushed and
+ * returns the number of bytes left until the next boundary. */
+static guint
+gst_spotify_src_check_boundary (GstSpotifySrc * spotifysrc)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstBaseSrc *bsrc = GST_BASE_SRC (spotifysrc);
+  GstSpotifySrcBoundary *boundary;
+  GstEvent *event = NULL;
+  GstSegment segment;
+  guint remaining = G_MAXUINT;
+
+  g_mutex_lock (&priv->tracks_lock);
+  while ((boundary = g_queue_peek_head (&priv->boundaries))) {
+    remaining = boundary->offset -
+        gst_spotify_ring_get_read_offset (priv->ring);
+    if ((gint) remaining > 0)
+      break;
+
+    GST_DEBUG_OBJECT (spotifysrc, "starting next track, duration %"
+        GST_TIME_FORMAT, GST_TIME_ARGS (boundary->duration));
+    g_queue_pop_head (&priv->boundaries);
+    g_atomic_int_add (&priv->n_boundaries, -1);
+    priv->size = boundary->duration;
+    if (boundary->tags) {
+      GST_OBJECT_LOCK (spotifysrc);
+      if (priv->tags)
+        gst_tag_list_unref (priv->tags);
+      priv->tags = boundary->tags;
+      GST_OBJECT_UNLOCK (spotifysrc);
+    }
+    g_slice_free (GstSpotifySrcBoundary, boundary);
+    remaining = G_MAXUINT;
+    priv->track_position = 0;
+
+    /* live timestamps keep following the clock.  The segment restarts at
+     * 0 and continues the running time, everything of the previous track
+     * has been pushed already. */
+    if (!gst_base_src_is_live (bsrc)) {
+      GST_OBJECT_LOCK (spotifysrc);
+      priv->buffer_timestamp = 0;
+      bsrc->segment.base = gst_segment_to_running_time (&bsrc->segment,
+          bsrc->segment.format, bsrc->segment.position);
+      bsrc->segment.position = bsrc->segment.start = 0;
+      bsrc->segment.stop = -1;
+      bsrc->segment.time = 0;
+      segment = bsrc->segment;
+      GST_OBJECT_UNLOCK (spotifysrc);
+      if (event)
+        gst_event_unref (event);
+      event = gst_event_new_segment (&segment);
+    }
+  }
+  g_mutex_unlock (&priv->tracks_lock);
+
+  if (event) {
+    gst_event_set_seqnum (event, gst_util_seqnum_next ());
+    gst_pad_push_event (GST_BASE_SRC_PAD (bsrc), event);
+  }
+
+  return remaining;
+}
+
+/* Prefetch the track after the current one, converting next-uri into a
+ * queued track if needed.  Called with the context mutex held. */
+static void
+gst_spotify_src_prefetch (GstSpotifySrc * spotifysrc,
+    GstSpotifySessionContext * context)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  sp_track *track;
+  guint next;
+
+  g_mutex_lock (&priv->tracks_lock);
+  next = priv->track_index + 1;
+  if (next >= priv->tracks->len && priv->next_uri) {
+    gchar *location = gst_uri_get_location (priv->next_uri);
+
+    track = spotify_track_from_link_locked (location);
+    if (track)
+      g_ptr_array_add (priv->tracks, track);
+    else
+      GST_WARNING_OBJECT (spotifysrc, "Invalid next track URI %s",
+          priv->next_uri);
+    g_free (location);
+    g_free (priv->next_uri);
+    priv->next_uri = NULL;
+  }
+
+  if (next < priv->tracks->len && priv->prefetched < (gint) next) {
+    track = g_ptr_array_index (priv->tracks, next);
+    if (sp_track_is_loaded (track)) {
+      GST_DEBUG_OBJECT (spotifysrc, "prefetching track %u", next);
+      sp_session_player_prefetch (context->session, track);
+      priv->prefetched = next;
+    }
+  }
+  g_mutex_unlock (&priv->tracks_lock);
+}
+
+/* A new track started playing, called with @locked telling whether the
+ * context mutex is already held (from libspotify callbacks) */
+static void
+gst_spotify_src_track_started (GstSpotifySrc * spotifysrc,
+    GstSpotifySessionContext * context, gboolean locked)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  gboolean last;
+
+  g_mutex_lock (&priv->tracks_lock);
+  last = priv->track_index + 1 >= priv->tracks->len && priv->next_uri == NULL;
+  g_mutex_unlock (&priv->tracks_lock);
+
+  if (last)
+    g_signal_emit (spotifysrc,
+        gst_spotify_src_signals[SIGNAL_ABOUT_TO_FINISH], 0);
+
+  if (!locked)
+    g_mutex_lock (&context->mutex);
+  gst_spotify_src_prefetch (spotifysrc, context);
+  if (!locked)
+    g_mutex_unlock (&context->mutex);
+}
+
+/*
+ * Switch libspotify to the next queued track when the current one ends.
+ * Called from the session thread with the context mutex held.  Returns
+ * FALSE when there is nothing left to play.
+ */
+static gboolean
+gst_spotify_src_next_track (GstSpotifySrc * spotifysrc,
+    GstSpotifySessionContext * context)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstSpotifySrcBoundary *boundary;
+  GstSpotifyTrackInfo *info;
+  gboolean started = FALSE, pending = FALSE;
+  gint64 duration;
+  sp_track *track;
+
+  /* picks up next-uri as well */
+  gst_spotify_src_prefetch (spotifysrc, context);
+
+  g_mutex_lock (&priv->tracks_lock);
+  priv->switch_pending = FALSE;
+  while (priv->track_index + 1 < priv->tracks->len) {
+    track = g_ptr_array_index (priv->tracks, priv->track_index + 1);
+    if (!sp_track_is_loaded (track)) {
+      /* no point waiting for a track known to be unplayable */
+      info = spotify_track_info_get_locked (context, track);
+      if (info && !info->available) {
+        spotify_track_info_free (info);
+        priv->track_index++;
+        GST_WARNING_OBJECT (spotifysrc, "skipping unavailable track %u",
+            priv->track_index);
+        continue;
+      }
+      spotify_track_info_free (info);
+
+      /* retried from metadata_updated */
+      GST_DEBUG_OBJECT (spotifysrc, "waiting for next track to load");
+      priv->switch_pending = pending = TRUE;
+      break;
+    }
+
+    priv->track_index++;
+    if (spotify_load_track_locked (context, track, &duration)) {
+      /* No audio of the new track has been delivered yet */
+      boundary = g_slice_new (GstSpotifySrcBoundary);
+      boundary->offset = gst_spotify_ring_get_write_offset (priv->ring);
+      boundary->duration = duration;
+      boundary->tags = spotify_track_tags_locked (context, track);
+      g_queue_push_tail (&priv->boundaries, boundary);
+      g_atomic_int_inc (&priv->n_boundaries);
+      started = TRUE;
+      break;
+    }
+    GST_WARNING_OBJECT (spotifysrc, "skipping unplayable track %u",
+        priv->track_index);
+  }
+  g_mutex_unlock (&priv->tracks_lock);
+
+  if (started) {
+    GST_DEBUG_OBJECT (spotifysrc, "switched to track %u", priv->track_index);
+    gst_spotify_src_track_started (spotifysrc, context, TRUE);
+  }
+
+  return started || pending;
+}
+
+/* Wait until libspotify has flushed for the last seek, or seek-timeout
+ * passes, and drop everything delivered before that.  Returns FALSE when
+ * woken early, e.g. for flushing, by a kick since @kicks was read. */
+static gboolean
+gst_spotify_src_wait_seek (GstSpotifySrc * spotifysrc, guint kicks)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  gint seqnum = g_atomic_int_get (&priv->seek_seqnum);
+  gint64 end_time;
+
+  if (g_atomic_int_get (&priv->delivery_seqnum) != seqnum) {
+    end_time = priv->seek_start + priv->seek_timeout * G_TIME_SPAN_MILLISECOND;
+    if (g_get_monotonic_time () < end_time) {
+      GST_DEBUG_OBJECT (spotifysrc, "Waiting for seek to arrive...");
+      gst_spotify_ring_wait (priv->ring,
+          gst_spotify_ring_get_limit (priv->ring), end_time, kicks);
+      return FALSE;
+    }
+
+    GST_WARNING_OBJECT (spotifysrc, "libspotify did not flush for seek %d, "
+        "accepting its data", seqnum);
+    g_atomic_int_set (&priv->delivery_seqnum, seqnum);
+    gst_spotify_ring_clear (priv->ring);
+  }
+
+  GST_DEBUG_OBJECT (spotifysrc, "Seek has arrived...");
+  gst_spotify_ring_skip_to_mark (priv->ring);
+  priv->seek_pending = FALSE;
+
+  return TRUE;
+}
+
+/* Called from libspotify when streaming stopped or may have, only ever
+ * raises the recovery level create() acts on */
+static void
+gst_spotify_src_session_failed (GstSpotifySrc * spotifysrc, gint recover)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  gint old;
+
+  do {
+    old = g_atomic_int_get (&priv->recover);
+    if (old >= recover)
+      return;
+  } while (!g_atomic_int_compare_and_exchange (&priv->recover, old, recover));
+
+  if (priv->ring)
+    gst_spotify_ring_kick (priv->ring);
+}
+
+/* Log in again if needed, reload the current track and seek to where the
+ * pushed audio left off.  Once the next track's boundary is queued, the
+ * end of the previous track plays out and the reloaded track resumes
+ * after its queued audio instead.  Attempts back off exponentially,
+ * returns FALSE when giving up or woken for flushing. */
+static gboolean
+gst_spotify_src_recover (GstSpotifySrc * spotifysrc)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstSpotifySessionContext *context = priv->spotify_context;
+  GstSpotifySrcBoundary *boundary;
+  GstClockTime position;
+  gint64 end_time, duration;
+  sp_track *track;
+  gchar *user, *pass, *blob = NULL;
+  guint attempt, delay, queued, kicks;
+  gboolean res, keep, account;
+
+  for (attempt = 0; attempt < priv->max_reconnects; attempt++) {
+    delay = SPOTIFY_RECONNECT_DELAY_MIN << MIN (attempt, 16);
+    delay = MIN (delay, SPOTIFY_RECONNECT_DELAY_MAX);
+    GST_INFO_OBJECT (spotifysrc, "reconnecting in %u ms, attempt %u of %u",
+        delay, attempt + 1, priv->max_reconnects);
+
+    end_time = g_get_monotonic_time () + delay * G_TIME_SPAN_MILLISECOND;
+    while (g_get_monotonic_time () < end_time) {
+      kicks = gst_spotify_ring_get_kicks (priv->ring);
+      if (g_atomic_int_get (&priv->flushing))
+        return FALSE;
+      gst_spotify_ring_wait (priv->ring, gst_spotify_ring_get_limit
+          (priv->ring), end_time, kicks);
+    }
+
+    /* Failures from here on call for another attempt */
+    if (g_atomic_int_get (&priv->recover) == GST_SPOTIFY_SRC_RECOVER_FATAL)
+      return FALSE;
+    g_atomic_int_set (&priv->recover, GST_SPOTIFY_SRC_RECOVER_NONE);
+
+    /* With the credentials the session was leased for, which are those of
+     * an entry of accounts rather than user and password if it was set */
+    g_mutex_lock (&context->mutex);
+    user = g_strdup (context->user);
+    pass = g_strdup (context->password);
+    account = context->account;
+    g_mutex_unlock (&context->mutex);
+    if (!account) {
+      GST_OBJECT_LOCK (spotifysrc);
+      blob = g_strdup (priv->credentials_blob);
+      GST_OBJECT_UNLOCK (spotifysrc);
+    }
+    res = spotify_login (context, user, pass, blob, priv->remember_me,
+        priv->login_timeout);
+    g_free (user);
+    g_free (pass);
+    g_free (blob);
+    blob = NULL;
+    if (g_atomic_int_get (&priv->cancel))
+      return FALSE;
+    if (!res)
+      continue;
+
+    g_mutex_lock (&priv->tracks_lock);
+    track = priv->track_index < priv->tracks->len ?
+        g_ptr_array_index (priv->tracks, priv->track_index) : NULL;
+    keep = g_atomic_int_get (&priv->n_boundaries) > 0;
+    position = priv->track_position;
+    g_mutex_unlock (&priv->tracks_lock);
+    if (track == NULL)
+      continue;
+
+    if (keep) {
+      /* Deliveries are dropped from now until libspotify flushed for the
+       * seek, so the queued end of the ring stays where it is */
+      g_atomic_int_inc (&priv->seek_seqnum);
+      g_mutex_lock (&priv->tracks_lock);
+      boundary = g_queue_peek_tail (&priv->boundaries);
+      queued = boundary ? gst_spotify_ring_get_write_offset (priv->ring) -
+          boundary->offset : 0;
+      g_mutex_unlock (&priv->tracks_lock);
+      position = gst_spotify_src_bytes_to_time (spotifysrc, queued);
+      position -= position % GST_MSECOND;
+      /* Nothing of the new track yet, it plays from the top unflushed */
+      if (position == 0)
+        g_atomic_int_set (&priv->delivery_seqnum,
+            g_atomic_int_get (&priv->seek_seqnum));
+    }
+
+    if (!spotify_play (context, track, priv->load_timeout, &duration)) {
+      g_atomic_int_set (&priv->delivery_seqnum,
+          g_atomic_int_get (&priv->seek_seqnum));
+      if (g_atomic_int_get (&priv->cancel))
+        return FALSE;
+      continue;
+    }
+
+    g_mutex_lock (&priv->mutex);
+    if (!keep) {
+      /* Whatever was left queued is delivered again */
+      if (position > 0) {
+        g_atomic_int_inc (&priv->seek_seqnum);
+        priv->seek_pending = TRUE;
+        priv->seek_start = g_get_monotonic_time ();
+      }
+      gst_spotify_src_flush_queued (spotifysrc);
+    }
+    g_atomic_int_set (&priv->is_full, FALSE);
+    g_atomic_int_set (&priv->buffering, TRUE);
+    g_atomic_int_set (&priv->buffering_percent, -1);
+    g_mutex_unlock (&priv->mutex);
+
+    if (position > 0 && !spotify_seek (context, position / GST_MSECOND))
+      continue;
+
+    GST_INFO_OBJECT (spotifysrc, "resumed at %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (position));
+    g_atomic_int_inc (&priv->reconnects);
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* Restart live timestamps from the running time of the pipeline clock.
+ * The first buffer is stamped as if it had just been captured, the rest
+ * follow contiguously so sinks see no jitter from delivery bursts. */
+static void
+gst_spotify_src_resync_live (GstSpotifySrc * spotifysrc,
+    GstClockTime duration)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstClockTime now, base_time;
+  GstClock *clock;
+
+  clock = gst_element_get_clock (GST_ELEMENT (spotifysrc));
+  if (clock == NULL)
+    return;
+
+  now = gst_clock_get_time (clock);
+  base_time = gst_element_get_base_time (GST_ELEMENT (spotifysrc));
+  gst_object_unref (clock);
+
+  GST_OBJECT_LOCK (spotifysrc);
+  if (now >= base_time + duration)
+    priv->buffer_timestamp = now - base_time - duration;
+  else
+    priv->buffer_timestamp = 0;
+  GST_OBJECT_UNLOCK (spotifysrc);
+  priv->live_resync = FALSE;
+
+  GST_DEBUG_OBJECT (spotifysrc, "live timestamps start at %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (priv->buffer_timestamp));
+}
+
+/* Track the queue fill level against the watermarks and post buffering
+ * messages.  Called from the streaming thread only.  A live source is
+ * never paused for buffering, so it posts none. */
+static void
+gst_spotify_src_update_buffering (GstSpotifySrc * spotifysrc, guint level)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  gint percent;
+
+  if (gst_base_src_is_live (GST_BASE_SRC (spotifysrc)))
+    return;
+
+  if (level >= priv->high_level || g_atomic_int_get (&priv->is_full) ||
+      g_atomic_int_get (&priv->is_eos))
+    percent = 100;
+  else
+    percent = (guint64) level * 100 / priv->high_level;
+
+  if (g_atomic_int_get (&priv->buffering)) {
+    if (percent == g_atomic_int_get (&priv->buffering_percent))
+      return;
+    if (percent == 100)
+      g_atomic_int_set (&priv->buffering, FALSE);
+  } else if (level < priv->low_level && percent < 100) {
+    GST_DEBUG_OBJECT (spotifysrc, "queue fell below low watermark (%u bytes)",
+        level);
+    g_atomic_int_set (&priv->buffering, TRUE);
+  } else {
+    return;
+  }
+
+  GST_DEBUG_OBJECT (spotifysrc, "buffering %d%%", percent);
+  g_atomic_int_set (&priv->buffering_percent, percent);
+  gst_element_post_message (GST_ELEMENT (spotifysrc),
+      gst_message_new_buffering (GST_OBJECT (spotifysrc), percent));
+}
+
+/* Snapshot for the stats property.  Counters are read one by one, so they
+ * may be a delivery or buffer apart from each other. */
+static GstStructure *
+gst_spotify_src_get_stats (GstSpotifySrc * spotifysrc)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  guint64 iterations = 0, wakeups = 0;
+  GstClockTime login_latency, load_latency, elapsed = 0;
+  guint level = 0;
+
+  g_mutex_lock (&priv->mutex);
+  if (priv->started)
+    elapsed = (g_get_monotonic_time () - priv->start_time) * GST_USECOND;
+  if (priv->spotify_context)
+    spotify_session_get_loop_stats (priv->spotify_context, &iterations,
+        &wakeups);
+  if (priv->ring)
+    level = gst_spotify_ring_get_level (priv->ring);
+  login_latency = priv->login_latency;
+  load_latency = priv->load_latency;
+  g_mutex_unlock (&priv->mutex);
+
+  return gst_structure_new ("application/x-spotify-stats",
+      "queued-bytes", G_TYPE_UINT, level,
+      "stutter", G_TYPE_UINT64, priv->stutter,
+      "underruns", G_TYPE_UINT,
+      (guint) g_atomic_int_get (&priv->underruns),
+      "buffers-pushed", G_TYPE_UINT,
+      (guint) g_atomic_int_get (&priv->buffers_pushed),
+      "deliveries", G_TYPE_UINT,
+      (guint) g_atomic_int_get (&priv->deliveries),
+      "deliveries-dropped", G_TYPE_UINT,
+      (guint) g_atomic_int_get (&priv->deliveries_dropped),
+      "deliveries-rejected", G_TYPE_UINT,
+      (guint) g_atomic_int_get (&priv->deliveries_rejected),
+      "reconnects", G_TYPE_UINT,
+      (guint) g_atomic_int_get (&priv->reconnects),
+      "tracks-delivered", G_TYPE_UINT,
+      (guint) g_atomic_int_get (&priv->tracks_delivered),
+      "elapsed", G_TYPE_UINT64, elapsed,
+      "login-latency", G_TYPE_UINT64, login_latency,
+      "track-load-latency", G_TYPE_UINT64, load_latency,
+      "seek-latency", G_TYPE_UINT64, priv->seek_latency,
+      "loop-iterations", G_TYPE_UINT64, iterations,
+      "loop-wakeups", G_TYPE_UINT64, wakeups, NULL);
+}
+
+/* Duration of @bytes of delivered audio */
+static GstClockTime
+gst_spotify_src_bytes_to_time (GstSpotifySrc * spotifysrc, guint64 bytes)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  guint bpf = g_atomic_int_get (&priv->channels) * sizeof(gint16);
+
+  return gst_util_uint64_scale (bytes / bpf, GST_SECOND,
+      g_atomic_int_get (&priv->rate));
+}
+
+/* Ring read callback, converting into the buffer being filled */
+static void
+gst_spotify_src_convert_run (const guint8 * data, guint len,
+    gpointer user_data)
+{
+  GstSpotifySrcConvertRun *run = user_data;
+  guint take, whole;
+
+  /* Positions run on across format changes, so a wrap can fall inside a
+   * frame of the current format */
+  if (G_UNLIKELY (run->n_partial > 0)) {
+    take = MIN (len, run->bpf - run->n_partial);
+    memcpy (run->partial + run->n_partial, data, take);
+    run->n_partial += take;
+    data += take;
+    len -= take;
+    if (run->n_partial < run->bpf)
+      return;
+    run->dest += gst_spotify_convert_process (run->convert, run->dest,
+        run->partial, run->bpf);
+    run->n_partial = 0;
+  }
+
+  whole = len - len % run->bpf;
+  if (whole > 0)
+    run->dest += gst_spotify_convert_process (run->convert, run->dest, data,
+        whole);
+  if (G_UNLIKELY (whole < len)) {
+    memcpy (run->partial, data + whole, len - whole);
+    run->n_partial = len - whole;
+  }
+}
+
+/* Get a buffer of @size bytes, recycled from the pool negotiated in
+ * decide_allocation whenever a pool buffer is large enough */
+static GstBuffer *gst_spotify_src_alloc_buffer(GstSpotifySrc * spotifysrc,
+                                               guint size)
+{
+  GstBufferPool *pool;
+  GstBuffer *buffer = NULL;
+
+  pool = gst_base_src_get_buffer_pool (GST_BASE_SRC (spotifysrc));
+  if (pool) {
+    if (gst_buffer_pool_acquire_buffer (pool, &buffer, NULL) == GST_FLOW_OK) {
+      if (gst_buffer_get_size (buffer) >= size) {
+        gst_buffer_set_size (buffer, size);
+      } else {
+        gst_buffer_unref (buffer);
+        buffer = NULL;
+      }
+    }
+    gst_object_unref (pool);
+  }
+
+  if (buffer == NULL)
+    buffer = gst_buffer_new_allocate (NULL, size, NULL);
+
+  return buffer;
+}
+
+/* Called from the libspotify delivery thread instead of queueing */
+static guint gst_spotify_src_spool_frames(GstSpotifySrc * spotifysrc,
+                                          const sp_audioformat * format,
+                                          guint num_frames,
+                                          const void * data_frames)
+{
+  GstSpotifySrcPrivate *priv = spotifysrc->priv;
+  GstSpotifyPcmCache *cache;
+  gboolean res = FALSE;
+
+  GST_OBJECT_LOCK (spotifysrc);
+  cache = priv->pcm_cache ? gst_spotify_pcm_cache_ref (priv->pcm_cache) :
+      NULL;
+  GST_OBJECT_UNLOCK (spotifysrc);
+  if (cache == NULL)
+    return num_frames;
+  if (num_frames == 0)
+    goto done;
+
+  if (format->sample_rate > 0 && format->channels >= 1 &&
+      format->channels <= 2) {
+    if (G_UNLIKELY (format->sample_rate != g_atomic_int_get (&priv->rate) ||
+            format->channels != g_atomic_int_get (&priv->channels))) {
+      g_atomic_int_set (&priv->rate, format->sample_rate);
+      g_atomic_int_set (&priv->channels, format->channels);
+      g_atomic_int_set (&priv->format_changed, TRUE);
+    }
+    res = gst_spotify_pcm_cache_write (cache, format->sample_rate,
+        format->channels, data_frames,
+        num_frames * format->channels * sizeof(gint16));
+  }
+
+  if (res) {
+    g_atomic_int_inc (&priv->deliveries);
+  } else {
+    /* What was spooled is still served, then the stream ends */
+    g_atomic_int_inc (&priv->deliveries_dropped);
+    if (g_atomic_int_compare_and_exchange (&priv->is_eos, FALSE, TRUE)) {
+      GST_ELEMENT_ERROR (spotifysrc, RESOURCE, WRITE,
+          ("Could not spool the track to the PCM cache"),
+          ("%d Hz, %d channels", format->sample_rate, format->channels));
+      gst_spotify_pcm_cache_kick (cache);
+    }
+  }
+
+done:
+  gst_spotify_pcm_cache_unref (cache);
+  return num_frames;
+}
+
+/* Called from the libspotify delivery thread, the only ring producer */
+static guint gst_spotify_src_queue_frames(GstSpotifySrc * spotifysrc,
+                                          const sp_audioformat * format,
+                                          guint num_frames,
+                                          const void * data_frames)
+{
+  GstSpotifySrcPrivate *priv;
+  guint bpf, frames;
+  gint seqnum;
+
+  priv = spotifysrc->priv;
+
+  /* Everything goes to the cache when spooling for random access */
+  if (G_UNLIKELY (g_atomic_pointer_get (&priv->pcm_cache) != NULL))
+    return gst_spotify_src_spool_frames (spotifysrc, format, num_frames,
+        data_frames);
+
+  /* Drop old data until libspotify flushes for the last seek, which it
+   * signals with an empty delivery */
+  seqnum = g_atomic_int_get (&priv->seek_seqnum);
+  if (G_UNLIKELY (g_atomic_int_get (&priv->delivery_seqnum) != seqnum)) {
+    if (num_frames > 0) {
+      g_atomic_int_inc (&priv->deliveries_dropped);
+      return num_frames;
+    }
+    GST_DEBUG_OBJECT (spotifysrc, "libspotify flushed for seek %d", seqnum);
+    gst_spotify_ring_mark (priv->ring);
+    g_atomic_int_set (&priv->delivery_seqnum, seqnum);
+    gst_spotify_ring_kick (priv->ring);
+    return 0;
+  }
+
+  if (num_frames == 0)
+    return 0;
+
+  /* can't accept buffers when we are flushing or EOS */
+  if (g_atomic_int_get (&priv->flushing))
+    goto flushing;
+
+  if (g_atomic_int_get (&priv->is_eos))
+    goto eos;
+
+  if (G_UNLIKELY (format->sample_rate != g_atomic_int_get (&priv->rate) ||
+          format->channels != g_atomic_int_get (&priv->channels))) {
+    if (format->sample_rate <= 0 || format->channels < 1 ||
+        format->channels > 2)
+      goto unsupported;
+
+    /* Queued audio is timed and converted by the old format, switch once
+     * it has all been read out */
+    if (gst_spotify_ring_get_level (priv->ring) > 0) {
+      g_atomic_int_set (&priv->is_full, TRUE);
+      gst_spotify_ring_kick (priv->ring);
+      return 0;
+    }
+
+    GST_INFO_OBJECT (spotifysrc, "delivered format changed to %d Hz, "
+        "%d channels", format->sample_rate, format->channels);
+    g_atomic_int_set (&priv->rate, format->sample_rate);
+    g_atomic_int_set (&priv->channels, format->channels);
+    g_atomic_int_set (&priv->format_changed, TRUE);
+  }
+
+  /* Take as many whole frames as fit, libspotify delivers the rest again
+   * later.  This fills the queue right up to max-bytes. */
+  bpf = format->channels * sizeof(gint16);
+  frames = MIN (num_frames, gst_spotify_ring_get_space (priv->ring) / bpf);
+  if (frames == 0) {
+    GST_DEBUG_OBJECT (spotifysrc, "queue filled (%u bytes)",
+        gst_spotify_ring_get_level (priv->ring));
+    g_atomic_int_inc (&priv->deliveries_rejected);
+  } else {
+    gst_spotify_ring_write (priv->ring, data_frames, frames * bpf);
+    g_atomic_int_inc (&priv->deliveries);
+    SPOTIFY_TRACE (enqueue, GST_OBJECT_NAME (spotifysrc), frames * bpf,
+        gst_spotify_ring_get_level (priv->ring));
+    /* libspotify got over a connection problem by itself */
+    if (G_UNLIKELY (g_atomic_int_get (&priv->recover) ==
+            GST_SPOTIFY_SRC_RECOVER_STALLED))
+      g_atomic_int_compare_and_exchange (&priv->recover,
+          GST_SPOTIFY_SRC_RECOVER_STALLED, GST_SPOTIFY_SRC_RECOVER_NONE);
+    GST_LOG_OBJECT (spotifysrc, "queued %u of %u frames, %u bytes", frames,
+        num_frames, gst_spotify_ring_get_level (priv->ring));
+  }
+
+  if (frames < num_frames) {
+    /* Wake the streaming thread, the queue may never reach the high
+     * watermark when deliveries are large compared to max-bytes.
+     * libspotify retries the delivery, so a missed kick is repeated. */
+    g_atomic_int_set (&priv->is_full, TRUE);
+    gst_spotify_ring_kick (priv->ring);
+  } else {
+    g_atomic_int_set (&priv->is_full, FALSE);
+  }
+
+  return frames;
 
   /* ERRORS */
 flushing:
   {
     GST_DEBUG_OBJECT (spotifysrc, "refuse music data, we are flushing");
-    g_mutex_unlock(&priv->mutex);
+    g_atomic_int_inc (&priv->deliveries_dropped);
     return num_frames;
   }
 eos:
   {
     GST_DEBUG_OBJECT (spotifysrc, "refuse music data, we are EOS");
-    g_mutex_unlock(&priv->mutex);
+    g_atomic_int_inc (&priv->deliveries_dropped);
+    return num_frames;
+  }
+unsupported:
+  {
+    g_atomic_int_inc (&priv->deliveries_dropped);
+    GST_WARNING_OBJECT (spotifysrc, "dropping audio in unsupported format, "
+        "%d Hz, %d channels", format->sample_rate, format->channels);
     return num_frames;
   }
 }
@@ -701,26 +3895,37 @@ eos:
 static void gst_spotify_src_end_of_stream (GstSpotifySrc * spotifysrc)
 {
   GstSpotifySrcPrivate *priv;
+  GstSpotifyPcmCache *cache;
 
   priv = spotifysrc->priv;
 
-  g_mutex_lock(&priv->mutex);
+  /* The whole track was delivered, even if flushing meanwhile */
+  GST_OBJECT_LOCK (spotifysrc);
+  cache = priv->pcm_cache ? gst_spotify_pcm_cache_ref (priv->pcm_cache) :
+      NULL;
+  GST_OBJECT_UNLOCK (spotifysrc);
+  if (cache) {
+    if (gst_spotify_pcm_cache_finish (cache))
+      GST_DEBUG_OBJECT (spotifysrc, "track spooled to the PCM cache");
+    else
+      GST_WARNING_OBJECT (spotifysrc, "could not store the PCM cache");
+    gst_spotify_pcm_cache_unref (cache);
+  }
+
   /* can't accept buffers when we are flushing. We can accept them when we are
    * EOS although it will not do anything. */
-  if (priv->flushing)
+  if (g_atomic_int_get (&priv->flushing))
     goto flushing;
 
   GST_DEBUG_OBJECT (spotifysrc, "sending EOS");
-  priv->is_eos = TRUE;
-  g_cond_broadcast(&priv->cond);
-  g_mutex_unlock(&priv->mutex);
+  g_atomic_int_set (&priv->is_eos, TRUE);
+  gst_spotify_ring_kick (priv->ring);
 
   return;
 
   /* ERRORS */
 flushing:
   {
-    g_mutex_unlock(&priv->mutex);
     GST_DEBUG_OBJECT (spotifysrc, "refuse EOS, we are flushing");
   }
 }
@@ -759,9 +3964,10 @@ gst_spotify_src_set_uri (GstSpotifySrc *spotifysrc, const gchar *uri)
     goto wrong_location;
   }
 
+  GST_OBJECT_LOCK (spotifysrc);
   g_free (spotifysrc->priv->uri );
-
   spotifysrc->priv->uri = g_strdup(uri);
+  GST_OBJECT_UNLOCK (spotifysrc);
 
   g_object_notify (G_OBJECT (spotifysrc), "uri");
 
@@ -787,111 +3993,761 @@ gst_spotify_src_uri_get_protocols (GType type)
 {
   static const gchar * const protocols[] = { (const char *) "spotify", NULL };
 
-  return protocols;
+  return protocols;
+}
+
+static gchar *
+gst_spotify_src_uri_get_uri (GstURIHandler * handler)
+{
+  GstSpotifySrc *spotifysrc = GST_SPOTIFY_SRC (handler);
+  return spotifysrc->priv->uri;
+}
+
+static gboolean
+gst_spotify_src_uri_set_uri (GstURIHandler * handler, const gchar * uri, GError ** error)
+{
+  gboolean res = TRUE;
+  GstSpotifySrc *spotifysrc = GST_SPOTIFY_SRC (handler);
+
+  GST_DEBUG_OBJECT (spotifysrc, "New URI for interface: '%s' for spotify src", uri);
+  if (!gst_spotify_src_set_uri (spotifysrc, uri)) {
+    *error = g_error_new (
+      g_quark_from_string("gst-resource-error-quark"),
+      GST_RESOURCE_ERROR_FAILED,
+      "Failed to set source URI: '%s'", uri);
+      res = FALSE;
+  }
+  return res;
+}
+
+static void
+gst_spotify_src_uri_handler_init (gpointer g_iface, gpointer iface_data)
+{
+  GstURIHandlerInterface *iface = (GstURIHandlerInterface *) g_iface;
+
+  iface->get_type = gst_spotify_src_uri_get_type;
+  iface->get_protocols = gst_spotify_src_uri_get_protocols;
+  iface->get_uri = gst_spotify_src_uri_get_uri;
+  iface->set_uri = gst_spotify_src_uri_set_uri;
+}
+
+/**** SPOTIFY interface  **************************************************/
+
+/*
+ * Sessions are leased by one element at a time, since libspotify plays a
+ * single track per session, and are keyed by account and app key.  An
+ * unused session is kept logged in for the releasing element's
+ * session-linger time so that the next start skips creation and login; its
+ * main loop thread tears it down once that deadline passes.  Elements with
+ * a list of accounts lease from whichever account isn't streaming yet, as
+ * an account can only play one track at a time.
+ *
+ * libspotify supports a single sp_session per process, so at most one
+ * session is alive at any time: an idle one for another key is destroyed
+ * before a new session is created, and while one is leased every other
+ * element fails to start with a BUSY error.  spotify_sessions_live counts
+ * sessions from before sp_session_create() is called, without the sessions
+ * lock, until sp_session_release() has returned, including ones not in the
+ * list yet or any more.  spotify_sessions_cond is broadcast whenever it
+ * drops or a new session is added to the list.
+ *
+ * libspotify callbacks only carry the sp_session, so they find their
+ * context through sp_session_userdata() and the leasing element through
+ * spotify_session_get_src().
+ */
+#define SPOTIFY_SESSIONS_PER_PROCESS 1
+
+static GMutex spotify_sessions_lock;
+static GCond spotify_sessions_cond;
+static GList *spotify_sessions = NULL;
+static guint spotify_sessions_live = 0;
+
+static void spotify_session_free(GstSpotifySessionContext *context);
+static gboolean spotify_session_expire(GstSpotifySessionContext *context);
+
+/* Wake the main loop; notifies arriving before it runs again coalesce */
+static void spotify_session_wakeup(GstSpotifySessionContext *context)
+{
+  g_mutex_lock(&context->notify_lock);
+  if (!context->notify_pending) {
+    context->notify_pending = TRUE;
+    g_cond_signal(&context->cond);
+  }
+  g_mutex_unlock(&context->notify_lock);
+}
+
+/* CPU for a new session's thread.  A process only has one session, so
+ * the CPUs it may run on are picked from in turn by process ID, which
+ * spreads processes started one after the other.  Called with the sessions
+ * lock held. */
+static gint spotify_session_pick_cpu_locked(void)
+{
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+  cpu_set_t allowed;
+  gint cpu, n;
+
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    return -1;
+
+  n = getpid() % CPU_COUNT(&allowed);
+  for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &allowed) && n-- == 0)
+      return cpu;
+  }
+
+  return -1;
+#else
+  return -1;
+#endif
+}
+
+static void spotify_session_pin_thread(GstSpotifySessionContext *context)
+{
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+  cpu_set_t set;
+
+  CPU_ZERO(&set);
+  CPU_SET(context->cpu, &set);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+    GST_DEBUG ("session thread pinned to CPU %d", context->cpu);
+  else
+    GST_DEBUG ("unable to pin session thread to CPU %d", context->cpu);
+#endif
+}
+
+/* Post what callbacks queued for the leasing element, without the context
+ * mutex */
+static void spotify_session_post_messages(GstSpotifySessionContext *context)
+{
+  GstSpotifySrc *spotifysrc;
+
+  if (!g_atomic_int_compare_and_exchange(&context->messages_pending, TRUE,
+                                         FALSE))
+    return;
+
+  spotifysrc = spotify_session_get_src(context->session);
+  if (spotifysrc) {
+    gst_spotify_src_post_warmups(spotifysrc);
+    gst_object_unref(spotifysrc);
+  }
+}
+
+/* Act on the end of the current track, with the context mutex held */
+static void spotify_session_advance_locked(GstSpotifySessionContext *context)
+{
+  GstSpotifySrc *spotifysrc;
+
+  if (!g_atomic_int_compare_and_exchange(&context->end_of_track, TRUE, FALSE))
+    return;
+
+  spotifysrc = spotify_session_get_src(context->session);
+  if (spotifysrc == NULL)
+    return;
+
+  /* A spooled track isn't followed by the next one */
+  if (g_atomic_pointer_get(&spotifysrc->priv->pcm_cache) != NULL ||
+      !gst_spotify_src_next_track(spotifysrc, context))
+    gst_spotify_src_end_of_stream(spotifysrc);
+  gst_object_unref(spotifysrc);
+}
+
+static void spotify_main_loop(GstSpotifySessionContext *context)
+{
+  gboolean expired = FALSE;
+
+  if (context->cpu >= 0)
+    spotify_session_pin_thread(context);
+
+  g_mutex_lock(&context->mutex);
+  while (!context->destroy) {
+    gint64 end_time;
+    int timeout = SPOTIFY_LOOP_MAX_TIMEOUT;
+
+    /* Notifies from here on need another pass */
+    g_mutex_lock(&context->notify_lock);
+    context->notify_pending = FALSE;
+    context->loop_iterations++;
+    g_mutex_unlock(&context->notify_lock);
+
+    if (sp_session_process_events(context->session, &timeout) == SP_ERROR_OK) {
+      GST_DEBUG ("process events next timeout = %d", timeout);
+    } else {
+      timeout = SPOTIFY_LOOP_MAX_TIMEOUT;
+    }
+    spotify_session_advance_locked(context);
+
+    timeout = CLAMP(timeout, 0, SPOTIFY_LOOP_MAX_TIMEOUT);
+    end_time = g_get_monotonic_time () + timeout * G_TIME_SPAN_MILLISECOND;
+    if (g_atomic_int_get(&context->refcount) == 0 && context->linger_deadline)
+      end_time = MIN(end_time, context->linger_deadline);
+
+    /* Sleep without the context lock so elements can use the session */
+    g_mutex_unlock(&context->mutex);
+    spotify_session_post_messages(context);
+    g_mutex_lock(&context->notify_lock);
+    while (!context->notify_pending) {
+      if (!g_cond_wait_until(&context->cond, &context->notify_lock, end_time))
+        break;
+    }
+    if (context->notify_pending)
+      context->loop_wakeups++;
+    g_mutex_unlock(&context->notify_lock);
+    g_mutex_lock(&context->mutex);
+
+    if (g_atomic_int_get(&context->refcount) == 0 && !context->destroy) {
+      /* Lock order is sessions lock first, then the context */
+      g_mutex_unlock(&context->mutex);
+      expired = spotify_session_expire(context);
+      g_mutex_lock(&context->mutex);
+      if (expired)
+        break;
+    }
+  }
+  g_mutex_unlock(&context->mutex);
+
+  if (expired) {
+    /* Nobody joins an expired session's thread, so drop its reference */
+    g_thread_unref(context->thread);
+    spotify_session_free(context);
+  }
+}
+
+static void spotify_set_bitrate_locked(GstSpotifySessionContext *context,
+                                       GstSpotifyBitrate bitrate)
+{
+  sp_bitrate sp_rate;
+
+  switch (bitrate) {
+    case GST_SPOTIFY_BITRATE_96K:
+      sp_rate = SP_BITRATE_96k;
+      break;
+    case GST_SPOTIFY_BITRATE_320K:
+      sp_rate = SP_BITRATE_320k;
+      break;
+    default:
+      sp_rate = SP_BITRATE_160k;
+      break;
+  }
+
+  if (sp_session_preferred_bitrate(context->session, sp_rate) != SP_ERROR_OK)
+    GST_DEBUG ("unable to set bitrate %d", bitrate);
+  /* Don't resync tracks that are already stored offline */
+  sp_session_preferred_offline_bitrate(context->session, sp_rate, FALSE);
+}
+
+static void spotify_set_connection_locked(GstSpotifySessionContext *context,
+                                          GstSpotifyConnectionType type,
+                                          gboolean sync_over_mobile)
+{
+  sp_connection_rules rules = SP_CONNECTION_RULE_NETWORK |
+                              SP_CONNECTION_RULE_ALLOW_SYNC_OVER_WIFI;
+
+  if (sync_over_mobile)
+    rules |= SP_CONNECTION_RULE_ALLOW_SYNC_OVER_MOBILE;
+
+  /* GstSpotifyConnectionType mirrors sp_connection_type */
+  if (sp_session_set_connection_type(context->session,
+                                     (sp_connection_type) type) != SP_ERROR_OK)
+    GST_DEBUG ("unable to set connection type %d", type);
+  sp_session_set_connection_rules(context->session, rules);
+}
+
+/* Sessions can only be shared by elements with the same account and
+ * on-disk locations */
+static gchar *spotify_session_key(const GstSpotifySessionConfig *config)
+{
+  return g_strdup_printf("%s:%s:%s:%s",
+                         config->user ? config->user : "",
+                         config->appkey_file ? config->appkey_file : "",
+                         config->cache_location ? config->cache_location : "",
+                         config->settings_location ?
+                             config->settings_location : "");
+}
+
+/* Find an idle session for @key, called with the sessions lock held */
+static GstSpotifySessionContext *spotify_session_lookup(const gchar *key)
+{
+  GList *l;
+
+  for (l = spotify_sessions; l; l = l->next) {
+    GstSpotifySessionContext *context = l->data;
+
+    if (g_atomic_int_get(&context->refcount) == 0 &&
+        strcmp(context->key, key) == 0)
+      return context;
+  }
+
+  return NULL;
+}
+
+/* Find the entry of @config->accounts to lease a session for: the first
+ * one without a leased session, preferably with an idle one.  Called with
+ * the sessions lock held, returns NULL when all accounts are streaming. */
+static const gchar *spotify_session_pick_account_locked(
+                                   const GstSpotifySessionConfig *config)
+{
+  GstSpotifySessionConfig account_config = *config;
+  const gchar *pick = NULL;
+  gchar **entry;
+
+  for (entry = config->accounts; *entry; entry++) {
+    gchar **account = g_strsplit(*entry, ":", 2);
+    gboolean leased = FALSE, idle = FALSE;
+    gchar *key;
+    GList *l;
+
+    account_config.user = account[0];
+    key = spotify_session_key(&account_config);
+    for (l = spotify_sessions; l; l = l->next) {
+      GstSpotifySessionContext *context = l->data;
+
+      if (strcmp(context->key, key) != 0)
+        continue;
+      if (g_atomic_int_get(&context->refcount) > 0)
+        leased = TRUE;
+      else
+        idle = TRUE;
+    }
+    g_free(key);
+    g_strfreev(account);
+
+    if (leased)
+      continue;
+    if (idle)
+      return *entry;
+    if (pick == NULL)
+      pick = *entry;
+  }
+
+  return pick;
+}
+
+/* Take the idle session closest to expiring out of the pool, to be
+ * destroyed once the sessions lock is released and before any new session
+ * is created */
+static GstSpotifySessionContext *spotify_session_evict_locked(void)
+{
+  GstSpotifySessionContext *oldest = NULL;
+  GList *l;
+
+  for (l = spotify_sessions; l; l = l->next) {
+    GstSpotifySessionContext *context = l->data;
+
+    if (g_atomic_int_get(&context->refcount) == 0 &&
+        (oldest == NULL ||
+         context->linger_deadline < oldest->linger_deadline))
+      oldest = context;
+  }
+
+  if (oldest) {
+    spotify_sessions = g_list_remove(spotify_sessions, oldest);
+    /* Keeps its main loop from expiring it meanwhile */
+    oldest->linger_deadline = 0;
+  }
+
+  return oldest;
+}
+
+/* Leases a logged in session for @config.  @login_latency is set to the
+ * time the session took to create and log in, and left alone when it was
+ * already logged in. */
+static GstSpotifySessionContext *spotify_session_acquire(GstSpotifySrc *src,
+                                   const GstSpotifySessionConfig *config,
+                                   GstClockTime *login_latency)
+{
+  GstSpotifySessionContext *context;
+  GstSpotifySessionConfig account_config;
+  gchar **account = NULL;
+  gchar *key;
+  gint64 begin = g_get_monotonic_time();
+  gboolean logged_in;
+
+  g_mutex_lock(&spotify_sessions_lock);
+  if (config->accounts && config->accounts[0]) {
+    const gchar *entry = spotify_session_pick_account_locked(config);
+
+    if (entry == NULL) {
+      g_mutex_unlock(&spotify_sessions_lock);
+      GST_ELEMENT_ERROR (src, RESOURCE, BUSY,
+          ("All Spotify accounts are streaming"),
+          ("%u accounts", g_strv_length(config->accounts)));
+      return NULL;
+    }
+
+    /* Without a password, the account logs in with stored credentials */
+    account = g_strsplit(entry, ":", 2);
+    account_config = *config;
+    account_config.user = account[0];
+    account_config.password = account[1];
+    account_config.credentials_blob = NULL;
+    config = &account_config;
+  }
+
+  key = spotify_session_key(config);
+  while ((context = spotify_session_lookup(key)) == NULL &&
+         spotify_sessions_live >= SPOTIFY_SESSIONS_PER_PROCESS) {
+    GstSpotifySessionContext *evicted = spotify_session_evict_locked();
+
+    if (evicted == NULL) {
+      if (spotify_sessions_live > g_list_length(spotify_sessions)) {
+        /* Another thread is creating or tearing down a session */
+        g_cond_wait(&spotify_sessions_cond, &spotify_sessions_lock);
+        continue;
+      }
+
+      g_mutex_unlock(&spotify_sessions_lock);
+      GST_ELEMENT_ERROR (src, RESOURCE, BUSY,
+          ("Another element of this process is streaming from Spotify"),
+          ("libspotify supports one session per process, session %s "
+           "is leased", key));
+      g_free(key);
+      g_strfreev(account);
+      return NULL;
+    }
+
+    /* The evicted session is released before its replacement is created,
+     * and the pool may have changed by the time the lock is back */
+    GST_DEBUG_OBJECT (src, "closing idle spotify session %s", evicted->key);
+    g_mutex_unlock(&spotify_sessions_lock);
+    spotify_destroy(evicted);
+    g_mutex_lock(&spotify_sessions_lock);
+  }
+
+  if (context) {
+    GST_DEBUG_OBJECT (src, "reusing spotify session %s", key);
+    g_atomic_int_inc(&context->refcount);
+    context->linger_deadline = 0;
+    g_free(key);
+  } else {
+    gint cpu = config->session_affinity ?
+        spotify_session_pick_cpu_locked() : -1;
+
+    /* The slot is taken before unlocking, creating the session can take a
+     * while and other elements only need the lock to find out it is */
+    spotify_sessions_live++;
+    g_mutex_unlock(&spotify_sessions_lock);
+    GST_DEBUG_OBJECT (src, "creating spotify session %s", key);
+    context = spotify_create(config, cpu);
+    g_mutex_lock(&spotify_sessions_lock);
+    if (context == NULL) {
+      spotify_sessions_live--;
+      g_cond_broadcast(&spotify_sessions_cond);
+      g_mutex_unlock(&spotify_sessions_lock);
+      g_free(key);
+      g_strfreev(account);
+      return NULL;
+    }
+    context->key = key;
+    context->refcount = 1;
+    spotify_sessions = g_list_prepend(spotify_sessions, context);
+    /* Elements waiting for the slot may be able to share it */
+    g_cond_broadcast(&spotify_sessions_cond);
+  }
+  g_weak_ref_set(&context->src, src);
+  /* The end of a previous lease's track is not ours */
+  g_atomic_int_set(&context->end_of_track, FALSE);
+  g_mutex_unlock(&spotify_sessions_lock);
+
+  /* These may differ between the elements sharing a session */
+  g_mutex_lock(&context->mutex);
+  g_free(context->user);
+  context->user = g_strdup(config->user);
+  g_free(context->password);
+  context->password = g_strdup(config->password);
+  context->account = (account != NULL);
+  sp_session_set_cache_size(context->session, config->cache_size);
+  spotify_set_bitrate_locked(context, config->bitrate);
+  sp_session_set_volume_normalization(context->session,
+                                      config->volume_normalization);
+  /* Before logging in, an offline session logs in from stored credentials */
+  spotify_set_connection_locked(context, config->connection_type,
+                                config->sync_over_mobile);
+  logged_in = context->logged_in;
+  g_mutex_unlock(&context->mutex);
+
+  /* Returns immediately when the shared session is already logged in */
+  if (!spotify_login(context, config->user, config->password,
+                     config->credentials_blob, config->remember_me,
+                     config->login_timeout)) {
+    spotify_session_release(context, 0);
+    g_strfreev(account);
+    return NULL;
+  }
+  if (!logged_in)
+    *login_latency = (g_get_monotonic_time() - begin) * GST_USECOND;
+
+  g_strfreev(account);
+  return context;
+}
+
+/* An extra reference on a leased session, dropped with
+ * spotify_session_release() */
+static GstSpotifySessionContext *spotify_session_ref(
+                                   GstSpotifySessionContext *context)
+{
+  g_mutex_lock(&spotify_sessions_lock);
+  g_atomic_int_inc(&context->refcount);
+  g_mutex_unlock(&spotify_sessions_lock);
+
+  return context;
+}
+
+static void spotify_session_release(GstSpotifySessionContext *context,
+                                    guint linger)
+{
+  gboolean destroy = FALSE;
+
+  if (context == NULL)
+    return;
+
+  g_mutex_lock(&spotify_sessions_lock);
+  if (g_atomic_int_dec_and_test(&context->refcount)) {
+    g_weak_ref_set(&context->src, NULL);
+    if (linger == 0 || !context->logged_in) {
+      spotify_sessions = g_list_remove(spotify_sessions, context);
+      destroy = TRUE;
+    } else {
+      GST_DEBUG ("keeping idle spotify session %s for %u ms",
+                 context->key, linger);
+      context->linger_deadline = g_get_monotonic_time () +
+          linger * G_TIME_SPAN_MILLISECOND;
+      /* Let the main loop pick up the new deadline */
+      spotify_session_wakeup(context);
+    }
+  }
+  g_mutex_unlock(&spotify_sessions_lock);
+
+  if (destroy)
+    spotify_destroy(context);
+}
+
+/* Called from the session thread once the session has no users left */
+static gboolean spotify_session_expire(GstSpotifySessionContext *context)
+{
+  gboolean expired = FALSE;
+
+  g_mutex_lock(&spotify_sessions_lock);
+  if (g_atomic_int_get(&context->refcount) == 0 &&
+      context->linger_deadline != 0 &&
+      g_get_monotonic_time () >= context->linger_deadline) {
+    GST_DEBUG ("idle spotify session %s expired", context->key);
+    spotify_sessions = g_list_remove(spotify_sessions, context);
+    expired = TRUE;
+  }
+  g_mutex_unlock(&spotify_sessions_lock);
+
+  return expired;
+}
+
+static void spotify_session_get_loop_stats(GstSpotifySessionContext *context,
+                                           guint64 *iterations,
+                                           guint64 *wakeups)
+{
+  g_mutex_lock(&context->notify_lock);
+  *iterations = context->loop_iterations;
+  *wakeups = context->loop_wakeups;
+  g_mutex_unlock(&context->notify_lock);
 }
 
-static gchar *
-gst_spotify_src_uri_get_uri (GstURIHandler * handler)
+/* Returns a reference to the element leasing the session, or NULL */
+static GstSpotifySrc *spotify_session_get_src(sp_session *session)
 {
-  GstSpotifySrc *spotifysrc = GST_SPOTIFY_SRC (handler);
-  return spotifysrc->priv->uri;
+  GstSpotifySessionContext *context = sp_session_userdata(session);
+
+  return g_weak_ref_get(&context->src);
 }
 
-static gboolean
-gst_spotify_src_uri_set_uri (GstURIHandler * handler, const gchar * uri, GError ** error)
+/*
+ * Block on the context event condition until @end_time.  The context
+ * mutex must be held; it is released while waiting so the main loop can
+ * process events and run the callbacks that signal us.  Returns FALSE
+ * once the deadline has passed or the leasing element was unlocked.
+ */
+static gboolean spotify_wait_event(GstSpotifySessionContext *context,
+                                   gint64 end_time)
 {
-  gboolean res = TRUE;
-  GstSpotifySrc *spotifysrc = GST_SPOTIFY_SRC (handler);
+  GstSpotifySrc *src = g_weak_ref_get(&context->src);
+  gboolean cancelled = FALSE;
 
-  GST_DEBUG_OBJECT (spotifysrc, "New URI for interface: '%s' for spotify src", uri);
-  if (!gst_spotify_src_set_uri (spotifysrc, uri)) {
-    *error = g_error_new (
-      g_quark_from_string("gst-resource-error-quark"),
-      GST_RESOURCE_ERROR_FAILED,
-      "Failed to set source URI: '%s'", uri);
-      res = FALSE;
+  if (src) {
+    cancelled = g_atomic_int_get(&src->priv->cancel);
+    gst_object_unref(src);
   }
-  return res;
+  if (cancelled) {
+    GST_DEBUG ("wait cancelled");
+    return FALSE;
+  }
+
+  /* Make sure the main loop runs the events we are waiting for */
+  spotify_session_wakeup(context);
+  return g_cond_wait_until(&context->event_cond, &context->mutex, end_time);
 }
 
-static void
-gst_spotify_src_uri_handler_init (gpointer g_iface, gpointer iface_data)
+/* Wake the waits of the session @src leases, after setting its cancel
+ * flag.  The broadcast is made with the context mutex held, so a waiter
+ * either sees the flag or is already waiting. */
+static void spotify_session_cancel(GstSpotifySrc *src)
 {
-  GstURIHandlerInterface *iface = (GstURIHandlerInterface *) g_iface;
-
-  iface->get_type = gst_spotify_src_uri_get_type;
-  iface->get_protocols = gst_spotify_src_uri_get_protocols;
-  iface->get_uri = gst_spotify_src_uri_get_uri;
-  iface->set_uri = gst_spotify_src_uri_set_uri;
+  GstSpotifySessionContext *context;
+  GstSpotifySrc *leaser;
+  GList *l;
+
+  g_mutex_lock(&spotify_sessions_lock);
+  for (l = spotify_sessions; l; l = l->next) {
+    context = l->data;
+    leaser = g_weak_ref_get(&context->src);
+    if (leaser == src) {
+      g_mutex_lock(&context->mutex);
+      g_cond_broadcast(&context->event_cond);
+      g_mutex_unlock(&context->mutex);
+    }
+    if (leaser)
+      gst_object_unref(leaser);
+  }
+  g_mutex_unlock(&spotify_sessions_lock);
 }
 
-/**** SPOTIFY interface  **************************************************/
+/* Resume the login libspotify stored credentials for, if they are @user's */
+static sp_error spotify_relogin_locked(GstSpotifySessionContext *context,
+                                       const char *user)
+{
+  char remembered[256];
+
+  if (sp_session_remembered_user(context->session, remembered,
+                                 sizeof(remembered)) < 0)
+    return SP_ERROR_NO_CREDENTIALS;
+  if (user && *user && strcmp(user, remembered) != 0) {
+    GST_DEBUG ("stored credentials are for another user");
+    return SP_ERROR_NO_CREDENTIALS;
+  }
 
-#define SPOTIFY_CONTEXT(src) src->priv->spotify_context
+  return sp_session_relogin(context->session);
+}
 
-static void spotify_main_loop(GstSpotifySessionContext *context)
+/* Ways of logging in, in the order they are tried */
+enum
 {
-  g_mutex_lock(&context->mutex);
-  while (!context->destroy) {
-    gint64 end_time;
-    int timeout;
+  SPOTIFY_LOGIN_BLOB,
+  SPOTIFY_LOGIN_PASSWORD,
+  SPOTIFY_LOGIN_STORED,
+  SPOTIFY_LOGIN_DONE
+};
 
-    if (sp_session_process_events(context->session, &timeout) == SP_ERROR_OK) {
-      GST_DEBUG_OBJECT(g_spotifysrc, "process events next timeout = %d", timeout);
-    } else {
-    	timeout = 1000;
+/*
+ * Start logging in the first way from *@method on that there are
+ * credentials for, and advance *@method past it.  Stored credentials can't
+ * fix a rejected login, so after a failure they are only tried when the
+ * server could not be reached.
+ */
+static sp_error spotify_start_login_locked(GstSpotifySessionContext *context,
+                                           const char *user,
+                                           const char *password,
+                                           const char *blob,
+                                           gboolean remember_me,
+                                           gint *method)
+{
+  gboolean retry = (*method != SPOTIFY_LOGIN_BLOB);
+  sp_error ret = SP_ERROR_NO_CREDENTIALS;
+
+  while (ret != SP_ERROR_OK && *method < SPOTIFY_LOGIN_DONE) {
+    switch ((*method)++) {
+      case SPOTIFY_LOGIN_BLOB:
+        if (!blob || !*blob || !user || !*user)
+          continue;
+        GST_DEBUG ("attempting to login with credentials blob");
+        ret = sp_session_login(context->session, user, NULL, remember_me,
+                               blob);
+        break;
+      case SPOTIFY_LOGIN_PASSWORD:
+        if (!password || !*password)
+          continue;
+        GST_DEBUG ("attempting to login");
+        ret = sp_session_login(context->session, user, password,
+                               remember_me, NULL);
+        break;
+      default:
+        if (retry &&
+            context->login_error != SP_ERROR_UNABLE_TO_CONTACT_SERVER)
+          continue;
+        GST_DEBUG ("attempting to login with stored credentials");
+        ret = spotify_relogin_locked(context, user);
+        break;
     }
-
-    end_time = g_get_monotonic_time () + 1 * G_TIME_SPAN_SECOND;
-    g_cond_wait_until(&context->cond, &context->mutex, end_time);
   }
-  g_mutex_unlock(&context->mutex);
-}
 
-static void spotify_loop(void)
-{
-  GstSpotifySessionContext *context = SPOTIFY_CONTEXT(g_spotifysrc);
-  int timeout;
-  sp_session_process_events(context->session, &timeout);
-  GST_DEBUG_OBJECT (g_spotifysrc, "process events next timeout = %d", timeout);
+  if (ret == SP_ERROR_OK) {
+    context->login_error = SP_ERROR_OK;
+    context->logging_in = TRUE;
+  }
+  return ret;
 }
 
 static gboolean spotify_login(GstSpotifySessionContext *context,
                               const char *user,
-                              const char *password)
+                              const char *password,
+                              const char *blob,
+                              gboolean remember_me,
+                              guint timeout)
 {
-  context->logged_in = FALSE;
-  GST_DEBUG_OBJECT (g_spotifysrc, "attempting to login");
+  gint64 end_time;
+  sp_error ret = SP_ERROR_OK;
+  gboolean started = FALSE;
+  gint method = SPOTIFY_LOGIN_BLOB;
+
   g_mutex_lock(&context->mutex);
-  sp_error ret = sp_session_login(context->session, user, password,
-                                  FALSE, NULL);
+  if (context->logged_in) {
+    g_mutex_unlock(&context->mutex);
+    return TRUE;
+  }
+
+  /* Another element sharing this session may already be logging in */
+  if (!context->logging_in) {
+    ret = spotify_start_login_locked(context, user, password, blob,
+                                     remember_me, &method);
+    started = (ret == SP_ERROR_OK);
+  }
 
   if (ret == SP_ERROR_OK) {
-    guint cnt = 10;
-    while (!context->logged_in && cnt-- > 0) {
-      spotify_loop();
-      usleep(200000); // 200000 * 10 = 2 seconds
+    end_time = g_get_monotonic_time () + timeout * G_TIME_SPAN_MILLISECOND;
+    for (;;) {
+      while (context->logging_in && !context->logged_in) {
+        if (!spotify_wait_event(context, end_time))
+          break;
+      }
+
+      /* A stale blob falls back on the password, and without a connection
+       * the credentials stored by an earlier login still get the session
+       * to offline playback */
+      if (context->logged_in || context->logging_in || !started)
+        break;
+      GST_DEBUG ("login failed - error = %d, trying the next credentials",
+                 context->login_error);
+      if (spotify_start_login_locked(context, user, password, blob,
+                                     remember_me, &method) != SP_ERROR_OK)
+        break;
     }
 
-    if (!context->logged_in)
+    if (!context->logged_in) {
+      ret = context->login_error;
       goto loginfailed;
+    }
     g_mutex_unlock(&context->mutex);
     return TRUE;
   }
 
 loginfailed:
-  GST_DEBUG_OBJECT (g_spotifysrc, "unable to login - error = %d", ret);
+  GST_DEBUG ("unable to login - error = %d", ret);
   g_mutex_unlock(&context->mutex);
   return FALSE;
 }
 
 static gboolean spotify_seek(GstSpotifySessionContext *context, int offset)
 {
-  GST_DEBUG_OBJECT (g_spotifysrc, "attempting to seek - offset = %d", offset);
+  GST_DEBUG ("attempting to seek - offset = %d", offset);
   g_mutex_lock(&context->mutex);
   sp_error ret = sp_session_player_seek(context->session, offset);
   if (ret != SP_ERROR_OK) {
-    GST_DEBUG_OBJECT (g_spotifysrc, "unable to seek - error = %d", ret);
+    GST_DEBUG ("unable to seek - error = %d", ret);
     g_mutex_unlock(&context->mutex);
     return FALSE;
   }
@@ -899,201 +4755,732 @@ static gboolean spotify_seek(GstSpotifySessionContext *context, int offset)
   return TRUE;
 }
 
-static gboolean spotify_play(GstSpotifySessionContext *context, const char *link)
+static void spotify_albumbrowse_complete_cb(sp_albumbrowse *result,
+                                            void *userdata)
+{
+  GstSpotifySessionContext *context = userdata;
+  GST_DEBUG ("album browse complete");
+  g_cond_broadcast(&context->event_cond);
+}
+
+static void spotify_playlist_state_changed_cb(sp_playlist *playlist,
+                                              void *userdata)
+{
+  GstSpotifySessionContext *context = userdata;
+  GST_DEBUG ("playlist state changed");
+  g_cond_broadcast(&context->event_cond);
+}
+
+static sp_playlist_callbacks playlist_callbacks = {
+  .playlist_state_changed = &spotify_playlist_state_changed_cb,
+};
+
+/*
+ * Track metadata outlives sessions, so repeat plays can be tagged without
+ * waiting for libspotify to load the artist and album again.  Entries are
+ * kept most recently used first in spotify_track_lru, which the hash table
+ * indexes by link.
+ */
+static GMutex spotify_track_cache_lock;
+static GHashTable *spotify_track_cache = NULL;
+static GQueue spotify_track_lru = G_QUEUE_INIT;
+
+static void spotify_track_info_free(GstSpotifyTrackInfo *info)
+{
+  if (info == NULL)
+    return;
+
+  g_free(info->link);
+  g_free(info->title);
+  g_strfreev(info->artists);
+  g_free(info->album);
+  g_slice_free(GstSpotifyTrackInfo, info);
+}
+
+static GstSpotifyTrackInfo *spotify_track_info_copy(
+    const GstSpotifyTrackInfo *info)
+{
+  GstSpotifyTrackInfo *copy = g_slice_new(GstSpotifyTrackInfo);
+
+  copy->link = g_strdup(info->link);
+  copy->title = g_strdup(info->title);
+  copy->artists = g_strdupv(info->artists);
+  copy->album = g_strdup(info->album);
+  copy->duration = info->duration;
+  copy->available = info->available;
+
+  return copy;
+}
+
+/* Returns a copy of the cached metadata for @link, or NULL */
+static GstSpotifyTrackInfo *spotify_track_cache_lookup(const gchar *link)
+{
+  GstSpotifyTrackInfo *info = NULL;
+  GList *l = NULL;
+
+  g_mutex_lock(&spotify_track_cache_lock);
+  if (spotify_track_cache)
+    l = g_hash_table_lookup(spotify_track_cache, link);
+  if (l) {
+    g_queue_unlink(&spotify_track_lru, l);
+    g_queue_push_head_link(&spotify_track_lru, l);
+    info = spotify_track_info_copy(l->data);
+  }
+  g_mutex_unlock(&spotify_track_cache_lock);
+
+  return info;
+}
+
+static void spotify_track_cache_insert(const GstSpotifyTrackInfo *info)
+{
+  GstSpotifyTrackInfo *entry;
+  GList *l;
+
+  g_mutex_lock(&spotify_track_cache_lock);
+  if (spotify_track_cache == NULL)
+    spotify_track_cache = g_hash_table_new(g_str_hash, g_str_equal);
+
+  l = g_hash_table_lookup(spotify_track_cache, info->link);
+  if (l) {
+    entry = l->data;
+    g_hash_table_remove(spotify_track_cache, entry->link);
+    g_queue_delete_link(&spotify_track_lru, l);
+    spotify_track_info_free(entry);
+  }
+
+  entry = spotify_track_info_copy(info);
+  g_queue_push_head(&spotify_track_lru, entry);
+  g_hash_table_insert(spotify_track_cache, entry->link,
+                      g_queue_peek_head_link(&spotify_track_lru));
+
+  while (g_queue_get_length(&spotify_track_lru) > SPOTIFY_TRACK_CACHE_SIZE) {
+    entry = g_queue_pop_tail(&spotify_track_lru);
+    GST_LOG ("evicting %s from the track cache", entry->link);
+    g_hash_table_remove(spotify_track_cache, entry->link);
+    spotify_track_info_free(entry);
+  }
+  g_mutex_unlock(&spotify_track_cache_lock);
+}
+
+/*
+ * Describe @spt, filling in from the cache whatever libspotify has not
+ * loaded yet rather than waiting for it.  Only complete descriptions are
+ * cached.  Returns NULL for a track neither loaded nor cached.  Called with
+ * the context mutex held.
+ */
+static GstSpotifyTrackInfo *spotify_track_info_get_locked(
+    GstSpotifySessionContext *context, sp_track *spt)
+{
+  GstSpotifyTrackInfo *info, *cached;
+  gboolean complete = TRUE;
+  GPtrArray *artists;
+  sp_artist *artist;
+  sp_album *album;
+  sp_link *spl;
+  char link[256];
+  int i;
+
+  spl = sp_link_create_from_track(spt, 0);
+  if (spl == NULL)
+    return NULL;
+  sp_link_as_string(spl, link, sizeof(link));
+  sp_link_release(spl);
+
+  cached = spotify_track_cache_lookup(link);
+  if (!sp_track_is_loaded(spt))
+    return cached;
+
+  info = g_slice_new0(GstSpotifyTrackInfo);
+  info->link = g_strdup(link);
+  info->title = g_strdup(sp_track_name(spt));
+  info->duration = sp_track_duration(spt) * GST_MSECOND;
+  info->available = sp_track_get_availability(context->session, spt) ==
+      SP_TRACK_AVAILABILITY_AVAILABLE;
+
+  artists = g_ptr_array_new();
+  for (i = 0; i < sp_track_num_artists(spt); i++) {
+    artist = sp_track_artist(spt, i);
+    if (sp_artist_is_loaded(artist))
+      g_ptr_array_add(artists, g_strdup(sp_artist_name(artist)));
+    else
+      complete = FALSE;
+  }
+  g_ptr_array_add(artists, NULL);
+  info->artists = (gchar **) g_ptr_array_free(artists, FALSE);
+
+  album = sp_track_album(spt);
+  if (album && sp_album_is_loaded(album))
+    info->album = g_strdup(sp_album_name(album));
+  else if (album)
+    complete = FALSE;
+
+  if (complete) {
+    spotify_track_cache_insert(info);
+  } else if (cached) {
+    GST_DEBUG ("using cached artist and album for %s", link);
+    g_strfreev(info->artists);
+    info->artists = g_strdupv(cached->artists);
+    if (info->album == NULL)
+      info->album = g_strdup(cached->album);
+  }
+  spotify_track_info_free(cached);
+
+  return info;
+}
+
+/* Tags for @spt, or NULL while it is loading.  Called with the context
+ * mutex held. */
+static GstTagList *spotify_track_tags_locked(GstSpotifySessionContext *context,
+                                             sp_track *spt)
+{
+  GstSpotifyTrackInfo *info;
+  GstTagList *tags;
+  int i;
+
+  info = spotify_track_info_get_locked(context, spt);
+  if (info == NULL)
+    return NULL;
+
+  tags = gst_tag_list_new_empty();
+  if (info->title && *info->title)
+    gst_tag_list_add(tags, GST_TAG_MERGE_REPLACE, GST_TAG_TITLE,
+                     info->title, NULL);
+  for (i = 0; info->artists && info->artists[i]; i++) {
+    if (*info->artists[i])
+      gst_tag_list_add(tags, GST_TAG_MERGE_APPEND, GST_TAG_ARTIST,
+                       info->artists[i], NULL);
+  }
+  if (info->album && *info->album)
+    gst_tag_list_add(tags, GST_TAG_MERGE_REPLACE, GST_TAG_ALBUM,
+                     info->album, NULL);
+  if (info->duration > 0)
+    gst_tag_list_add(tags, GST_TAG_MERGE_REPLACE, GST_TAG_DURATION,
+                     (guint64) info->duration, NULL);
+  spotify_track_info_free(info);
+
+  return tags;
+}
+
+/* Returns a new track reference for a track @link, or NULL.  Called with
+ * the context mutex held. */
+static sp_track *spotify_track_from_link_locked(const char *link)
+{
+  sp_link *spl;
+  sp_track *spt = NULL;
+
+  spl = sp_link_create_from_string(link);
+  if (spl == NULL)
+    return NULL;
+
+  if (sp_link_type(spl) == SP_LINKTYPE_TRACK) {
+    spt = sp_link_as_track(spl);
+    if (spt)
+      sp_track_add_ref(spt);
+  }
+  sp_link_release(spl);
+
+  return spt;
+}
+
+/*
+ * Expand a track, album or playlist @link into references to its tracks,
+ * appended to @tracks.  Albums and playlists are waited for until @timeout;
+ * the tracks themselves may still be loading on return.
+ */
+static gboolean spotify_resolve(GstSpotifySessionContext *context,
+                                const char *link, guint timeout,
+                                GPtrArray *tracks)
 {
-  GST_DEBUG_OBJECT (g_spotifysrc, "attempting to load link = %s", link);
+  sp_albumbrowse *browse;
+  sp_playlist *playlist;
+  sp_track *spt;
+  sp_link *spl;
+  gint64 end_time;
+  int i;
+
+  GST_DEBUG ("attempting to resolve link = %s", link);
 
   g_mutex_lock(&context->mutex);
-  sp_link *spl = sp_link_create_from_string(link);
+  spl = sp_link_create_from_string(link);
   if (!spl)
   {
-    GST_DEBUG_OBJECT (g_spotifysrc, "could not create link for %s", link);
+    GST_DEBUG ("could not create link for %s", link);
     g_mutex_unlock(&context->mutex);
     return FALSE;
   }
 
-  sp_track *spt = sp_link_as_track(spl);
-  if (!spt)
-  {
-    GST_DEBUG_OBJECT (g_spotifysrc, "could not find track for %s", link);
-    sp_link_release(spl);
-    g_mutex_unlock(&context->mutex);
+  end_time = g_get_monotonic_time () + timeout * G_TIME_SPAN_MILLISECOND;
+
+  switch (sp_link_type(spl)) {
+    case SP_LINKTYPE_TRACK:
+      spt = sp_link_as_track(spl);
+      if (spt) {
+        sp_track_add_ref(spt);
+        g_ptr_array_add(tracks, spt);
+      }
+      break;
+    case SP_LINKTYPE_ALBUM:
+      browse = sp_albumbrowse_create(context->session, sp_link_as_album(spl),
+                                     &spotify_albumbrowse_complete_cb, context);
+      if (browse == NULL)
+        break;
+      while (!sp_albumbrowse_is_loaded(browse)) {
+        if (!spotify_wait_event(context, end_time))
+          break;
+      }
+      if (sp_albumbrowse_is_loaded(browse) &&
+          sp_albumbrowse_error(browse) == SP_ERROR_OK) {
+        for (i = 0; i < sp_albumbrowse_num_tracks(browse); i++) {
+          spt = sp_albumbrowse_track(browse, i);
+          sp_track_add_ref(spt);
+          g_ptr_array_add(tracks, spt);
+        }
+      }
+      sp_albumbrowse_release(browse);
+      break;
+    case SP_LINKTYPE_PLAYLIST:
+      playlist = sp_playlist_create(context->session, spl);
+      if (playlist == NULL)
+        break;
+      sp_playlist_add_callbacks(playlist, &playlist_callbacks, context);
+      while (!sp_playlist_is_loaded(playlist)) {
+        if (!spotify_wait_event(context, end_time))
+          break;
+      }
+      if (sp_playlist_is_loaded(playlist)) {
+        for (i = 0; i < sp_playlist_num_tracks(playlist); i++) {
+          spt = sp_playlist_track(playlist, i);
+          sp_track_add_ref(spt);
+          g_ptr_array_add(tracks, spt);
+        }
+      }
+      sp_playlist_remove_callbacks(playlist, &playlist_callbacks, context);
+      sp_playlist_release(playlist);
+      break;
+    default:
+      break;
+  }
+  sp_link_release(spl);
+  g_mutex_unlock(&context->mutex);
+
+  if (tracks->len == 0) {
+    GST_DEBUG ("could not find any tracks for %s", link);
     return FALSE;
   }
 
-  /* Increment ref counts */
-  sp_track_add_ref(spt);
-  sp_link_add_ref(spl);
+  GST_DEBUG ("resolved %u tracks", tracks->len);
+  return TRUE;
+}
 
-  /* Busy wait for track to load */
-  GST_DEBUG_OBJECT (g_spotifysrc, "waiting for track to load...");
-  guint cnt = 20;
-  while (!sp_track_is_loaded(spt) && cnt-- > 0) {
-    spotify_loop();
-    usleep(200000); // 200000 * 20 = 4 seconds
-  }
+/*
+ * Add the playlist @link to the offline store, or remove it.  The playlist
+ * is waited for until @timeout; its offline @status and the percentage of
+ * it downloaded are returned in any case.
+ */
+static gboolean spotify_set_offline(GstSpotifySessionContext *context,
+                                    const char *link, gboolean offline,
+                                    guint timeout,
+                                    sp_playlist_offline_status *status,
+                                    int *progress)
+{
+  sp_playlist *playlist = NULL;
+  sp_link *spl;
+  gint64 end_time;
+  sp_error ret = SP_ERROR_INVALID_INDATA;
 
-  if (!sp_track_is_loaded(spt)) {
-    GST_DEBUG_OBJECT (g_spotifysrc, "track loading timed out");
-    sp_track_release(spt);
+  GST_DEBUG ("setting offline mode of %s to %d", link, offline);
+
+  g_mutex_lock(&context->mutex);
+  spl = sp_link_create_from_string(link);
+  if (spl) {
+    if (sp_link_type(spl) == SP_LINKTYPE_PLAYLIST)
+      playlist = sp_playlist_create(context->session, spl);
     sp_link_release(spl);
+  }
+  if (playlist == NULL) {
+    GST_DEBUG ("%s is not a playlist", link);
     g_mutex_unlock(&context->mutex);
     return FALSE;
   }
 
-  GST_DEBUG_OBJECT (g_spotifysrc, "track is loaded");
+  end_time = g_get_monotonic_time () + timeout * G_TIME_SPAN_MILLISECOND;
+  sp_playlist_add_callbacks(playlist, &playlist_callbacks, context);
+  while (!sp_playlist_is_loaded(playlist)) {
+    if (!spotify_wait_event(context, end_time))
+      break;
+  }
+
+  if (sp_playlist_is_loaded(playlist))
+    ret = sp_playlist_set_offline_mode(context->session, playlist, offline);
+  else
+    ret = SP_ERROR_IS_LOADING;
+  if (ret != SP_ERROR_OK)
+    GST_DEBUG ("unable to set offline mode - error = %d", ret);
+
+  *status = sp_playlist_get_offline_status(context->session, playlist);
+  *progress = sp_playlist_get_offline_download_completed(context->session,
+                                                         playlist);
+  sp_playlist_remove_callbacks(playlist, &playlist_callbacks, context);
+  sp_playlist_release(playlist);
+  g_mutex_unlock(&context->mutex);
+
+  return ret == SP_ERROR_OK;
+}
+
+static void spotify_release_tracks(GstSpotifySessionContext *context,
+                                   GPtrArray *tracks)
+{
+  guint i;
+
+  g_mutex_lock(&context->mutex);
+  for (i = 0; i < tracks->len; i++)
+    sp_track_release(g_ptr_array_index(tracks, i));
+  g_mutex_unlock(&context->mutex);
+  g_ptr_array_set_size(tracks, 0);
+}
 
+/* Start playing a loaded track, called with the context mutex held */
+static gboolean spotify_load_track_locked(GstSpotifySessionContext *context,
+                                          sp_track *spt, gint64 *duration)
+{
   sp_error ret = sp_session_player_load(context->session, spt);
   if (ret != SP_ERROR_OK) {
-    GST_DEBUG_OBJECT (g_spotifysrc, "player could not load track - error = %d", ret);
-    sp_track_release(spt);
-    sp_link_release(spl);
-    g_mutex_unlock(&context->mutex);
+    GST_DEBUG ("player could not load track - error = %d", ret);
     return FALSE;
   }
 
   /* Update track duration */
-  g_spotifysrc->priv->size = sp_track_duration(spt) * GST_MSECOND;
+  *duration = sp_track_duration(spt) * GST_MSECOND;
 
   ret = sp_session_player_play(context->session, TRUE);
   if (ret != SP_ERROR_OK) {
-    GST_DEBUG_OBJECT (g_spotifysrc, "player could not play - error = %d", ret);
-    sp_track_release(spt);
-    sp_link_release(spl);
+    GST_DEBUG ("player could not play - error = %d", ret);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean spotify_play(GstSpotifySessionContext *context, sp_track *spt,
+                             guint timeout, gint64 *duration)
+{
+  gint64 end_time;
+  gboolean res;
+
+  g_mutex_lock(&context->mutex);
+
+  /* Wait for the metadata update that completes the track load */
+  GST_DEBUG ("waiting for track to load...");
+  end_time = g_get_monotonic_time () + timeout * G_TIME_SPAN_MILLISECOND;
+  while (!sp_track_is_loaded(spt)) {
+    if (!spotify_wait_event(context, end_time))
+      break;
+  }
+
+  if (!sp_track_is_loaded(spt)) {
+    GST_DEBUG ("track loading timed out");
     g_mutex_unlock(&context->mutex);
     return FALSE;
   }
 
+  GST_DEBUG ("track is loaded");
+
+  res = spotify_load_track_locked(context, spt, duration);
   g_mutex_unlock(&context->mutex);
-  return TRUE;
+  return res;
 }
 
 static gboolean spotify_stop(GstSpotifySessionContext *context)
 {
-  GST_DEBUG_OBJECT (g_spotifysrc, "attempting to stop player");
+  GST_DEBUG ("attempting to stop player");
   g_mutex_lock(&context->mutex);
   sp_error ret = sp_session_player_play(context->session, FALSE);
   if (ret != SP_ERROR_OK) {
-    GST_DEBUG_OBJECT (g_spotifysrc, "unable to stop player - error = %d", ret);
+    GST_DEBUG ("unable to stop player - error = %d", ret);
     g_mutex_unlock(&context->mutex);
     return FALSE;
   }
 
   ret = sp_session_player_unload(context->session);
   if (ret != SP_ERROR_OK) {
-    GST_DEBUG_OBJECT (g_spotifysrc, "unable to unload player - error = %d", ret);
+    GST_DEBUG ("unable to unload player - error = %d", ret);
     g_mutex_unlock(&context->mutex);
     return FALSE;
   }
 
-  /* Reset total track size */
-  g_spotifysrc->priv->size = -1;
-
   g_mutex_unlock(&context->mutex);
   return TRUE;
 }
 
 static void spotify_logged_in_cb(sp_session *session, sp_error error)
 {
-  GstSpotifySessionContext *context = SPOTIFY_CONTEXT(g_spotifysrc);
-  GST_DEBUG_OBJECT (g_spotifysrc, "logged in with response = %d", error);
+  GstSpotifySessionContext *context = sp_session_userdata(session);
+  GST_DEBUG ("logged in with response = %d", error);
   if (error == SP_ERROR_OK)
     context->logged_in = TRUE;
   else
     context->logged_in = FALSE;
+  context->logging_in = FALSE;
+  context->login_error = error;
+  g_cond_broadcast(&context->event_cond);
 
-    // This is absolutely necessary here, see: http://goo.gl/78xPQh
-    sp_session_playlistcontainer(session);
+  // This is absolutely necessary here, see: http://goo.gl/78xPQh
+  sp_session_playlistcontainer(session);
 }
 
 static void spotify_logged_out_cb(sp_session *session)
 {
-  GstSpotifySessionContext *context = SPOTIFY_CONTEXT(g_spotifysrc);
-  GST_DEBUG_OBJECT (g_spotifysrc, "logged out");
+  GstSpotifySessionContext *context = sp_session_userdata(session);
+  GstSpotifySrc *spotifysrc;
+
+  GST_DEBUG ("logged out");
   context->logged_in = FALSE;
+  g_cond_broadcast(&context->event_cond);
+
+  /* Never asked for, the server ended the session */
+  spotifysrc = spotify_session_get_src(session);
+  if (spotifysrc) {
+    gst_spotify_src_session_failed(spotifysrc, GST_SPOTIFY_SRC_RECOVER_NOW);
+    gst_object_unref(spotifysrc);
+  }
 }
 
 static void spotify_connection_error_cb(sp_session *session, sp_error error)
 {
-  GstSpotifySessionContext *context = SPOTIFY_CONTEXT(g_spotifysrc);
-  GST_DEBUG_OBJECT (g_spotifysrc, "connection error - error = %d", error);
+  GstSpotifySessionContext *context = sp_session_userdata(session);
+  GstSpotifySrc *spotifysrc;
+  gboolean changed;
+
+  GST_DEBUG ("connection error - error = %d", error);
+  changed = (context->connection_error != error);
   context->connection_error = error;
+  if (error == SP_ERROR_OK)
+    return;
+
+  /* libspotify keeps reconnecting and repeats this while it fails */
+  spotifysrc = spotify_session_get_src(session);
+  if (spotifysrc) {
+    if (changed)
+      GST_ELEMENT_WARNING (spotifysrc, RESOURCE, READ,
+          ("Lost the connection to Spotify: %s", sp_error_message(error)),
+          (NULL));
+    gst_spotify_src_session_failed(spotifysrc,
+                                   GST_SPOTIFY_SRC_RECOVER_STALLED);
+    gst_object_unref(spotifysrc);
+  }
 }
 
 static void spotify_message_to_user_cb(sp_session *session, const char *msg)
 {
-  GST_DEBUG_OBJECT (g_spotifysrc, "user message = %s", msg);
+  GST_DEBUG ("user message = %s", msg);
 }
 
 static void spotify_metadata_updated_cb(sp_session *session)
 {
-  GST_DEBUG_OBJECT (g_spotifysrc, "metadata updated");
+  GstSpotifySessionContext *context = sp_session_userdata(session);
+  GstSpotifySrc *spotifysrc;
+  gboolean switch_pending;
+
+  GST_DEBUG ("metadata updated");
+  g_cond_broadcast(&context->event_cond);
+
+  /* Maybe the next track finished loading */
+  spotifysrc = spotify_session_get_src(session);
+  if (spotifysrc) {
+    g_mutex_lock(&spotifysrc->priv->tracks_lock);
+    switch_pending = spotifysrc->priv->switch_pending;
+    g_mutex_unlock(&spotifysrc->priv->tracks_lock);
+
+    if (switch_pending) {
+      if (!gst_spotify_src_next_track(spotifysrc, context))
+        gst_spotify_src_end_of_stream(spotifysrc);
+    } else {
+      gst_spotify_src_process_warmups(spotifysrc, context);
+      gst_spotify_src_prefetch(spotifysrc, context);
+    }
+    gst_object_unref(spotifysrc);
+  }
 }
 
 static void spotify_notify_main_thread_cb(sp_session *session)
 {
-  GstSpotifySessionContext *context = SPOTIFY_CONTEXT(g_spotifysrc);
-  GST_DEBUG_OBJECT (g_spotifysrc, "notify main thread");
-  g_cond_signal(&context->cond);
+  GstSpotifySessionContext *context = sp_session_userdata(session);
+  GST_DEBUG ("notify main thread");
+  spotify_session_wakeup(context);
 }
 
 static int spotify_music_delivery_cb(sp_session *session,
 		                             const sp_audioformat *format,
 		                             const void *frames, int num_frames)
 {
-  guint bufsize = num_frames * sizeof(int16_t) * format->channels;
+  GstSpotifySrc *spotifysrc;
+  int ret;
 
-  GST_DEBUG_OBJECT (g_spotifysrc, "music delivery - bufsize = %d "
-		            "rate = %d channels = %d num_frames = %d",
-		            bufsize, format->sample_rate, format->channels, num_frames);
-  if (num_frames == 0) {
-    return 0; /* Seeking */
-  }
+  GST_LOG ("music delivery - rate = %d channels = %d num_frames = %d",
+		            format->sample_rate, format->channels, num_frames);
 
-  return gst_spotify_src_alloc_and_queue(g_spotifysrc, num_frames, frames, bufsize);
+  /* Lingering session without an element, discard.  Empty deliveries are
+   * passed on too, they tell the element libspotify flushed for a seek. */
+  spotifysrc = spotify_session_get_src(session);
+  if (spotifysrc == NULL)
+    return num_frames;
+
+  ret = gst_spotify_src_queue_frames(spotifysrc, format, num_frames, frames);
+  gst_object_unref(spotifysrc);
+
+  return ret;
 }
 
 static void spotify_play_token_lost_cb(sp_session *session)
 {
-  GstSpotifySessionContext *context = SPOTIFY_CONTEXT(g_spotifysrc);
-  GST_DEBUG_OBJECT (g_spotifysrc, "play token has been lost");
+  GstSpotifySessionContext *context = sp_session_userdata(session);
+  GstSpotifySrc *spotifysrc;
+
+  GST_DEBUG ("play token has been lost");
   context->play_token_lost = TRUE;
+
+  /* Playing again would only take the account back from the other player */
+  spotifysrc = spotify_session_get_src(session);
+  if (spotifysrc) {
+    gst_spotify_src_session_failed(spotifysrc,
+                                   GST_SPOTIFY_SRC_RECOVER_FATAL);
+    gst_object_unref(spotifysrc);
+  }
 }
 
 static void spotify_log_message_cb(sp_session *session, const char *msg)
 {
-  GST_DEBUG_OBJECT (g_spotifysrc, "log message = %s", msg);
+  GST_DEBUG ("log message = %s", msg);
 }
 
+/*
+ * Called from libspotify's audio thread, which must not touch the
+ * session while sp_session_process_events() may be running; the main
+ * loop switches to the next track instead.
+ */
 static void spotify_end_of_track_cb(sp_session *session)
 {
-  GST_DEBUG_OBJECT (g_spotifysrc, "end of track");
-  gst_spotify_src_end_of_stream(g_spotifysrc);
+  GstSpotifySessionContext *context = sp_session_userdata(session);
+  GstSpotifySrc *spotifysrc = spotify_session_get_src(session);
+
+  GST_DEBUG_OBJECT (spotifysrc, "end of track");
+  if (spotifysrc) {
+    g_atomic_int_inc(&spotifysrc->priv->tracks_delivered);
+    g_atomic_int_set(&context->end_of_track, TRUE);
+    spotify_session_wakeup(context);
+    gst_object_unref(spotifysrc);
+  }
 }
 
 static void spotify_streaming_error_cb(sp_session *session, sp_error error)
 {
-  GstSpotifySessionContext *context = SPOTIFY_CONTEXT(g_spotifysrc);
-  GST_DEBUG_OBJECT (g_spotifysrc, "streaming error with code = %d", error);
+  GstSpotifySessionContext *context = sp_session_userdata(session);
+  GstSpotifySrc *spotifysrc;
+
+  GST_DEBUG ("streaming error with code = %d", error);
   context->streaming_error = error;
+
+  spotifysrc = spotify_session_get_src(session);
+  if (spotifysrc) {
+    GST_ELEMENT_WARNING (spotifysrc, RESOURCE, READ,
+        ("Streaming from Spotify stopped: %s", sp_error_message(error)),
+        (NULL));
+    gst_spotify_src_session_failed(spotifysrc, GST_SPOTIFY_SRC_RECOVER_NOW);
+    gst_object_unref(spotifysrc);
+  }
 }
 
+/*
+ * libspotify paces its decoding by these, so they have to be current:
+ * samples are the frames queued in the ring, and stutter counts the
+ * dropouts since the last call, then starts over.  In bulk mode the ring
+ * reads as empty until it reaches the high watermark, which keeps
+ * libspotify decoding at full speed.
+ */
 static void spotify_get_audio_buffer_stats_cb(sp_session *session, sp_audio_buffer_stats *stats)
 {
-  stats->stutter = g_spotifysrc->priv->stutter;
-  stats->samples = g_spotifysrc->priv->queued_bytes / (2*sizeof(gint16));
-  GST_DEBUG_OBJECT (g_spotifysrc, "indicating audio buffer stats - stutter = %d samples = %d",
-                    stats->stutter, stats->samples);
+  GstSpotifySrc *spotifysrc = spotify_session_get_src(session);
+  GstSpotifySrcPrivate *priv;
+  guint level;
+  gint stutter;
+
+  if (spotifysrc == NULL) {
+    stats->stutter = stats->samples = 0;
+    return;
+  }
+  priv = spotifysrc->priv;
+
+  /* The delivered format only changes while the ring is empty, so the
+   * level has to be read first to pair it with the right channel count */
+  level = gst_spotify_ring_get_level (priv->ring);
+  if (priv->bulk && level < priv->high_level)
+    level = 0;
+  stats->samples = level /
+      (g_atomic_int_get (&priv->channels) * sizeof(gint16));
+
+  do {
+    stutter = g_atomic_int_get (&priv->unreported_stutter);
+  } while (!g_atomic_int_compare_and_exchange (&priv->unreported_stutter,
+          stutter, 0));
+  stats->stutter = stutter;
+
+  gst_object_unref(spotifysrc);
+  GST_LOG ("indicating audio buffer stats - stutter = %d samples = %d",
+             stats->stutter, stats->samples);
 }
 
 static void spotify_userinfo_updated_cb(sp_session *session)
 {
-  GST_DEBUG_OBJECT (g_spotifysrc, "userinfo updated");
+  GST_DEBUG ("userinfo updated");
+}
+
+static void spotify_credentials_blob_updated_cb(sp_session *session,
+                                                const char *blob)
+{
+  GstSpotifySrc *spotifysrc = spotify_session_get_src(session);
+
+  GST_DEBUG ("credentials blob updated");
+  if (spotifysrc) {
+    gst_spotify_src_set_credentials_blob(spotifysrc, blob);
+    gst_object_unref(spotifysrc);
+  }
+}
+
+static void spotify_offline_status_updated_cb(sp_session *session)
+{
+  GstSpotifySessionContext *context = sp_session_userdata(session);
+  GstSpotifySrc *spotifysrc = spotify_session_get_src(session);
+
+  GST_DEBUG ("offline status updated");
+  if (spotifysrc) {
+    gst_spotify_src_post_offline_status(spotifysrc, context);
+    gst_object_unref(spotifysrc);
+  }
+}
+
+static void spotify_offline_error_cb(sp_session *session, sp_error error)
+{
+  GstSpotifySrc *spotifysrc;
+
+  GST_DEBUG ("offline error - error = %d", error);
+  /* Also called with SP_ERROR_OK once the error went away */
+  if (error == SP_ERROR_OK)
+    return;
+
+  spotifysrc = spotify_session_get_src(session);
+  if (spotifysrc) {
+    GST_ELEMENT_WARNING (spotifysrc, RESOURCE, WRITE,
+        ("Offline sync failed: %s", sp_error_message(error)), (NULL));
+    gst_object_unref(spotifysrc);
+  }
 }
 
-static gboolean spotify_create(char *appkey_file)
+static GstSpotifySessionContext *spotify_create(
+                                   const GstSpotifySessionConfig *config,
+                                   gint cpu)
 {
-  sp_session_callbacks callbacks = {
+  /* libspotify keeps a pointer to these for the lifetime of the session */
+  static const sp_session_callbacks callbacks = {
     &spotify_logged_in_cb,
     &spotify_logged_out_cb,
     &spotify_metadata_updated_cb,
@@ -1109,103 +5496,131 @@ static gboolean spotify_create(char *appkey_file)
     NULL,
     NULL,
     &spotify_get_audio_buffer_stats_cb,
-    NULL,
-    NULL,
-    NULL,
+    &spotify_offline_status_updated_cb,
+    &spotify_offline_error_cb,
+    &spotify_credentials_blob_updated_cb,
     NULL,
     NULL,
     NULL
   };
   GstSpotifySessionContext *context;
-  sp_session_config config;
-
-  if (g_spotifysrc->priv->spotify_context != NULL)
-  {
-    GST_DEBUG_OBJECT (g_spotifysrc, "spotify session already created");
-    return TRUE;
-  }
-
-  static uint8_t appkey[321];
-  static const size_t appkey_size = sizeof(appkey);
+  sp_session_config sp_config;
+  const size_t appkey_size = sizeof(context->appkey);
   FILE *keyfile;
   size_t sz;
 
-  GST_DEBUG_OBJECT (g_spotifysrc, "creating spotify session");
+  if (config->appkey_file == NULL)
+    return NULL;
+
+  context = g_new0(GstSpotifySessionContext, 1);
+  if (context == NULL)
+	  return NULL;
 
-  keyfile = fopen(appkey_file, "r");
+  keyfile = fopen(config->appkey_file, "r");
   if (keyfile == NULL)
-    return FALSE;
+    goto fail;
 
   /* FIXME: error check */
-  sz = fread(appkey, sizeof(uint8_t), appkey_size, keyfile);
+  sz = fread(context->appkey, sizeof(uint8_t), appkey_size, keyfile);
   fclose(keyfile);
 
   if (sz != appkey_size)
-    return FALSE;
+    goto fail;
 
-  context = g_new0(GstSpotifySessionContext, 1);
-  if (context == NULL)
-	  return FALSE;
-
-  memset(context, 0, sizeof(*context));
-
-  memset(&config, 0, sizeof(config));
-  config.application_key = appkey;
-  config.application_key_size = appkey_size;
-  config.api_version = SPOTIFY_API_VERSION;
-  /* FIXME: check if these paths are appropiate */
-  config.cache_location = "/tmp";
-  config.settings_location = "/tmp";
-  config.user_agent = "libgstspotify";
-  config.callbacks = &callbacks;
-  config.compress_playlists = FALSE;
-  config.dont_save_metadata_for_playlists = FALSE;
+  g_weak_ref_init(&context->src, NULL);
+
+  /* -1 when the main loop isn't pinned to a CPU */
+  context->cpu = cpu;
+
+  /* Default to per-user directories that survive a reboot */
+  if (config->cache_location)
+    context->cache_location = g_strdup(config->cache_location);
+  else
+    context->cache_location = g_build_filename(g_get_user_cache_dir(),
+                                               "gstspotify", NULL);
+  if (config->settings_location)
+    context->settings_location = g_strdup(config->settings_location);
+  else
+    context->settings_location = g_build_filename(g_get_user_config_dir(),
+                                                  "gstspotify", NULL);
+
+  memset(&sp_config, 0, sizeof(sp_config));
+  sp_config.application_key = context->appkey;
+  sp_config.application_key_size = appkey_size;
+  sp_config.api_version = SPOTIFY_API_VERSION;
+  sp_config.cache_location = context->cache_location;
+  sp_config.settings_location = context->settings_location;
+  sp_config.user_agent = "libgstspotify";
+  sp_config.callbacks = &callbacks;
+  sp_config.compress_playlists = FALSE;
+  sp_config.dont_save_metadata_for_playlists = FALSE;
 
   /* Once we create the session, we may get callbacks */
-  g_spotifysrc->priv->spotify_context = context;
+  sp_config.userdata = context;
 
-  sp_error ret = sp_session_create(&config, &context->session);
+  GST_DEBUG ("cache location %s, settings location %s",
+             context->cache_location, context->settings_location);
+  sp_error ret = sp_session_create(&sp_config, &context->session);
   if (ret == SP_ERROR_OK)
   {
     context->thread = g_thread_new ("spotify-thread", (GThreadFunc)spotify_main_loop, context);
     if (context->thread == NULL) {
-       GST_DEBUG_OBJECT (g_spotifysrc, "g_thread_create failed!");
+       GST_DEBUG ("g_thread_create failed!");
        sp_session_release(context->session);
+       g_weak_ref_clear(&context->src);
        goto fail;
     }
 
-    return TRUE;
+    return context;
   }
 
-  GST_DEBUG_OBJECT (g_spotifysrc, "unable to create session - error = %d", ret);
+  GST_DEBUG ("unable to create session - error = %d", ret);
+  g_weak_ref_clear(&context->src);
 
 fail:
-  g_spotifysrc->priv->spotify_context = NULL;
+  g_free(context->cache_location);
+  g_free(context->settings_location);
   g_free(context);
-  return FALSE;
+  return NULL;
 }
 
 static gboolean spotify_destroy(GstSpotifySessionContext *context)
 {
   if (context == NULL)
   {
-    GST_DEBUG_OBJECT (g_spotifysrc, "spotify session already destroyed");
+    GST_DEBUG ("spotify session already destroyed");
     return TRUE;
   }
 
-  GST_DEBUG_OBJECT (g_spotifysrc, "now destroying spotify session");
+  GST_DEBUG ("now destroying spotify session");
   g_mutex_lock(&context->mutex);
   context->destroy = TRUE;
-  g_cond_signal(&context->cond);
+  spotify_session_wakeup(context);
   g_mutex_unlock(&context->mutex);
   g_thread_join(context->thread);
-  sp_error ret = sp_session_release(context->session);
-  g_free(context);
-  g_spotifysrc->priv->spotify_context = NULL;
-  if (ret != SP_ERROR_OK) {
-    GST_DEBUG_OBJECT (g_spotifysrc, "failed to release session - error = %d", ret);
-    return FALSE;
-  }
+  spotify_session_free(context);
 
   return TRUE;
 }
+
+/* Called without the sessions lock, once the context is out of the list */
+static void spotify_session_free(GstSpotifySessionContext *context)
+{
+  sp_error ret = sp_session_release(context->session);
+  if (ret != SP_ERROR_OK)
+    GST_DEBUG ("failed to release session - error = %d", ret);
+
+  /* Only now can another session be created */
+  g_mutex_lock(&spotify_sessions_lock);
+  spotify_sessions_live--;
+  g_cond_broadcast(&spotify_sessions_cond);
+  g_mutex_unlock(&spotify_sessions_lock);
+
+  g_weak_ref_clear(&context->src);
+  g_free(context->key);
+  g_free(context->cache_location);
+  g_free(context->settings_location);
+  g_free(context->user);
+  g_free(context->password);
+  g_free(context);
+}
@@ -34,6 +34,45 @@ G_BEGIN_DECLS
 #define GST_SPOTIFY_SRC_CAST(obj) \
   ((GstSpotifySrc*)(obj))
 
+#define GST_TYPE_SPOTIFY_BITRATE \
+  gst_spotify_bitrate_get_type()
+
+/* Preferred streaming bitrates, in kbit/s */
+typedef enum
+{
+  GST_SPOTIFY_BITRATE_96K = 96,
+  GST_SPOTIFY_BITRATE_160K = 160,
+  GST_SPOTIFY_BITRATE_320K = 320
+} GstSpotifyBitrate;
+
+#define GST_TYPE_SPOTIFY_OUTPUT_FORMAT \
+  gst_spotify_output_format_get_type()
+
+/* Sample formats the source can produce, AUTO leaves it to negotiation.
+ * VORBIS needs the plugin built with libvorbisenc. */
+typedef enum
+{
+  GST_SPOTIFY_OUTPUT_FORMAT_AUTO,
+  GST_SPOTIFY_OUTPUT_FORMAT_S16,
+  GST_SPOTIFY_OUTPUT_FORMAT_S32,
+  GST_SPOTIFY_OUTPUT_FORMAT_F32,
+  GST_SPOTIFY_OUTPUT_FORMAT_VORBIS
+} GstSpotifyOutputFormat;
+
+#define GST_TYPE_SPOTIFY_CONNECTION_TYPE \
+  gst_spotify_connection_type_get_type()
+
+/* Network libspotify is told it is on, NONE keeps the session offline */
+typedef enum
+{
+  GST_SPOTIFY_CONNECTION_TYPE_UNKNOWN,
+  GST_SPOTIFY_CONNECTION_TYPE_NONE,
+  GST_SPOTIFY_CONNECTION_TYPE_MOBILE,
+  GST_SPOTIFY_CONNECTION_TYPE_MOBILE_ROAMING,
+  GST_SPOTIFY_CONNECTION_TYPE_WIFI,
+  GST_SPOTIFY_CONNECTION_TYPE_WIRED
+} GstSpotifyConnectionType;
+
 typedef struct _GstSpotifySrc GstSpotifySrc;
 typedef struct _GstSpotifySrcClass GstSpotifySrcClass;
 typedef struct _GstSpotifySrcPrivate GstSpotifySrcPrivate;
@@ -53,11 +92,22 @@ struct _GstSpotifySrcClass
 {
   GstBaseSrcClass basesrc_class;
 
+  /* signals */
+  void (*about_to_finish) (GstSpotifySrc *spotifysrc);
+
+  /* actions */
+  gboolean (*prefetch) (GstSpotifySrc *spotifysrc, gchar **uris);
+  gboolean (*offline_sync) (GstSpotifySrc *spotifysrc, gchar **uris,
+                            gboolean offline);
+
   /*< private >*/
   gpointer     _gst_reserved[GST_PADDING];
 };
 
 GType gst_spotify_src_get_type(void);
+GType gst_spotify_bitrate_get_type(void);
+GType gst_spotify_output_format_get_type(void);
+GType gst_spotify_connection_type_get_type(void);
 
 G_END_DECLS
 
@@ -0,0 +1,181 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstspotifyvorbis.h"
+
+#ifdef HAVE_VORBISENC
+
+#include <vorbis/vorbisenc.h>
+
+struct _GstSpotifyVorbis
+{
+  vorbis_info      vi;
+  vorbis_comment   vc;
+  vorbis_dsp_state vd;
+  vorbis_block     vb;
+
+  GstBuffer *headers[3];
+  gint      rate;
+  gint      channels;
+  /* End of the last packet pulled */
+  guint64   granulepos;
+  gboolean  eos;
+};
+
+static GstBuffer *
+gst_spotify_vorbis_packet_to_buffer (const ogg_packet * packet)
+{
+  GstBuffer *buf;
+
+  buf = gst_buffer_new_allocate (NULL, packet->bytes, NULL);
+  gst_buffer_fill (buf, 0, packet->packet, packet->bytes);
+  GST_BUFFER_OFFSET_END (buf) = packet->granulepos;
+
+  return buf;
+}
+
+/*
+ * VBR at @quality, from -0.1 to 1.0.  Returns NULL for a rate and channel
+ * count libvorbis has no mode for.
+ */
+GstSpotifyVorbis *
+gst_spotify_vorbis_new (gint rate, gint channels, gfloat quality)
+{
+  GstSpotifyVorbis *enc;
+  ogg_packet header[3];
+  guint i;
+
+  enc = g_new0 (GstSpotifyVorbis, 1);
+  enc->rate = rate;
+  enc->channels = channels;
+
+  vorbis_info_init (&enc->vi);
+  if (vorbis_encode_init_vbr (&enc->vi, channels, rate, quality) != 0) {
+    vorbis_info_clear (&enc->vi);
+    g_free (enc);
+    return NULL;
+  }
+
+  vorbis_comment_init (&enc->vc);
+  vorbis_comment_add_tag (&enc->vc, "ENCODER", "libgstspotify");
+  vorbis_analysis_init (&enc->vd, &enc->vi);
+  vorbis_block_init (&enc->vd, &enc->vb);
+
+  vorbis_analysis_headerout (&enc->vd, &enc->vc, &header[0], &header[1],
+      &header[2]);
+  for (i = 0; i < G_N_ELEMENTS (enc->headers); i++) {
+    enc->headers[i] = gst_spotify_vorbis_packet_to_buffer (&header[i]);
+    GST_BUFFER_OFFSET_END (enc->headers[i]) = 0;
+    GST_BUFFER_FLAG_SET (enc->headers[i], GST_BUFFER_FLAG_HEADER);
+  }
+
+  return enc;
+}
+
+void
+gst_spotify_vorbis_free (GstSpotifyVorbis * enc)
+{
+  guint i;
+
+  if (enc == NULL)
+    return;
+
+  for (i = 0; i < G_N_ELEMENTS (enc->headers); i++)
+    gst_buffer_unref (enc->headers[i]);
+
+  vorbis_block_clear (&enc->vb);
+  vorbis_dsp_clear (&enc->vd);
+  vorbis_comment_clear (&enc->vc);
+  vorbis_info_clear (&enc->vi);
+  g_free (enc);
+}
+
+gint
+gst_spotify_vorbis_get_rate (GstSpotifyVorbis * enc)
+{
+  return enc->rate;
+}
+
+gint
+gst_spotify_vorbis_get_channels (GstSpotifyVorbis * enc)
+{
+  return enc->channels;
+}
+
+GstBuffer *
+gst_spotify_vorbis_get_header (GstSpotifyVorbis * enc, guint index)
+{
+  g_return_val_if_fail (index < G_N_ELEMENTS (enc->headers), NULL);
+
+  return gst_buffer_ref (enc->headers[index]);
+}
+
+/* libvorbis analyses planar float, the source converts interleaved */
+void
+gst_spotify_vorbis_write (GstSpotifyVorbis * enc, const gfloat * data,
+    guint n_frames)
+{
+  gfloat **planes;
+  guint i;
+  gint c;
+
+  if (enc->eos)
+    return;
+
+  if (n_frames == 0) {
+    vorbis_analysis_wrote (&enc->vd, 0);
+    enc->eos = TRUE;
+    return;
+  }
+
+  planes = vorbis_analysis_buffer (&enc->vd, n_frames);
+  for (i = 0; i < n_frames; i++) {
+    for (c = 0; c < enc->channels; c++)
+      planes[c][i] = *data++;
+  }
+  vorbis_analysis_wrote (&enc->vd, n_frames);
+}
+
+GstBuffer *
+gst_spotify_vorbis_pull (GstSpotifyVorbis * enc, guint64 * start)
+{
+  ogg_packet packet;
+  GstBuffer *buf;
+
+  while (!vorbis_bitrate_flushpacket (&enc->vd, &packet)) {
+    /* Blocks are only complete once enough audio follows them */
+    if (vorbis_analysis_blockout (&enc->vd, &enc->vb) != 1)
+      return NULL;
+
+    vorbis_analysis (&enc->vb, NULL);
+    vorbis_bitrate_addblock (&enc->vb);
+  }
+
+  buf = gst_spotify_vorbis_packet_to_buffer (&packet);
+  *start = enc->granulepos;
+  if (packet.granulepos >= 0)
+    enc->granulepos = packet.granulepos;
+
+  return buf;
+}
+
+#endif /* HAVE_VORBISENC */
@@ -0,0 +1,58 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _GST_SPOTIFY_VORBIS_H_
+#define _GST_SPOTIFY_VORBIS_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#ifdef HAVE_VORBISENC
+
+/*
+ * Vorbis encoder for the source's output, fed interleaved native endian
+ * F32.  Packets come out as buffers with the granule position of their
+ * last sample in OFFSET_END, headers first.  Not thread safe.
+ */
+typedef struct _GstSpotifyVorbis GstSpotifyVorbis;
+
+GstSpotifyVorbis *gst_spotify_vorbis_new (gint rate, gint channels,
+                                          gfloat quality);
+void            gst_spotify_vorbis_free (GstSpotifyVorbis * enc);
+
+gint            gst_spotify_vorbis_get_rate (GstSpotifyVorbis * enc);
+gint            gst_spotify_vorbis_get_channels (GstSpotifyVorbis * enc);
+/* the three header packets, transfer full */
+GstBuffer      *gst_spotify_vorbis_get_header (GstSpotifyVorbis * enc,
+                                               guint index);
+
+/* 0 frames ends the stream, later writes are ignored */
+void            gst_spotify_vorbis_write (GstSpotifyVorbis * enc,
+                                          const gfloat * data,
+                                          guint n_frames);
+/* next encoded packet or NULL, @start is the granule position of its
+ * first sample */
+GstBuffer      *gst_spotify_vorbis_pull (GstSpotifyVorbis * enc,
+                                         guint64 * start);
+
+#endif /* HAVE_VORBISENC */
+
+G_END_DECLS
+
+#endif
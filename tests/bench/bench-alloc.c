@@ -0,0 +1,136 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Heap allocations while streaming a track, counted by wrapping glibc's
+ * malloc.  Start-up is left out by prerolling first.  Arguments are
+ * spotifysrc properties.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#include "bench-util.h"
+
+#ifdef HAVE___LIBC_MALLOC
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t n, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+extern void __libc_free (void *ptr);
+
+static volatile gint counting = 0;
+static gint allocations = 0;
+static gint frees = 0;
+
+void *
+malloc (size_t size)
+{
+  if (counting)
+    g_atomic_int_inc (&allocations);
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t n, size_t size)
+{
+  if (counting)
+    g_atomic_int_inc (&allocations);
+  return __libc_calloc (n, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+  if (counting)
+    g_atomic_int_inc (&allocations);
+  return __libc_realloc (ptr, size);
+}
+
+void
+free (void *ptr)
+{
+  if (counting && ptr)
+    g_atomic_int_inc (&frees);
+  __libc_free (ptr);
+}
+
+int
+main (int argc, char *argv[])
+{
+  SpotifyMockConfig config;
+  GstElement *pipeline, *src;
+  GstStructure *stats;
+  guint buffers, deliveries;
+  gchar *props, *description;
+  gdouble audio;
+
+  bench_init (&argc, &argv);
+  spotify_mock_config_init (&config);
+  config.speed = 0;
+  spotify_mock_configure (&config);
+
+  props = g_strjoinv (" ", argv + 1);
+  description = g_strdup_printf ("spotifysrc name=src %s ! "
+      "fakesink name=sink sync=false", props);
+  pipeline = bench_pipeline_new (description, BENCH_TRACK_URI);
+
+  if (gst_element_set_state (pipeline, GST_STATE_PAUSED) ==
+      GST_STATE_CHANGE_FAILURE ||
+      gst_element_get_state (pipeline, NULL, NULL, GST_CLOCK_TIME_NONE) !=
+      GST_STATE_CHANGE_SUCCESS)
+    return 1;
+
+  counting = 1;
+  if (!bench_run_to_eos (pipeline))
+    return 1;
+  counting = 0;
+
+  src = bench_pipeline_get (pipeline, "src");
+  g_object_get (src, "stats", &stats, NULL);
+  gst_structure_get_uint (stats, "buffers-pushed", &buffers);
+  gst_structure_get_uint (stats, "deliveries", &deliveries);
+  gst_structure_free (stats);
+  gst_object_unref (src);
+
+  audio = config.track_duration / 1000.0;
+  g_print ("alloc: %u frames per delivery at %d Hz, %s\n",
+      config.chunk_frames, config.rate, props);
+  g_print ("%d allocations, %d frees for %u buffers from %u deliveries\n",
+      allocations, frees, buffers, deliveries);
+  g_print ("%.2f allocations per buffer, %.2f per delivery, %.1f per "
+      "second of audio\n", (gdouble) allocations / MAX (buffers, 1),
+      (gdouble) allocations / MAX (deliveries, 1), allocations / audio);
+
+  bench_pipeline_free (pipeline);
+  g_free (description);
+  g_free (props);
+  bench_deinit ();
+
+  return 0;
+}
+#else
+int
+main (int argc, char *argv[])
+{
+  g_printerr ("counting allocations needs glibc's __libc_malloc\n");
+  return BENCH_SKIP;
+}
+#endif
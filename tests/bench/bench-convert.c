@@ -0,0 +1,102 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Cost of GstSpotifyConvert per frame for each output format, with the
+ * kernels picked for this CPU.  Run it with GST_SPOTIFY_NO_SIMD=1 for the
+ * scalar ones.  Each case takes the best of a few runs, to leave out
+ * interruptions.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "bench-util.h"
+#include "gstspotifyconvert.h"
+
+/* Two 2048 frame deliveries, the size of a read from the ring */
+#define FRAMES      4096
+#define ITERATIONS  2000
+#define RUNS        5
+
+typedef struct
+{
+  const gchar   *name;
+  GstAudioFormat format;
+  gint           out_channels;
+  gdouble        gain;
+} ConvertCase;
+
+static const ConvertCase cases[] = {
+  {"S16 stereo", GST_AUDIO_FORMAT_S16, 2, 1.0},
+  {"S16 stereo, gain", GST_AUDIO_FORMAT_S16, 2, 0.5},
+  {"S32 stereo", GST_AUDIO_FORMAT_S32, 2, 1.0},
+  {"F32 stereo", GST_AUDIO_FORMAT_F32, 2, 1.0},
+  {"F32 stereo, gain", GST_AUDIO_FORMAT_F32, 2, 0.5},
+  {"S16 mono", GST_AUDIO_FORMAT_S16, 1, 1.0},
+  {"F32 mono", GST_AUDIO_FORMAT_F32, 1, 1.0},
+};
+
+int
+main (int argc, char *argv[])
+{
+  const guint in_size = FRAMES * 2 * sizeof (gint16);
+  gint16 *src;
+  guint8 *dest;
+  guint i, c, r;
+
+  gst_init (&argc, &argv);
+
+  /* Full scale noise */
+  src = g_new (gint16, FRAMES * 2);
+  for (i = 0; i < FRAMES * 2; i++)
+    src[i] = (gint16) g_random_int ();
+  dest = g_malloc (FRAMES * 2 * sizeof (gfloat));
+
+  g_print ("convert: %s kernels, %d frames per call\n",
+      gst_spotify_convert_get_impl_name (), FRAMES);
+  for (c = 0; c < G_N_ELEMENTS (cases); c++) {
+    GstSpotifyConvert convert;
+    gint64 best = G_MAXINT64;
+
+    if (!gst_spotify_convert_init (&convert, 2, cases[c].format,
+            cases[c].out_channels, cases[c].gain)) {
+      g_printerr ("could not set up %s\n", cases[c].name);
+      return 1;
+    }
+
+    for (r = 0; r < RUNS; r++) {
+      gint64 begin = bench_get_time_ns ();
+
+      for (i = 0; i < ITERATIONS; i++)
+        gst_spotify_convert_process (&convert, dest, (const guint8 *) src,
+            in_size);
+      best = MIN (best, bench_get_time_ns () - begin);
+    }
+
+    g_print ("%-24s %6.3f ns per frame, %7.2f us per call\n", cases[c].name,
+        (gdouble) best / ITERATIONS / FRAMES,
+        (gdouble) best / ITERATIONS / 1e3);
+  }
+
+  g_free (dest);
+  g_free (src);
+
+  return 0;
+}
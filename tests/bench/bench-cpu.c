@@ -0,0 +1,96 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * CPU time the process takes to play an album delivered in real time, the
+ * mock's share included, and how often the session's main loop woke up
+ * for it.  Arguments are spotifysrc properties.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/resource.h>
+
+#include "bench-util.h"
+
+static gdouble
+timeval_to_seconds (const struct timeval *tv)
+{
+  return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+int
+main (int argc, char *argv[])
+{
+  SpotifyMockConfig config;
+  GstElement *pipeline, *src;
+  GstStructure *stats;
+  struct rusage before, after;
+  gdouble user, sys, wall, audio;
+  guint64 iterations, wakeups;
+  gchar *props, *description;
+  gint64 begin;
+
+  bench_init (&argc, &argv);
+  spotify_mock_config_init (&config);
+  spotify_mock_configure (&config);
+
+  props = g_strjoinv (" ", argv + 1);
+  description = g_strdup_printf ("spotifysrc name=src %s ! "
+      "fakesink name=sink sync=false", props);
+  pipeline = bench_pipeline_new (description, BENCH_ALBUM_URI);
+
+  getrusage (RUSAGE_SELF, &before);
+  begin = g_get_monotonic_time ();
+  if (!bench_run_to_eos (pipeline))
+    return 1;
+  wall = (g_get_monotonic_time () - begin) / 1e6;
+  getrusage (RUSAGE_SELF, &after);
+
+  src = bench_pipeline_get (pipeline, "src");
+  g_object_get (src, "stats", &stats, NULL);
+  gst_structure_get_uint64 (stats, "loop-iterations", &iterations);
+  gst_structure_get_uint64 (stats, "loop-wakeups", &wakeups);
+  gst_structure_free (stats);
+  gst_object_unref (src);
+
+  user = timeval_to_seconds (&after.ru_utime) -
+      timeval_to_seconds (&before.ru_utime);
+  sys = timeval_to_seconds (&after.ru_stime) -
+      timeval_to_seconds (&before.ru_stime);
+  audio = config.album_tracks * config.track_duration / 1000.0;
+
+  g_print ("cpu: %u frames per delivery at %d Hz, speed %.1f, %s\n",
+      config.chunk_frames, config.rate, config.speed, props);
+  g_print ("%.1f s of audio in %.1f s, %.3f s user, %.3f s system\n",
+      audio, wall, user, sys);
+  g_print ("%.2f %% of a core, %.1f us CPU per second of audio\n",
+      100 * (user + sys) / wall, 1e6 * (user + sys) / audio);
+  g_print ("%" G_GUINT64_FORMAT " main loop iterations, %" G_GUINT64_FORMAT
+      " early wakeups, %.1f per second of audio\n", iterations, wakeups,
+      iterations / audio);
+
+  bench_pipeline_free (pipeline);
+  g_free (description);
+  g_free (props);
+  bench_deinit ();
+
+  return 0;
+}
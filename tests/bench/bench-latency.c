@@ -0,0 +1,108 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Time from libspotify handing audio to the element until the sink gets
+ * it, with the mock delivering in real time.  Arguments are spotifysrc
+ * properties, e.g. buffer-duration=20000000.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "bench-util.h"
+
+typedef struct
+{
+  gint        rate;
+  GArray     *latencies;
+} LatencyData;
+
+static GstPadProbeReturn
+latency_probe (GstPad * pad, GstPadProbeInfo * info, LatencyData * data)
+{
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+  gint64 now = g_get_monotonic_time (), delivered, latency;
+
+  /* The first frame of the buffer waited longest */
+  delivered = spotify_mock_get_delivery_time (gst_util_uint64_scale_round
+      (GST_BUFFER_PTS (buf), data->rate, GST_SECOND));
+  if (delivered >= 0) {
+    latency = now - delivered;
+    g_array_append_val (data->latencies, latency);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+int
+main (int argc, char *argv[])
+{
+  SpotifyMockConfig config;
+  GstElement *pipeline, *src, *sink;
+  GstStructure *stats;
+  LatencyData data;
+  guint64 login, load;
+  gchar *props, *description;
+  GstPad *pad;
+
+  bench_init (&argc, &argv);
+  spotify_mock_config_init (&config);
+  spotify_mock_configure (&config);
+
+  props = g_strjoinv (" ", argv + 1);
+  description = g_strdup_printf ("spotifysrc name=src %s ! "
+      "fakesink name=sink sync=false", props);
+  pipeline = bench_pipeline_new (description, BENCH_TRACK_URI);
+
+  data.rate = config.rate;
+  data.latencies = g_array_new (FALSE, FALSE, sizeof (gint64));
+  sink = bench_pipeline_get (pipeline, "sink");
+  pad = gst_element_get_static_pad (sink, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) latency_probe, &data, NULL);
+  gst_object_unref (pad);
+  gst_object_unref (sink);
+
+  if (!bench_run_to_eos (pipeline))
+    return 1;
+
+  src = bench_pipeline_get (pipeline, "src");
+  g_object_get (src, "stats", &stats, NULL);
+  gst_structure_get_uint64 (stats, "login-latency", &login);
+  gst_structure_get_uint64 (stats, "track-load-latency", &load);
+  gst_structure_free (stats);
+  gst_object_unref (src);
+
+  g_print ("latency: %u frames per delivery at %d Hz, %s\n",
+      config.chunk_frames, config.rate, props);
+  bench_print_spread ("delivery to sink", data.latencies, "us");
+  g_print ("%-24s %" G_GUINT64_FORMAT " us\n", "login",
+      login / GST_USECOND);
+  g_print ("%-24s %" G_GUINT64_FORMAT " us\n", "track load",
+      load / GST_USECOND);
+
+  bench_pipeline_free (pipeline);
+  g_array_free (data.latencies, TRUE);
+  g_free (description);
+  g_free (props);
+  bench_deinit ();
+
+  return 0;
+}
@@ -0,0 +1,213 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * The delivery path through GstSpotifyRing against the GQueue of buffers
+ * under a mutex it replaced: throughput, and how long each delivery holds
+ * up the producer, which stands in for libspotify's thread.  The argument
+ * is the amount to move, in MiB.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench-util.h"
+#include "gstspotifyring.h"
+
+/* A 2048 frame delivery of 16 bit stereo, max-bytes and the element's
+ * output buffer size by default */
+#define CHUNK_SIZE   (2048 * 2 * 2)
+#define QUEUE_LIMIT  1000000
+#define OUT_SIZE     (2048 * 2 * 2)
+/* How soon a refused delivery is retried */
+#define RETRY_USEC   100
+
+typedef struct
+{
+  guint64     total;
+  guint8     *chunk;
+  GArray     *stalls;
+  guint       refused;
+
+  GstSpotifyRing *ring;
+
+  GMutex      lock;
+  GCond       cond;
+  GQueue      queue;
+  guint       queued;
+  gboolean    done;
+} RingBench;
+
+static gpointer
+ring_consume (RingBench * b)
+{
+  guint64 read = 0;
+
+  while (read < b->total) {
+    GstBuffer *buf = gst_buffer_new_allocate (NULL, OUT_SIZE, NULL);
+    GstMapInfo map;
+    guint n;
+
+    gst_spotify_ring_wait (b->ring, MIN (OUT_SIZE, b->total - read), -1,
+        gst_spotify_ring_get_kicks (b->ring));
+    gst_buffer_map (buf, &map, GST_MAP_WRITE);
+    n = gst_spotify_ring_read (b->ring, map.data, OUT_SIZE);
+    gst_buffer_unmap (buf, &map);
+    gst_buffer_set_size (buf, n);
+    gst_buffer_unref (buf);
+    read += n;
+  }
+
+  return NULL;
+}
+
+static void
+ring_produce (RingBench * b)
+{
+  guint64 written = 0;
+
+  while (written < b->total) {
+    gint64 begin = bench_get_time_ns (), stall;
+    guint n;
+
+    n = gst_spotify_ring_write (b->ring, b->chunk, MIN (CHUNK_SIZE,
+            b->total - written));
+    stall = bench_get_time_ns () - begin;
+    g_array_append_val (b->stalls, stall);
+    written += n;
+    if (n == 0) {
+      b->refused++;
+      g_usleep (RETRY_USEC);
+    }
+  }
+}
+
+static gpointer
+queue_consume (RingBench * b)
+{
+  guint64 read = 0;
+
+  while (read < b->total) {
+    GstBuffer *buf;
+
+    g_mutex_lock (&b->lock);
+    while (g_queue_is_empty (&b->queue))
+      g_cond_wait (&b->cond, &b->lock);
+    buf = g_queue_pop_head (&b->queue);
+    b->queued -= gst_buffer_get_size (buf);
+    g_mutex_unlock (&b->lock);
+
+    read += gst_buffer_get_size (buf);
+    gst_buffer_unref (buf);
+  }
+
+  return NULL;
+}
+
+/* Each delivery was copied into a buffer of its own and queued */
+static void
+queue_produce (RingBench * b)
+{
+  guint64 written = 0;
+
+  while (written < b->total) {
+    gint64 begin = bench_get_time_ns (), stall;
+    guint n = MIN (CHUNK_SIZE, b->total - written);
+    GstBuffer *buf;
+
+    g_mutex_lock (&b->lock);
+    if (b->queued >= QUEUE_LIMIT) {
+      g_mutex_unlock (&b->lock);
+      n = 0;
+    } else {
+      g_mutex_unlock (&b->lock);
+      buf = gst_buffer_new_allocate (NULL, n, NULL);
+      gst_buffer_fill (buf, 0, b->chunk, n);
+
+      g_mutex_lock (&b->lock);
+      g_queue_push_tail (&b->queue, buf);
+      b->queued += n;
+      g_cond_broadcast (&b->cond);
+      g_mutex_unlock (&b->lock);
+    }
+    stall = bench_get_time_ns () - begin;
+    g_array_append_val (b->stalls, stall);
+    written += n;
+    if (n == 0) {
+      b->refused++;
+      g_usleep (RETRY_USEC);
+    }
+  }
+}
+
+static void
+run (const gchar * name, RingBench * b, GThreadFunc consume,
+    void (*produce) (RingBench *))
+{
+  GThread *consumer;
+  gint64 begin, elapsed;
+
+  b->stalls = g_array_new (FALSE, FALSE, sizeof (gint64));
+  b->refused = 0;
+
+  begin = bench_get_time_ns ();
+  consumer = g_thread_new (name, consume, b);
+  produce (b);
+  g_thread_join (consumer);
+  elapsed = bench_get_time_ns () - begin;
+
+  g_print ("%-6s %8.1f MB/s, %u deliveries refused\n", name,
+      b->total * 1e3 / elapsed, b->refused);
+  bench_print_spread ("  producer stall", b->stalls, "ns");
+  g_array_free (b->stalls, TRUE);
+}
+
+int
+main (int argc, char *argv[])
+{
+  RingBench b;
+
+  gst_init (&argc, &argv);
+
+  memset (&b, 0, sizeof (b));
+  b.total = (argc > 1 ? g_ascii_strtoull (argv[1], NULL, 10) : 256) << 20;
+  b.chunk = g_malloc (CHUNK_SIZE);
+  memset (b.chunk, 0x55, CHUNK_SIZE);
+
+  g_print ("ring: %" G_GUINT64_FORMAT " MiB in %d byte deliveries\n",
+      b.total >> 20, CHUNK_SIZE);
+
+  b.ring = gst_spotify_ring_new (QUEUE_LIMIT);
+  run ("ring", &b, (GThreadFunc) ring_consume, ring_produce);
+  gst_spotify_ring_free (b.ring);
+
+  g_mutex_init (&b.lock);
+  g_cond_init (&b.cond);
+  g_queue_init (&b.queue);
+  run ("gqueue", &b, (GThreadFunc) queue_consume, queue_produce);
+  g_mutex_clear (&b.lock);
+  g_cond_clear (&b.cond);
+
+  g_free (b.chunk);
+
+  return 0;
+}
@@ -0,0 +1,164 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Time from a flushing seek until the sink gets audio from the new
+ * position, during real time playback, next to what the element reports
+ * as its seek-latency.  Arguments are spotifysrc properties.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "bench-util.h"
+
+#define BENCH_SEEKS        50
+#define BENCH_SEEK_TIMEOUT (5 * G_TIME_SPAN_SECOND)
+
+typedef struct
+{
+  GMutex      lock;
+  GCond       cond;
+  gint64      seek_time;
+  /* the buffers before the flush are from the old position */
+  gboolean    flushed;
+  gint64      latency;
+} SeekData;
+
+static GstPadProbeReturn
+seek_probe (GstPad * pad, GstPadProbeInfo * info, SeekData * data)
+{
+  g_mutex_lock (&data->lock);
+  if (!(GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER)) {
+    if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) ==
+        GST_EVENT_FLUSH_STOP)
+      data->flushed = TRUE;
+  } else if (data->flushed && data->latency < 0) {
+    data->latency = g_get_monotonic_time () - data->seek_time;
+    g_cond_signal (&data->cond);
+  }
+  g_mutex_unlock (&data->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Until the first buffer after the last seek, FALSE on timeout */
+static gboolean
+wait_buffer (SeekData * data)
+{
+  gint64 end = g_get_monotonic_time () + BENCH_SEEK_TIMEOUT;
+  gboolean res = TRUE;
+
+  g_mutex_lock (&data->lock);
+  while (data->latency < 0 && res)
+    res = g_cond_wait_until (&data->cond, &data->lock, end);
+  g_mutex_unlock (&data->lock);
+
+  return res;
+}
+
+int
+main (int argc, char *argv[])
+{
+  SpotifyMockConfig config;
+  GstElement *pipeline, *src, *sink;
+  GArray *to_sink, *reported;
+  gchar *props, *description;
+  SeekData data;
+  GstPad *pad;
+  GRand *rand;
+  guint i;
+
+  bench_init (&argc, &argv);
+  spotify_mock_config_init (&config);
+  config.track_duration = 120000;
+  spotify_mock_configure (&config);
+
+  props = g_strjoinv (" ", argv + 1);
+  description = g_strdup_printf ("spotifysrc name=src %s ! "
+      "fakesink name=sink sync=true", props);
+  pipeline = bench_pipeline_new (description, BENCH_TRACK_URI);
+  src = bench_pipeline_get (pipeline, "src");
+
+  g_mutex_init (&data.lock);
+  g_cond_init (&data.cond);
+  data.seek_time = 0;
+  data.flushed = FALSE;
+  data.latency = 0;
+  sink = bench_pipeline_get (pipeline, "sink");
+  pad = gst_element_get_static_pad (sink, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER |
+      GST_PAD_PROBE_TYPE_EVENT_FLUSH, (GstPadProbeCallback) seek_probe, &data, NULL);
+  gst_object_unref (pad);
+  gst_object_unref (sink);
+
+  if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE ||
+      gst_element_get_state (pipeline, NULL, NULL, GST_CLOCK_TIME_NONE) !=
+      GST_STATE_CHANGE_SUCCESS)
+    return 1;
+
+  to_sink = g_array_new (FALSE, FALSE, sizeof (gint64));
+  reported = g_array_new (FALSE, FALSE, sizeof (gint64));
+  rand = g_rand_new_with_seed (1);
+  for (i = 0; i < BENCH_SEEKS; i++) {
+    gint64 position = g_rand_int_range (rand, 0,
+        config.track_duration - 10000) * GST_MSECOND;
+    guint64 latency;
+    gint64 us;
+
+    /* Let it play a bit, as a listener would */
+    g_usleep (200 * G_TIME_SPAN_MILLISECOND);
+
+    g_mutex_lock (&data.lock);
+    data.flushed = FALSE;
+    data.latency = -1;
+    data.seek_time = g_get_monotonic_time ();
+    g_mutex_unlock (&data.lock);
+    if (!gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+            GST_SEEK_FLAG_FLUSH, position) || !wait_buffer (&data)) {
+      g_printerr ("seek %u to %" GST_TIME_FORMAT " failed\n", i,
+          GST_TIME_ARGS (position));
+      return 1;
+    }
+
+    g_array_append_val (to_sink, data.latency);
+    g_object_get (src, "seek-latency", &latency, NULL);
+    us = latency / GST_USECOND;
+    g_array_append_val (reported, us);
+  }
+
+  g_print ("seek: %u frames per delivery at %d Hz, %s\n",
+      config.chunk_frames, config.rate, props);
+  bench_print_spread ("seek to sink", to_sink, "us");
+  bench_print_spread ("seek-latency", reported, "us");
+
+  g_rand_free (rand);
+  g_array_free (to_sink, TRUE);
+  g_array_free (reported, TRUE);
+  gst_object_unref (src);
+  bench_pipeline_free (pipeline);
+  g_mutex_clear (&data.lock);
+  g_cond_clear (&data.cond);
+  g_free (description);
+  g_free (props);
+  bench_deinit ();
+
+  return 0;
+}
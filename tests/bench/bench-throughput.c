@@ -0,0 +1,92 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Tracks per hour decoded from an album into a non-synchronized sink,
+ * with bulk off and on, from the tracks-delivered and elapsed stats.  The
+ * mock decodes as fast as the element takes the audio.  Arguments are
+ * spotifysrc properties.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "bench-util.h"
+
+/* The actual album size and track length are given by the mock's config */
+static gboolean
+run (const SpotifyMockConfig * config, const gchar * props, gboolean bulk)
+{
+  GstElement *pipeline, *src;
+  GstStructure *stats;
+  gchar *description;
+  guint tracks, buffers;
+  guint64 elapsed;
+  gdouble hours;
+
+  description = g_strdup_printf ("spotifysrc name=src bulk=%s %s ! "
+      "fakesink name=sink sync=false", bulk ? "true" : "false", props);
+  pipeline = bench_pipeline_new (description, BENCH_ALBUM_URI);
+  g_free (description);
+
+  if (!bench_run_to_eos (pipeline)) {
+    bench_pipeline_free (pipeline);
+    return FALSE;
+  }
+
+  src = bench_pipeline_get (pipeline, "src");
+  g_object_get (src, "stats", &stats, NULL);
+  gst_structure_get_uint (stats, "tracks-delivered", &tracks);
+  gst_structure_get_uint (stats, "buffers-pushed", &buffers);
+  gst_structure_get_uint64 (stats, "elapsed", &elapsed);
+  gst_structure_free (stats);
+  gst_object_unref (src);
+  bench_pipeline_free (pipeline);
+
+  hours = (gdouble) elapsed / GST_SECOND / 3600;
+  g_print ("bulk=%-5s %3u tracks in %7.3f s, %10.0f tracks/hour, "
+      "%.0fx real time, %u buffers\n", bulk ? "true" : "false", tracks,
+      (gdouble) elapsed / GST_SECOND, tracks / hours,
+      tracks * config->track_duration / 1000.0 / (hours * 3600), buffers);
+
+  return TRUE;
+}
+
+int
+main (int argc, char *argv[])
+{
+  SpotifyMockConfig config;
+  gchar *props;
+  gboolean res;
+
+  bench_init (&argc, &argv);
+  spotify_mock_config_init (&config);
+  config.speed = 0;
+  spotify_mock_configure (&config);
+
+  props = g_strjoinv (" ", argv + 1);
+  g_print ("throughput: %u tracks of %u ms, %u frames per delivery, %s\n",
+      config.album_tracks, config.track_duration, config.chunk_frames, props);
+  res = run (&config, props, FALSE) && run (&config, props, TRUE);
+
+  g_free (props);
+  bench_deinit ();
+
+  return res ? 0 : 1;
+}
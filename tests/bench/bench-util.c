@@ -0,0 +1,142 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <time.h>
+
+#include "bench-util.h"
+#include "gstspotifysrc.h"
+
+/* Long enough for an album at real time */
+#define BENCH_TIMEOUT (10 * 60 * GST_SECOND)
+
+void
+bench_init (gint * argc, gchar *** argv)
+{
+  gst_init (argc, argv);
+  gst_element_register (NULL, "spotifysrc", GST_RANK_NONE,
+      GST_TYPE_SPOTIFY_SRC);
+  spotify_mock_setup_env ();
+}
+
+void
+bench_deinit (void)
+{
+  spotify_mock_teardown_env ();
+}
+
+GstElement *
+bench_pipeline_new (const gchar * description, const gchar * uri)
+{
+  GError *err = NULL;
+  GstElement *pipeline, *src;
+
+  pipeline = gst_parse_launch (description, &err);
+  if (pipeline == NULL)
+    g_error ("could not create \"%s\": %s", description, err->message);
+
+  src = bench_pipeline_get (pipeline, "src");
+  g_object_set (src, "uri", uri, NULL);
+  gst_object_unref (src);
+
+  return pipeline;
+}
+
+GstElement *
+bench_pipeline_get (GstElement * pipeline, const gchar * name)
+{
+  GstElement *element = gst_bin_get_by_name (GST_BIN (pipeline), name);
+
+  if (element == NULL)
+    g_error ("no element %s in the pipeline", name);
+
+  return element;
+}
+
+gboolean
+bench_run_to_eos (GstElement * pipeline)
+{
+  GstBus *bus = gst_element_get_bus (pipeline);
+  GstMessage *msg;
+  gboolean eos = FALSE;
+
+  if (gst_element_set_state (pipeline, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE) {
+    msg = gst_bus_timed_pop_filtered (bus, BENCH_TIMEOUT,
+        GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+    if (msg) {
+      eos = GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS;
+      if (!eos) {
+        GError *err = NULL;
+
+        gst_message_parse_error (msg, &err, NULL);
+        g_printerr ("error: %s\n", err->message);
+        g_error_free (err);
+      }
+      gst_message_unref (msg);
+    }
+  }
+  gst_object_unref (bus);
+
+  return eos;
+}
+
+void
+bench_pipeline_free (GstElement * pipeline)
+{
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+}
+
+gint64
+bench_get_time_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (gint64) ts.tv_sec * G_GINT64_CONSTANT (1000000000) + ts.tv_nsec;
+}
+
+static gint
+compare_int64 (gconstpointer a, gconstpointer b)
+{
+  gint64 x = *(const gint64 *) a, y = *(const gint64 *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+void
+bench_print_spread (const gchar * name, GArray * values, const gchar * unit)
+{
+  gint64 *v = (gint64 *) values->data;
+  guint n = values->len;
+
+  if (n == 0) {
+    g_print ("%-24s no samples\n", name);
+    return;
+  }
+
+  g_array_sort (values, compare_int64);
+  g_print ("%-24s n %6u  min %8" G_GINT64_FORMAT "  median %8"
+      G_GINT64_FORMAT "  p99 %8" G_GINT64_FORMAT "  max %8" G_GINT64_FORMAT
+      " %s\n", name, n, v[0], v[n / 2], v[MIN (n - 1, n * 99 / 100)],
+      v[n - 1], unit);
+}
@@ -0,0 +1,56 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _BENCH_UTIL_H_
+#define _BENCH_UTIL_H_
+
+#include <gst/gst.h>
+
+#include "spotify-mock.h"
+
+G_BEGIN_DECLS
+
+#define BENCH_TRACK_URI "spotify://spotify:track:bench"
+#define BENCH_ALBUM_URI "spotify://spotify:album:bench"
+
+/* Exit status for a benchmark that can't run here, as for automake tests */
+#define BENCH_SKIP 77
+
+/* Initializes GStreamer, registers spotifysrc and the mock account */
+void         bench_init            (gint * argc, gchar *** argv);
+void         bench_deinit          (void);
+
+/* A pipeline from @description, in which the spotifysrc is named "src" and
+ * the sink "sink" */
+GstElement * bench_pipeline_new    (const gchar * description,
+                                    const gchar * uri);
+GstElement * bench_pipeline_get    (GstElement * pipeline, const gchar * name);
+gboolean     bench_run_to_eos      (GstElement * pipeline);
+void         bench_pipeline_free   (GstElement * pipeline);
+
+/* Monotonic time in nanoseconds, for what is too short for microseconds */
+gint64       bench_get_time_ns     (void);
+
+/* Prints min, median, 99th percentile and max of @values (gint64, in
+ * @unit), sorting them */
+void         bench_print_spread    (const gchar * name, GArray * values,
+                                    const gchar * unit);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,387 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/audio/audio.h>
+
+#include "gstspotifysrc.h"
+#include "spotify-mock.h"
+
+#define TRACK_URI "spotify://spotify:track:mock"
+#define ALBUM_URI "spotify://spotify:album:mock"
+
+#define TEST_TIMEOUT (30 * GST_SECOND)
+
+/* What the sink saw since the start or the last flush */
+typedef struct
+{
+  GMutex      lock;
+  guint64     track_frames;
+  gint        rate;
+  guint64     frames;
+  guint       buffers;
+  GstClockTime first_pts;
+  GstClockTime next_pts;
+  gint16      first_sample;
+  gboolean    contiguous;
+  gboolean    pattern;
+} SinkData;
+
+static GstPadProbeReturn
+sink_probe (GstPad * pad, GstPadProbeInfo * info, SinkData * data)
+{
+  if (!(GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER)) {
+    if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) ==
+        GST_EVENT_FLUSH_STOP) {
+      g_mutex_lock (&data->lock);
+      data->frames = 0;
+      data->buffers = 0;
+      data->first_pts = GST_CLOCK_TIME_NONE;
+      g_mutex_unlock (&data->lock);
+    }
+  } else {
+    GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+    GstClockTime pts = GST_BUFFER_PTS (buf);
+    GstMapInfo map;
+    guint64 frame;
+    guint i, n;
+
+    gst_buffer_map (buf, &map, GST_MAP_READ);
+    n = map.size / (2 * sizeof (gint16));
+
+    g_mutex_lock (&data->lock);
+    if (data->buffers == 0) {
+      data->first_pts = pts;
+      data->first_sample = n ? ((gint16 *) map.data)[0] : 0;
+    } else if (pts != data->next_pts) {
+      data->contiguous = FALSE;
+    }
+
+    /* Tracks start their pattern over, so it follows from the timestamp */
+    frame = gst_util_uint64_scale_round (pts, data->rate, GST_SECOND);
+    for (i = 0; i < n; i++) {
+      guint64 f = (frame + i) % data->track_frames;
+
+      if (((gint16 *) map.data)[2 * i] != spotify_mock_sample (f, 0) ||
+          ((gint16 *) map.data)[2 * i + 1] != spotify_mock_sample (f, 1)) {
+        data->pattern = FALSE;
+        break;
+      }
+    }
+
+    data->next_pts = pts + gst_util_uint64_scale_round (n, GST_SECOND,
+        data->rate);
+    data->frames += n;
+    data->buffers++;
+    g_mutex_unlock (&data->lock);
+
+    gst_buffer_unmap (buf, &map);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* @filter goes between the source and the sink, ending in "!" */
+static GstElement *
+setup_pipeline (const gchar * uri, const gchar * filter, SinkData * data,
+    const SpotifyMockConfig * config, GstElement ** src)
+{
+  GstElement *pipeline;
+  GstElement *sink;
+  gchar *description;
+  GstPad *pad;
+
+  description = g_strdup_printf ("spotifysrc name=src ! audio/x-raw, "
+      "format=" GST_AUDIO_NE (S16) ", channels=2 ! %s "
+      "fakesink name=sink sync=false", filter);
+  pipeline = gst_parse_launch (description, NULL);
+  fail_unless (pipeline != NULL);
+  g_free (description);
+
+  *src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  g_object_set (*src, "uri", uri, NULL);
+
+  g_mutex_init (&data->lock);
+  data->rate = config->rate;
+  data->track_frames = (guint64) config->track_duration * config->rate / 1000;
+  data->frames = 0;
+  data->buffers = 0;
+  data->first_pts = GST_CLOCK_TIME_NONE;
+  data->contiguous = TRUE;
+  data->pattern = TRUE;
+
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  pad = gst_element_get_static_pad (sink, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER |
+      GST_PAD_PROBE_TYPE_EVENT_FLUSH, (GstPadProbeCallback) sink_probe,
+      data, NULL);
+  gst_object_unref (pad);
+  gst_object_unref (sink);
+
+  return pipeline;
+}
+
+static void
+cleanup_pipeline (GstElement * pipeline, GstElement * src, SinkData * data)
+{
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref (src);
+  gst_object_unref (pipeline);
+  g_mutex_clear (&data->lock);
+}
+
+static void
+run_to_eos (GstElement * pipeline)
+{
+  GstBus *bus = gst_element_get_bus (pipeline);
+  GstMessage *msg;
+
+  fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+  msg = gst_bus_timed_pop_filtered (bus, TEST_TIMEOUT,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL, "no EOS");
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+}
+
+static void
+test_config (SpotifyMockConfig * config, guint duration)
+{
+  spotify_mock_config_init (config);
+  config->speed = 0;
+  config->track_duration = duration;
+}
+
+GST_START_TEST (test_track)
+{
+  SpotifyMockConfig config;
+  SpotifyMockStats stats;
+  GstElement *pipeline, *src;
+  SinkData data;
+
+  test_config (&config, 1000);
+  spotify_mock_configure (&config);
+  pipeline = setup_pipeline (TRACK_URI, "", &data, &config, &src);
+
+  run_to_eos (pipeline);
+  fail_unless_equals_uint64 (data.first_pts, 0);
+  fail_unless_equals_uint64 (data.frames, data.track_frames);
+  fail_unless (data.contiguous, "timestamps are not contiguous");
+  fail_unless (data.pattern, "samples were lost or reordered");
+
+  spotify_mock_get_stats (&stats);
+  fail_unless_equals_int (stats.sessions_created, 1);
+  fail_unless_equals_int (stats.tracks_loaded, 1);
+  fail_unless_equals_int (stats.tracks_ended, 1);
+  fail_unless_equals_uint64 (stats.frames_accepted, data.track_frames);
+
+  cleanup_pipeline (pipeline, src, &data);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_album_gapless)
+{
+  SpotifyMockConfig config;
+  SpotifyMockStats stats;
+  GstElement *pipeline, *src;
+  SinkData data;
+
+  test_config (&config, 1000);
+  config.album_tracks = 3;
+  spotify_mock_configure (&config);
+  pipeline = setup_pipeline (ALBUM_URI, "", &data, &config, &src);
+
+  run_to_eos (pipeline);
+  fail_unless_equals_uint64 (data.frames, 3 * data.track_frames);
+  fail_unless (data.contiguous, "gap between tracks");
+  fail_unless (data.pattern, "samples were lost or reordered");
+
+  spotify_mock_get_stats (&stats);
+  fail_unless_equals_int (stats.tracks_loaded, 3);
+  fail_unless_equals_int (stats.tracks_ended, 3);
+
+  cleanup_pipeline (pipeline, src, &data);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_seek)
+{
+  SpotifyMockConfig config;
+  SpotifyMockStats stats;
+  GstElement *pipeline, *src;
+  SinkData data;
+  guint64 latency;
+
+  test_config (&config, 3000);
+  spotify_mock_configure (&config);
+  pipeline = setup_pipeline (TRACK_URI, "", &data, &config, &src);
+
+  fail_if (gst_element_set_state (pipeline, GST_STATE_PAUSED) ==
+      GST_STATE_CHANGE_FAILURE);
+  fail_unless_equals_int (gst_element_get_state (pipeline, NULL, NULL,
+          TEST_TIMEOUT), GST_STATE_CHANGE_SUCCESS);
+  fail_unless (gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE, GST_SECOND));
+
+  run_to_eos (pipeline);
+  fail_unless_equals_uint64 (data.first_pts, GST_SECOND);
+  fail_unless_equals_int (data.first_sample,
+      spotify_mock_sample (config.rate, 0));
+  fail_unless_equals_uint64 (data.frames, 2 * (guint64) config.rate);
+  fail_unless (data.contiguous, "timestamps are not contiguous");
+  fail_unless (data.pattern, "old audio was played after the seek");
+
+  spotify_mock_get_stats (&stats);
+  fail_unless_equals_int (stats.seeks, 1);
+  g_object_get (src, "seek-latency", &latency, NULL);
+  fail_unless (latency > 0);
+
+  cleanup_pipeline (pipeline, src, &data);
+}
+
+GST_END_TEST;
+
+/* libspotify allows one session per process */
+GST_START_TEST (test_one_session)
+{
+  SpotifyMockConfig config;
+  SpotifyMockStats stats;
+  GstElement *pipeline, *src, *other;
+  GstBus *bus;
+  GstMessage *msg;
+  GError *err = NULL;
+  SinkData data;
+
+  spotify_mock_config_init (&config);
+  config.track_duration = 60000;
+  spotify_mock_configure (&config);
+  pipeline = setup_pipeline (TRACK_URI, "", &data, &config, &src);
+  fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+  fail_unless_equals_int (gst_element_get_state (pipeline, NULL, NULL,
+          TEST_TIMEOUT), GST_STATE_CHANGE_SUCCESS);
+
+  other = gst_parse_launch ("spotifysrc uri=" TRACK_URI " ! fakesink", NULL);
+  fail_unless_equals_int (gst_element_set_state (other, GST_STATE_PAUSED),
+      GST_STATE_CHANGE_FAILURE);
+  bus = gst_element_get_bus (other);
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL);
+  gst_message_parse_error (msg, &err, NULL);
+  fail_unless (g_error_matches (err, GST_RESOURCE_ERROR,
+          GST_RESOURCE_ERROR_BUSY));
+  g_error_free (err);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+  gst_element_set_state (other, GST_STATE_NULL);
+  gst_object_unref (other);
+
+  spotify_mock_get_stats (&stats);
+  fail_unless_equals_int (stats.max_sessions_live, 1);
+  fail_unless_equals_int (stats.sessions_refused, 0);
+
+  cleanup_pipeline (pipeline, src, &data);
+}
+
+GST_END_TEST;
+
+/* libspotify decodes ahead until the buffer stats report its target, and
+ * the element must neither run dry nor let it run further ahead */
+GST_START_TEST (test_slow_consumer)
+{
+  SpotifyMockConfig config;
+  SpotifyMockStats stats;
+  GstElement *pipeline, *src;
+  GstStructure *s;
+  SinkData data;
+  guint underruns, target;
+
+  test_config (&config, 3000);
+  config.target_buffer = 500;
+  spotify_mock_configure (&config);
+  target = config.target_buffer * config.rate / 1000;
+
+  /* A 2048 frame buffer lasts 46 ms, taking 50 ms is a bit late */
+  pipeline = setup_pipeline (TRACK_URI, "identity sleep-time=50000 !",
+      &data, &config, &src);
+
+  run_to_eos (pipeline);
+  fail_unless_equals_uint64 (data.frames, data.track_frames);
+  fail_unless (data.contiguous, "timestamps are not contiguous");
+  fail_unless (data.pattern, "samples were lost or reordered");
+
+  g_object_get (src, "stats", &s, NULL);
+  fail_unless (gst_structure_get_uint (s, "underruns", &underruns));
+  fail_unless_equals_int (underruns, 0);
+  gst_structure_free (s);
+
+  spotify_mock_get_stats (&stats);
+  fail_unless_equals_int (stats.stutter_total, 0);
+  fail_unless (stats.buffer_samples_max >= target,
+      "the decoder was never held back");
+  fail_unless (stats.buffer_samples_max <= target + config.chunk_frames,
+      "reported %u samples over a target of %u", stats.buffer_samples_max,
+      target);
+
+  cleanup_pipeline (pipeline, src, &data);
+}
+
+GST_END_TEST;
+
+static void
+spotifysrc_setup (void)
+{
+  spotify_mock_setup_env ();
+}
+
+static void
+spotifysrc_teardown (void)
+{
+  spotify_mock_teardown_env ();
+}
+
+static Suite *
+spotifysrc_suite (void)
+{
+  Suite *s = suite_create ("spotifysrc");
+  TCase *tc_chain = tcase_create ("general");
+
+  gst_element_register (NULL, "spotifysrc", GST_RANK_NONE,
+      GST_TYPE_SPOTIFY_SRC);
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_checked_fixture (tc_chain, spotifysrc_setup, spotifysrc_teardown);
+  tcase_add_test (tc_chain, test_track);
+  tcase_add_test (tc_chain, test_album_gapless);
+  tcase_add_test (tc_chain, test_seek);
+  tcase_add_test (tc_chain, test_one_session);
+  tcase_add_test (tc_chain, test_slow_consumer);
+
+  return s;
+}
+
+GST_CHECK_MAIN (spotifysrc);
@@ -0,0 +1,349 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * The part of the libspotify 12 API that the plugin uses, with the same
+ * names, values and structure layouts, so the plugin sources build
+ * unchanged against the mock in spotify-mock.c.  Anything the plugin
+ * starts using has to be added here and there.
+ */
+
+#ifndef _SPOTIFY_MOCK_API_H_
+#define _SPOTIFY_MOCK_API_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SP_CALLCONV
+#define SPOTIFY_API_VERSION 12
+
+typedef uint64_t sp_uint64;
+
+typedef enum sp_error {
+  SP_ERROR_OK                        = 0,
+  SP_ERROR_BAD_API_VERSION           = 1,
+  SP_ERROR_API_INITIALIZATION_FAILED = 2,
+  SP_ERROR_TRACK_NOT_PLAYABLE        = 3,
+  SP_ERROR_BAD_APPLICATION_KEY       = 5,
+  SP_ERROR_BAD_USERNAME_OR_PASSWORD  = 6,
+  SP_ERROR_USER_BANNED               = 7,
+  SP_ERROR_UNABLE_TO_CONTACT_SERVER  = 8,
+  SP_ERROR_CLIENT_TOO_OLD            = 9,
+  SP_ERROR_OTHER_PERMANENT           = 10,
+  SP_ERROR_BAD_USER_AGENT            = 11,
+  SP_ERROR_MISSING_CALLBACK          = 12,
+  SP_ERROR_INVALID_INDATA            = 13,
+  SP_ERROR_INDEX_OUT_OF_RANGE        = 14,
+  SP_ERROR_USER_NEEDS_PREMIUM        = 15,
+  SP_ERROR_OTHER_TRANSIENT           = 16,
+  SP_ERROR_IS_LOADING                = 17,
+  SP_ERROR_NO_STREAM_AVAILABLE       = 18,
+  SP_ERROR_PERMISSION_DENIED         = 19,
+  SP_ERROR_INBOX_IS_FULL             = 20,
+  SP_ERROR_NO_CACHE                  = 21,
+  SP_ERROR_NO_SUCH_USER              = 22,
+  SP_ERROR_NO_CREDENTIALS            = 23,
+  SP_ERROR_NETWORK_DISABLED          = 24,
+  SP_ERROR_INVALID_DEVICE_ID         = 25,
+  SP_ERROR_CANT_OPEN_TRACE_FILE      = 26,
+  SP_ERROR_APPLICATION_BANNED        = 27,
+  SP_ERROR_OFFLINE_TOO_MANY_TRACKS   = 31,
+  SP_ERROR_OFFLINE_DISK_CACHE        = 32,
+  SP_ERROR_OFFLINE_EXPIRED           = 33,
+  SP_ERROR_OFFLINE_NOT_ALLOWED       = 34,
+  SP_ERROR_OFFLINE_LICENSE_LOST      = 35,
+  SP_ERROR_OFFLINE_LICENSE_ERROR     = 36,
+  SP_ERROR_LASTFM_AUTH_ERROR         = 39,
+  SP_ERROR_INVALID_ARGUMENT          = 40,
+  SP_ERROR_SYSTEM_FAILURE            = 41
+} sp_error;
+
+const char *sp_error_message (sp_error error);
+
+typedef struct sp_session sp_session;
+typedef struct sp_track sp_track;
+typedef struct sp_album sp_album;
+typedef struct sp_artist sp_artist;
+typedef struct sp_albumbrowse sp_albumbrowse;
+typedef struct sp_link sp_link;
+typedef struct sp_playlist sp_playlist;
+typedef struct sp_playlistcontainer sp_playlistcontainer;
+
+typedef enum sp_sampletype {
+  SP_SAMPLETYPE_INT16_NATIVE_ENDIAN = 0
+} sp_sampletype;
+
+typedef struct sp_audioformat {
+  sp_sampletype sample_type;
+  int sample_rate;
+  int channels;
+} sp_audioformat;
+
+typedef enum sp_bitrate {
+  SP_BITRATE_160k = 0,
+  SP_BITRATE_320k = 1,
+  SP_BITRATE_96k  = 2
+} sp_bitrate;
+
+typedef enum sp_playlist_offline_status {
+  SP_PLAYLIST_OFFLINE_STATUS_NO          = 0,
+  SP_PLAYLIST_OFFLINE_STATUS_YES         = 1,
+  SP_PLAYLIST_OFFLINE_STATUS_DOWNLOADING = 2,
+  SP_PLAYLIST_OFFLINE_STATUS_WAITING     = 3
+} sp_playlist_offline_status;
+
+typedef enum sp_availability {
+  SP_TRACK_AVAILABILITY_UNAVAILABLE      = 0,
+  SP_TRACK_AVAILABILITY_AVAILABLE        = 1,
+  SP_TRACK_AVAILABILITY_NOT_STREAMABLE   = 2,
+  SP_TRACK_AVAILABILITY_BANNED_BY_ARTIST = 3
+} sp_track_availability;
+
+typedef enum sp_connection_type {
+  SP_CONNECTION_TYPE_UNKNOWN        = 0,
+  SP_CONNECTION_TYPE_NONE           = 1,
+  SP_CONNECTION_TYPE_MOBILE         = 2,
+  SP_CONNECTION_TYPE_MOBILE_ROAMING = 3,
+  SP_CONNECTION_TYPE_WIFI           = 4,
+  SP_CONNECTION_TYPE_WIRED          = 5
+} sp_connection_type;
+
+typedef enum sp_connection_rules {
+  SP_CONNECTION_RULE_NETWORK                = 0x1,
+  SP_CONNECTION_RULE_NETWORK_IF_ROAMING     = 0x2,
+  SP_CONNECTION_RULE_ALLOW_SYNC_OVER_MOBILE = 0x4,
+  SP_CONNECTION_RULE_ALLOW_SYNC_OVER_WIFI   = 0x8
+} sp_connection_rules;
+
+typedef enum sp_linktype {
+  SP_LINKTYPE_INVALID    = 0,
+  SP_LINKTYPE_TRACK      = 1,
+  SP_LINKTYPE_ALBUM      = 2,
+  SP_LINKTYPE_ARTIST     = 3,
+  SP_LINKTYPE_SEARCH     = 4,
+  SP_LINKTYPE_PLAYLIST   = 5,
+  SP_LINKTYPE_PROFILE    = 6,
+  SP_LINKTYPE_STARRED    = 7,
+  SP_LINKTYPE_LOCALTRACK = 8,
+  SP_LINKTYPE_IMAGE      = 9
+} sp_linktype;
+
+typedef struct sp_audio_buffer_stats {
+  int samples;
+  int stutter;
+} sp_audio_buffer_stats;
+
+typedef struct sp_offline_sync_status {
+  int queued_tracks;
+  sp_uint64 queued_bytes;
+  int done_tracks;
+  sp_uint64 done_bytes;
+  int copied_tracks;
+  sp_uint64 copied_bytes;
+  int willnotcopy_tracks;
+  int error_tracks;
+  bool syncing;
+} sp_offline_sync_status;
+
+typedef struct sp_session_callbacks {
+  void (SP_CALLCONV *logged_in) (sp_session *session, sp_error error);
+  void (SP_CALLCONV *logged_out) (sp_session *session);
+  void (SP_CALLCONV *metadata_updated) (sp_session *session);
+  void (SP_CALLCONV *connection_error) (sp_session *session, sp_error error);
+  void (SP_CALLCONV *message_to_user) (sp_session *session,
+                                       const char *message);
+  void (SP_CALLCONV *notify_main_thread) (sp_session *session);
+  int (SP_CALLCONV *music_delivery) (sp_session *session,
+                                     const sp_audioformat *format,
+                                     const void *frames, int num_frames);
+  void (SP_CALLCONV *play_token_lost) (sp_session *session);
+  void (SP_CALLCONV *log_message) (sp_session *session, const char *data);
+  void (SP_CALLCONV *end_of_track) (sp_session *session);
+  void (SP_CALLCONV *streaming_error) (sp_session *session, sp_error error);
+  void (SP_CALLCONV *userinfo_updated) (sp_session *session);
+  void (SP_CALLCONV *start_playback) (sp_session *session);
+  void (SP_CALLCONV *stop_playback) (sp_session *session);
+  void (SP_CALLCONV *get_audio_buffer_stats) (sp_session *session,
+                                              sp_audio_buffer_stats *stats);
+  void (SP_CALLCONV *offline_status_updated) (sp_session *session);
+  void (SP_CALLCONV *offline_error) (sp_session *session, sp_error error);
+  void (SP_CALLCONV *credentials_blob_updated) (sp_session *session,
+                                                const char *blob);
+  void (SP_CALLCONV *connectionstate_updated) (sp_session *session);
+  void (SP_CALLCONV *scrobble_error) (sp_session *session, sp_error error);
+  void (SP_CALLCONV *private_session_mode_changed) (sp_session *session,
+                                                    bool is_private);
+} sp_session_callbacks;
+
+typedef struct sp_session_config {
+  int api_version;
+  const char *cache_location;
+  const char *settings_location;
+  const void *application_key;
+  size_t application_key_size;
+  const char *user_agent;
+  const sp_session_callbacks *callbacks;
+  void *userdata;
+  bool compress_playlists;
+  bool dont_save_metadata_for_playlists;
+  bool initially_unload_playlists;
+  const char *device_id;
+  const char *proxy;
+  const char *proxy_username;
+  const char *proxy_password;
+  const char *ca_certs_filename;
+  const char *tracefile;
+} sp_session_config;
+
+/* session */
+sp_error sp_session_create (const sp_session_config *config,
+                            sp_session **sess);
+sp_error sp_session_release (sp_session *sess);
+sp_error sp_session_login (sp_session *session, const char *username,
+                           const char *password, bool remember_me,
+                           const char *blob);
+sp_error sp_session_relogin (sp_session *session);
+int sp_session_remembered_user (sp_session *session, char *buffer,
+                                size_t buffer_size);
+void *sp_session_userdata (sp_session *session);
+sp_error sp_session_set_cache_size (sp_session *session, size_t size);
+sp_error sp_session_process_events (sp_session *session, int *next_timeout);
+sp_error sp_session_player_load (sp_session *session, sp_track *track);
+sp_error sp_session_player_seek (sp_session *session, int offset);
+sp_error sp_session_player_play (sp_session *session, bool play);
+sp_error sp_session_player_unload (sp_session *session);
+sp_error sp_session_player_prefetch (sp_session *session, sp_track *track);
+sp_playlistcontainer *sp_session_playlistcontainer (sp_session *session);
+sp_error sp_session_preferred_bitrate (sp_session *session,
+                                       sp_bitrate bitrate);
+sp_error sp_session_preferred_offline_bitrate (sp_session *session,
+                                               sp_bitrate bitrate,
+                                               bool allow_resync);
+sp_error sp_session_set_volume_normalization (sp_session *session, bool on);
+sp_error sp_session_set_connection_type (sp_session *session,
+                                         sp_connection_type type);
+sp_error sp_session_set_connection_rules (sp_session *session,
+                                          sp_connection_rules rules);
+
+/* offline */
+int sp_offline_tracks_to_sync (sp_session *session);
+int sp_offline_num_playlists (sp_session *session);
+bool sp_offline_sync_get_status (sp_session *session,
+                                 sp_offline_sync_status *status);
+int sp_offline_time_left (sp_session *session);
+
+/* links */
+sp_link *sp_link_create_from_string (const char *link);
+sp_link *sp_link_create_from_track (sp_track *track, int offset);
+int sp_link_as_string (sp_link *link, char *buffer, int buffer_size);
+sp_linktype sp_link_type (sp_link *link);
+sp_track *sp_link_as_track (sp_link *link);
+sp_album *sp_link_as_album (sp_link *link);
+sp_error sp_link_release (sp_link *link);
+
+/* tracks, albums and artists */
+bool sp_track_is_loaded (sp_track *track);
+sp_track_availability sp_track_get_availability (sp_session *session,
+                                                 sp_track *track);
+int sp_track_num_artists (sp_track *track);
+sp_artist *sp_track_artist (sp_track *track, int index);
+sp_album *sp_track_album (sp_track *track);
+const char *sp_track_name (sp_track *track);
+int sp_track_duration (sp_track *track);
+sp_error sp_track_add_ref (sp_track *track);
+sp_error sp_track_release (sp_track *track);
+
+bool sp_album_is_loaded (sp_album *album);
+const char *sp_album_name (sp_album *album);
+
+bool sp_artist_is_loaded (sp_artist *artist);
+const char *sp_artist_name (sp_artist *artist);
+
+/* album browsing */
+typedef void SP_CALLCONV albumbrowse_complete_cb (sp_albumbrowse *result,
+                                                  void *userdata);
+
+sp_albumbrowse *sp_albumbrowse_create (sp_session *session, sp_album *album,
+                                       albumbrowse_complete_cb *callback,
+                                       void *userdata);
+bool sp_albumbrowse_is_loaded (sp_albumbrowse *alb);
+sp_error sp_albumbrowse_error (sp_albumbrowse *alb);
+int sp_albumbrowse_num_tracks (sp_albumbrowse *alb);
+sp_track *sp_albumbrowse_track (sp_albumbrowse *alb, int index);
+sp_error sp_albumbrowse_release (sp_albumbrowse *alb);
+
+/* playlists */
+typedef struct sp_playlist_callbacks {
+  void (SP_CALLCONV *tracks_added) (sp_playlist *pl, sp_track *const *tracks,
+                                    int num_tracks, int position,
+                                    void *userdata);
+  void (SP_CALLCONV *tracks_removed) (sp_playlist *pl, const int *tracks,
+                                      int num_tracks, void *userdata);
+  void (SP_CALLCONV *tracks_moved) (sp_playlist *pl, const int *tracks,
+                                    int num_tracks, int new_position,
+                                    void *userdata);
+  void (SP_CALLCONV *playlist_renamed) (sp_playlist *pl, void *userdata);
+  void (SP_CALLCONV *playlist_state_changed) (sp_playlist *pl,
+                                              void *userdata);
+  void (SP_CALLCONV *playlist_update_in_progress) (sp_playlist *pl, bool done,
+                                                   void *userdata);
+  void (SP_CALLCONV *playlist_metadata_updated) (sp_playlist *pl,
+                                                 void *userdata);
+  void (SP_CALLCONV *track_created_changed) (sp_playlist *pl, int position,
+                                             void *user, int when,
+                                             void *userdata);
+  void (SP_CALLCONV *track_seen_changed) (sp_playlist *pl, int position,
+                                          bool seen, void *userdata);
+  void (SP_CALLCONV *description_changed) (sp_playlist *pl, const char *desc,
+                                           void *userdata);
+  void (SP_CALLCONV *image_changed) (sp_playlist *pl, const uint8_t *image,
+                                     void *userdata);
+  void (SP_CALLCONV *track_message_changed) (sp_playlist *pl, int position,
+                                             const char *message,
+                                             void *userdata);
+  void (SP_CALLCONV *subscribers_changed) (sp_playlist *pl, void *userdata);
+} sp_playlist_callbacks;
+
+sp_playlist *sp_playlist_create (sp_session *session, sp_link *link);
+bool sp_playlist_is_loaded (sp_playlist *playlist);
+sp_error sp_playlist_add_callbacks (sp_playlist *playlist,
+                                    sp_playlist_callbacks *callbacks,
+                                    void *userdata);
+sp_error sp_playlist_remove_callbacks (sp_playlist *playlist,
+                                       sp_playlist_callbacks *callbacks,
+                                       void *userdata);
+int sp_playlist_num_tracks (sp_playlist *playlist);
+sp_track *sp_playlist_track (sp_playlist *playlist, int index);
+sp_error sp_playlist_set_offline_mode (sp_session *session,
+                                       sp_playlist *playlist, bool offline);
+sp_playlist_offline_status sp_playlist_get_offline_status (
+    sp_session *session, sp_playlist *playlist);
+int sp_playlist_get_offline_download_completed (sp_session *session,
+                                                sp_playlist *playlist);
+sp_error sp_playlist_release (sp_playlist *playlist);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
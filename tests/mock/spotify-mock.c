@@ -0,0 +1,1204 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <libspotify/api.h>
+
+#include "spotify-mock.h"
+
+/* What the plugin reads from an app key file */
+#define MOCK_APPKEY_SIZE   321
+/* Poll interval when no event is due */
+#define MOCK_MAX_TIMEOUT   1000
+
+struct sp_artist
+{
+  const char *name;
+};
+
+struct sp_album
+{
+  gchar      *id;
+  gchar      *name;
+};
+
+struct sp_track
+{
+  gchar      *link;
+  gchar      *name;
+  sp_album   *album;
+  /* metadata_updated is called once it has loaded */
+  gint64      loaded_at;
+  gboolean    announced;
+};
+
+struct sp_link
+{
+  sp_linktype type;
+  gchar      *str;
+  sp_track   *track;
+  sp_album   *album;
+};
+
+struct sp_albumbrowse
+{
+  sp_session *session;
+  sp_album   *album;
+  GPtrArray  *tracks;
+  albumbrowse_complete_cb *callback;
+  void       *userdata;
+  gboolean    loaded;
+};
+
+struct sp_playlist
+{
+  gchar      *link;
+  GPtrArray  *tracks;
+};
+
+typedef struct
+{
+  guint64     frame;
+  guint       frames;
+  gint64      time;
+} MockDelivery;
+
+struct sp_session
+{
+  sp_session_config config;
+  GThread    *thread;
+  GCond       cond;
+  gboolean    quit;
+
+  /* a login completes in sp_session_process_events() once due */
+  gint64      login_due;
+  sp_error    login_result;
+  /* album browses to complete in sp_session_process_events() */
+  GList      *browses;
+
+  /* player, positions are in frames of the loaded track */
+  sp_track   *track;
+  gboolean    playing;
+  gboolean    ended;
+  gboolean    flush_pending;
+  guint64     position;
+  guint       generation;
+  /* delivery is paced from this time and position */
+  gint64      pace_time;
+  guint64     pace_position;
+};
+
+static GMutex mock_lock;
+static gboolean mock_configured = FALSE;
+static SpotifyMockConfig mock_config;
+static SpotifyMockStats mock_stats;
+static sp_session *mock_session = NULL;
+static GHashTable *mock_tracks = NULL;
+static GHashTable *mock_albums = NULL;
+static GHashTable *mock_offline = NULL;
+static GArray *mock_deliveries = NULL;
+static gchar *mock_remembered_user = NULL;
+static gchar *mock_appkey_file = NULL;
+static sp_artist mock_artist = { "Mock Artist" };
+
+static guint
+mock_env_uint (const gchar * name, guint def)
+{
+  const gchar *value = g_getenv (name);
+
+  return value ? (guint) g_ascii_strtoull (value, NULL, 10) : def;
+}
+
+/* Defaults, overridden by SPOTIFY_MOCK_* environment variables so runs of
+ * the tests and benchmarks can be varied without rebuilding */
+void
+spotify_mock_config_init (SpotifyMockConfig * config)
+{
+  const gchar *speed = g_getenv ("SPOTIFY_MOCK_SPEED");
+
+  config->rate = mock_env_uint ("SPOTIFY_MOCK_RATE", 44100);
+  config->channels = mock_env_uint ("SPOTIFY_MOCK_CHANNELS", 2);
+  config->chunk_frames = mock_env_uint ("SPOTIFY_MOCK_CHUNK_FRAMES", 2048);
+  config->speed = speed ? g_ascii_strtod (speed, NULL) : 1.0;
+  config->track_duration = mock_env_uint ("SPOTIFY_MOCK_TRACK_DURATION",
+      10000);
+  config->album_tracks = mock_env_uint ("SPOTIFY_MOCK_ALBUM_TRACKS", 3);
+  config->login_delay = mock_env_uint ("SPOTIFY_MOCK_LOGIN_DELAY", 0);
+  config->load_delay = mock_env_uint ("SPOTIFY_MOCK_LOAD_DELAY", 0);
+  config->retry_interval = mock_env_uint ("SPOTIFY_MOCK_RETRY_INTERVAL", 10);
+  config->target_buffer = mock_env_uint ("SPOTIFY_MOCK_TARGET_BUFFER", 0);
+}
+
+static void
+mock_ensure_locked (void)
+{
+  if (!mock_configured) {
+    spotify_mock_config_init (&mock_config);
+    mock_configured = TRUE;
+  }
+  if (mock_tracks == NULL) {
+    mock_tracks = g_hash_table_new (g_str_hash, g_str_equal);
+    mock_albums = g_hash_table_new (g_str_hash, g_str_equal);
+    mock_offline = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        NULL);
+    mock_deliveries = g_array_new (FALSE, FALSE, sizeof (MockDelivery));
+  }
+}
+
+void
+spotify_mock_configure (const SpotifyMockConfig * config)
+{
+  g_return_if_fail (config->rate > 0);
+  g_return_if_fail (config->channels >= 1 && config->channels <= 2);
+  g_return_if_fail (config->chunk_frames > 0);
+
+  g_mutex_lock (&mock_lock);
+  mock_ensure_locked ();
+  mock_config = *config;
+  if (mock_session)
+    g_cond_broadcast (&mock_session->cond);
+  g_mutex_unlock (&mock_lock);
+}
+
+void
+spotify_mock_get_stats (SpotifyMockStats * stats)
+{
+  g_mutex_lock (&mock_lock);
+  *stats = mock_stats;
+  g_mutex_unlock (&mock_lock);
+}
+
+/* Keeps the session counts, which describe what exists right now */
+void
+spotify_mock_reset_stats (void)
+{
+  guint live, refs;
+
+  g_mutex_lock (&mock_lock);
+  live = mock_stats.sessions_live;
+  refs = mock_stats.track_refs;
+  memset (&mock_stats, 0, sizeof (mock_stats));
+  mock_stats.sessions_live = mock_stats.max_sessions_live = live;
+  mock_stats.track_refs = refs;
+  g_mutex_unlock (&mock_lock);
+}
+
+gint64
+spotify_mock_get_delivery_time (guint64 frame)
+{
+  gint64 time = -1;
+  guint i;
+
+  g_mutex_lock (&mock_lock);
+  mock_ensure_locked ();
+  for (i = mock_deliveries->len; i > 0; i--) {
+    MockDelivery *d = &g_array_index (mock_deliveries, MockDelivery, i - 1);
+
+    if (frame >= d->frame && frame < d->frame + d->frames) {
+      time = d->time;
+      break;
+    }
+  }
+  g_mutex_unlock (&mock_lock);
+
+  return time;
+}
+
+void
+spotify_mock_setup_env (void)
+{
+  guint8 appkey[MOCK_APPKEY_SIZE] = { 0, };
+  GError *err = NULL;
+  gint fd;
+
+  fd = g_file_open_tmp ("spotify-mock-XXXXXX.key", &mock_appkey_file, &err);
+  if (fd < 0)
+    g_error ("could not create an app key: %s", err->message);
+  close (fd);
+  if (!g_file_set_contents (mock_appkey_file, (const gchar *) appkey,
+          sizeof (appkey), &err))
+    g_error ("could not write %s: %s", mock_appkey_file, err->message);
+
+  g_setenv ("SPOTIFY_APPKEY", mock_appkey_file, TRUE);
+  g_setenv ("SPOTIFY_USER", "mock", TRUE);
+  g_setenv ("SPOTIFY_PASS", "mock", TRUE);
+}
+
+void
+spotify_mock_teardown_env (void)
+{
+  if (mock_appkey_file) {
+    g_unlink (mock_appkey_file);
+    g_free (mock_appkey_file);
+    mock_appkey_file = NULL;
+  }
+  g_unsetenv ("SPOTIFY_APPKEY");
+  g_unsetenv ("SPOTIFY_USER");
+  g_unsetenv ("SPOTIFY_PASS");
+}
+
+/* Returns the session to wake up for a new event, with a reference on
+ * nothing: sessions are only freed by sp_session_release() */
+static sp_session *
+mock_get_session_locked (void)
+{
+  return mock_session;
+}
+
+static void
+mock_notify (sp_session * session)
+{
+  if (session && session->config.callbacks->notify_main_thread)
+    session->config.callbacks->notify_main_thread (session);
+}
+
+static guint64
+mock_track_frames (void)
+{
+  return (guint64) mock_config.track_duration * mock_config.rate / 1000;
+}
+
+/**** catalog  ************************************************************/
+
+static sp_album *
+mock_album_get_locked (const gchar * id)
+{
+  sp_album *album = g_hash_table_lookup (mock_albums, id);
+
+  if (album == NULL) {
+    album = g_new0 (sp_album, 1);
+    album->id = g_strdup (id);
+    album->name = g_strdup_printf ("Album %s", id);
+    g_hash_table_insert (mock_albums, album->id, album);
+  }
+
+  return album;
+}
+
+/* Tracks live as long as the process, the links are their identity */
+static sp_track *
+mock_track_get_locked (const gchar * link, sp_album * album)
+{
+  sp_track *track = g_hash_table_lookup (mock_tracks, link);
+
+  if (track == NULL) {
+    track = g_new0 (sp_track, 1);
+    track->link = g_strdup (link);
+    track->name = g_strdup_printf ("Track %s",
+        link + strlen ("spotify:track:"));
+    track->album = album ? album : mock_album_get_locked ("mock");
+    track->loaded_at = g_get_monotonic_time () +
+        mock_config.load_delay * G_TIME_SPAN_MILLISECOND;
+    track->announced = (mock_config.load_delay == 0);
+    g_hash_table_insert (mock_tracks, track->link, track);
+  }
+
+  return track;
+}
+
+/* @n tracks named after @id, belonging to @album if set */
+static GPtrArray *
+mock_tracks_new_locked (const gchar * id, sp_album * album, guint n)
+{
+  GPtrArray *tracks = g_ptr_array_new ();
+  guint i;
+
+  for (i = 0; i < n; i++) {
+    gchar *link = g_strdup_printf ("spotify:track:%sn%u", id, i);
+
+    g_ptr_array_add (tracks, mock_track_get_locked (link, album));
+    g_free (link);
+  }
+
+  return tracks;
+}
+
+const char *
+sp_error_message (sp_error error)
+{
+  switch (error) {
+    case SP_ERROR_OK:
+      return "No error";
+    case SP_ERROR_BAD_USERNAME_OR_PASSWORD:
+      return "Invalid username or password";
+    case SP_ERROR_UNABLE_TO_CONTACT_SERVER:
+      return "Unable to contact server";
+    case SP_ERROR_IS_LOADING:
+      return "Resource not loaded yet";
+    case SP_ERROR_NO_CREDENTIALS:
+      return "No credentials are stored";
+    default:
+      return "Mock error";
+  }
+}
+
+/**** session  ************************************************************/
+
+static gpointer
+mock_session_thread (sp_session * session)
+{
+  const sp_session_callbacks *callbacks = session->config.callbacks;
+  static const gint16 silence[2] = { 0, };
+  gint16 *data = NULL;
+  guint data_frames = 0;
+
+  g_mutex_lock (&mock_lock);
+  while (!session->quit) {
+    SpotifyMockConfig config = mock_config;
+    sp_audioformat format;
+    sp_audio_buffer_stats stats = { 0, 0 };
+    MockDelivery delivery;
+    guint64 total, position;
+    guint generation, n, f;
+    gint c, accepted = 0;
+    gboolean paced;
+    gint64 now;
+
+    format.sample_type = SP_SAMPLETYPE_INT16_NATIVE_ENDIAN;
+    format.sample_rate = config.rate;
+    format.channels = config.channels;
+
+    /* libspotify confirms a seek with an empty delivery */
+    if (session->flush_pending) {
+      session->flush_pending = FALSE;
+      mock_stats.empty_deliveries++;
+      g_mutex_unlock (&mock_lock);
+      callbacks->music_delivery (session, &format, silence, 0);
+      g_mutex_lock (&mock_lock);
+      continue;
+    }
+
+    if (session->track == NULL || !session->playing || session->ended) {
+      g_cond_wait (&session->cond, &mock_lock);
+      continue;
+    }
+
+    total = mock_track_frames ();
+    if (session->position >= total) {
+      session->ended = TRUE;
+      mock_stats.tracks_ended++;
+      g_mutex_unlock (&mock_lock);
+      if (callbacks->end_of_track)
+        callbacks->end_of_track (session);
+      g_mutex_lock (&mock_lock);
+      continue;
+    }
+
+    now = g_get_monotonic_time ();
+    if (config.speed > 0) {
+      gint64 due = session->pace_time + (gint64)
+          ((session->position - session->pace_position) * G_USEC_PER_SEC /
+          (config.rate * config.speed));
+
+      if (now < due) {
+        g_cond_wait_until (&session->cond, &mock_lock, due);
+        continue;
+      }
+    }
+
+    n = MIN (config.chunk_frames, total - session->position);
+    if (n > data_frames) {
+      data = g_renew (gint16, data, n * config.channels);
+      data_frames = n;
+    }
+    for (f = 0; f < n; f++) {
+      for (c = 0; c < config.channels; c++)
+        data[f * config.channels + c] =
+            spotify_mock_sample (session->position + f, c);
+    }
+    generation = session->generation;
+    position = session->position;
+    g_mutex_unlock (&mock_lock);
+
+    if (callbacks->get_audio_buffer_stats)
+      callbacks->get_audio_buffer_stats (session, &stats);
+    paced = config.target_buffer > 0 && stats.samples >=
+        (gint) ((guint64) config.target_buffer * config.rate / 1000);
+    if (!paced)
+      accepted = callbacks->music_delivery (session, &format, data, n);
+
+    g_mutex_lock (&mock_lock);
+    mock_stats.buffer_stats_calls++;
+    mock_stats.buffer_samples_max = MAX (mock_stats.buffer_samples_max,
+        (guint) MAX (stats.samples, 0));
+    mock_stats.stutter_total += MAX (stats.stutter, 0);
+
+    /* The element holds enough, decode in real time */
+    if (paced) {
+      g_cond_wait_until (&session->cond, &mock_lock,
+          g_get_monotonic_time () + n * G_USEC_PER_SEC / config.rate);
+      continue;
+    }
+
+    mock_stats.deliveries++;
+    /* Loaded or sought meanwhile, those frames are stale */
+    if (generation != session->generation)
+      continue;
+
+    accepted = CLAMP (accepted, 0, (gint) n);
+    if (accepted > 0) {
+      delivery.frame = position;
+      delivery.frames = accepted;
+      delivery.time = g_get_monotonic_time ();
+      g_array_append_val (mock_deliveries, delivery);
+      session->position += accepted;
+      mock_stats.frames_accepted += accepted;
+    }
+    if ((guint) accepted < n) {
+      mock_stats.deliveries_refused++;
+      g_cond_wait_until (&session->cond, &mock_lock,
+          g_get_monotonic_time () +
+          config.retry_interval * G_TIME_SPAN_MILLISECOND);
+    }
+  }
+  g_mutex_unlock (&mock_lock);
+
+  g_free (data);
+  return NULL;
+}
+
+sp_error
+sp_session_create (const sp_session_config * config, sp_session ** sess)
+{
+  sp_session *session;
+
+  if (config->api_version != SPOTIFY_API_VERSION)
+    return SP_ERROR_BAD_API_VERSION;
+  if (config->application_key == NULL || config->application_key_size == 0)
+    return SP_ERROR_BAD_APPLICATION_KEY;
+  if (config->callbacks == NULL || config->callbacks->music_delivery == NULL)
+    return SP_ERROR_MISSING_CALLBACK;
+
+  g_mutex_lock (&mock_lock);
+  mock_ensure_locked ();
+  /* libspotify only supports one session per process */
+  if (mock_session) {
+    mock_stats.sessions_refused++;
+    g_mutex_unlock (&mock_lock);
+    return SP_ERROR_API_INITIALIZATION_FAILED;
+  }
+
+  session = g_new0 (sp_session, 1);
+  session->config = *config;
+  g_cond_init (&session->cond);
+  mock_session = session;
+  mock_stats.sessions_created++;
+  mock_stats.sessions_live++;
+  mock_stats.max_sessions_live = MAX (mock_stats.max_sessions_live,
+      mock_stats.sessions_live);
+  g_mutex_unlock (&mock_lock);
+
+  session->thread = g_thread_new ("spotify-mock",
+      (GThreadFunc) mock_session_thread, session);
+  *sess = session;
+
+  return SP_ERROR_OK;
+}
+
+sp_error
+sp_session_release (sp_session * session)
+{
+  GList *l;
+
+  g_mutex_lock (&mock_lock);
+  session->quit = TRUE;
+  g_cond_broadcast (&session->cond);
+  g_mutex_unlock (&mock_lock);
+  g_thread_join (session->thread);
+
+  g_mutex_lock (&mock_lock);
+  for (l = session->browses; l; l = l->next)
+    ((sp_albumbrowse *) l->data)->session = NULL;
+  g_list_free (session->browses);
+  mock_session = NULL;
+  mock_stats.sessions_live--;
+  g_mutex_unlock (&mock_lock);
+
+  g_cond_clear (&session->cond);
+  g_free (session);
+
+  return SP_ERROR_OK;
+}
+
+static void
+mock_login_locked (sp_session * session, sp_error result)
+{
+  session->login_due = g_get_monotonic_time () +
+      mock_config.login_delay * G_TIME_SPAN_MILLISECOND;
+  session->login_result = result;
+  mock_stats.logins++;
+}
+
+sp_error
+sp_session_login (sp_session * session, const char *username,
+    const char *password, bool remember_me, const char *blob)
+{
+  if (username == NULL || *username == '\0')
+    return SP_ERROR_INVALID_ARGUMENT;
+
+  g_mutex_lock (&mock_lock);
+  mock_login_locked (session, (password && *password) || (blob && *blob) ?
+      SP_ERROR_OK : SP_ERROR_BAD_USERNAME_OR_PASSWORD);
+  if (remember_me) {
+    g_free (mock_remembered_user);
+    mock_remembered_user = g_strdup (username);
+  }
+  g_mutex_unlock (&mock_lock);
+
+  mock_notify (session);
+  return SP_ERROR_OK;
+}
+
+sp_error
+sp_session_relogin (sp_session * session)
+{
+  g_mutex_lock (&mock_lock);
+  if (mock_remembered_user == NULL) {
+    g_mutex_unlock (&mock_lock);
+    return SP_ERROR_NO_CREDENTIALS;
+  }
+  mock_login_locked (session, SP_ERROR_OK);
+  g_mutex_unlock (&mock_lock);
+
+  mock_notify (session);
+  return SP_ERROR_OK;
+}
+
+int
+sp_session_remembered_user (sp_session * session, char *buffer,
+    size_t buffer_size)
+{
+  int len = -1;
+
+  g_mutex_lock (&mock_lock);
+  if (mock_remembered_user) {
+    len = strlen (mock_remembered_user);
+    if (buffer && buffer_size > 0)
+      g_strlcpy (buffer, mock_remembered_user, buffer_size);
+  }
+  g_mutex_unlock (&mock_lock);
+
+  return len;
+}
+
+void *
+sp_session_userdata (sp_session * session)
+{
+  return session->config.userdata;
+}
+
+/* Runs the callbacks of whatever became due, without the mock lock since
+ * they call back into the API */
+sp_error
+sp_session_process_events (sp_session * session, int *next_timeout)
+{
+  const sp_session_callbacks *callbacks = session->config.callbacks;
+  gint64 now = g_get_monotonic_time (), next = G_MAXINT64;
+  gboolean login_done = FALSE, metadata = FALSE;
+  sp_error login_result = SP_ERROR_OK;
+  GList *browses, *l;
+  GHashTableIter iter;
+  sp_track *track;
+
+  g_mutex_lock (&mock_lock);
+  if (session->login_due) {
+    if (now >= session->login_due) {
+      login_done = TRUE;
+      login_result = session->login_result;
+      session->login_due = 0;
+    } else {
+      next = session->login_due;
+    }
+  }
+
+  g_hash_table_iter_init (&iter, mock_tracks);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & track)) {
+    if (track->announced)
+      continue;
+    if (now >= track->loaded_at) {
+      track->announced = TRUE;
+      metadata = TRUE;
+    } else {
+      next = MIN (next, track->loaded_at);
+    }
+  }
+
+  browses = session->browses;
+  session->browses = NULL;
+  for (l = browses; l; l = l->next)
+    ((sp_albumbrowse *) l->data)->loaded = TRUE;
+  g_mutex_unlock (&mock_lock);
+
+  if (next == G_MAXINT64)
+    *next_timeout = MOCK_MAX_TIMEOUT;
+  else
+    *next_timeout = CLAMP ((next - now + 999) / 1000, 0, MOCK_MAX_TIMEOUT);
+
+  if (login_done) {
+    callbacks->logged_in (session, login_result);
+    if (login_result == SP_ERROR_OK && callbacks->credentials_blob_updated)
+      callbacks->credentials_blob_updated (session, "mock-credentials-blob");
+  }
+  if (metadata && callbacks->metadata_updated)
+    callbacks->metadata_updated (session);
+  for (l = browses; l; l = l->next) {
+    sp_albumbrowse *browse = l->data;
+
+    browse->callback (browse, browse->userdata);
+  }
+  g_list_free (browses);
+
+  return SP_ERROR_OK;
+}
+
+sp_error
+sp_session_set_cache_size (sp_session * session, size_t size)
+{
+  return SP_ERROR_OK;
+}
+
+sp_error
+sp_session_player_load (sp_session * session, sp_track * track)
+{
+  g_mutex_lock (&mock_lock);
+  if (g_get_monotonic_time () < track->loaded_at) {
+    g_mutex_unlock (&mock_lock);
+    return SP_ERROR_IS_LOADING;
+  }
+
+  session->track = track;
+  session->playing = FALSE;
+  session->ended = FALSE;
+  session->flush_pending = FALSE;
+  session->position = 0;
+  session->generation++;
+  g_array_set_size (mock_deliveries, 0);
+  mock_stats.tracks_loaded++;
+  g_cond_broadcast (&session->cond);
+  g_mutex_unlock (&mock_lock);
+
+  return SP_ERROR_OK;
+}
+
+sp_error
+sp_session_player_seek (sp_session * session, int offset)
+{
+  g_mutex_lock (&mock_lock);
+  if (session->track == NULL) {
+    g_mutex_unlock (&mock_lock);
+    return SP_ERROR_NO_STREAM_AVAILABLE;
+  }
+
+  session->position = MIN ((guint64) MAX (offset, 0) * mock_config.rate /
+      1000, mock_track_frames ());
+  session->ended = FALSE;
+  session->flush_pending = TRUE;
+  session->generation++;
+  session->pace_time = g_get_monotonic_time ();
+  session->pace_position = session->position;
+  mock_stats.seeks++;
+  g_cond_broadcast (&session->cond);
+  g_mutex_unlock (&mock_lock);
+
+  return SP_ERROR_OK;
+}
+
+sp_error
+sp_session_player_play (sp_session * session, bool play)
+{
+  g_mutex_lock (&mock_lock);
+  session->playing = play;
+  session->pace_time = g_get_monotonic_time ();
+  session->pace_position = session->position;
+  g_cond_broadcast (&session->cond);
+  g_mutex_unlock (&mock_lock);
+
+  return SP_ERROR_OK;
+}
+
+sp_error
+sp_session_player_unload (sp_session * session)
+{
+  g_mutex_lock (&mock_lock);
+  session->track = NULL;
+  session->playing = FALSE;
+  session->flush_pending = FALSE;
+  session->generation++;
+  g_cond_broadcast (&session->cond);
+  g_mutex_unlock (&mock_lock);
+
+  return SP_ERROR_OK;
+}
+
+sp_error
+sp_session_player_prefetch (sp_session * session, sp_track * track)
+{
+  return SP_ERROR_OK;
+}
+
+sp_playlistcontainer *
+sp_session_playlistcontainer (sp_session * session)
+{
+  return NULL;
+}
+
+sp_error
+sp_session_preferred_bitrate (sp_session * session, sp_bitrate bitrate)
+{
+  return SP_ERROR_OK;
+}
+
+sp_error
+sp_session_preferred_offline_bitrate (sp_session * session,
+    sp_bitrate bitrate, bool allow_resync)
+{
+  return SP_ERROR_OK;
+}
+
+sp_error
+sp_session_set_volume_normalization (sp_session * session, bool on)
+{
+  return SP_ERROR_OK;
+}
+
+sp_error
+sp_session_set_connection_type (sp_session * session,
+    sp_connection_type type)
+{
+  return SP_ERROR_OK;
+}
+
+sp_error
+sp_session_set_connection_rules (sp_session * session,
+    sp_connection_rules rules)
+{
+  return SP_ERROR_OK;
+}
+
+/**** offline  ************************************************************/
+
+int
+sp_offline_tracks_to_sync (sp_session * session)
+{
+  return 0;
+}
+
+int
+sp_offline_num_playlists (sp_session * session)
+{
+  int n;
+
+  g_mutex_lock (&mock_lock);
+  n = g_hash_table_size (mock_offline);
+  g_mutex_unlock (&mock_lock);
+
+  return n;
+}
+
+bool
+sp_offline_sync_get_status (sp_session * session,
+    sp_offline_sync_status * status)
+{
+  memset (status, 0, sizeof (*status));
+  return FALSE;
+}
+
+int
+sp_offline_time_left (sp_session * session)
+{
+  return 30 * 24 * 3600;
+}
+
+/**** links  **************************************************************/
+
+static sp_link *
+mock_link_new (sp_linktype type, const gchar * str)
+{
+  sp_link *link = g_new0 (sp_link, 1);
+
+  link->type = type;
+  link->str = g_strdup (str);
+
+  return link;
+}
+
+sp_link *
+sp_link_create_from_string (const char *str)
+{
+  sp_link *link = NULL;
+  const gchar *id;
+  gboolean loading = FALSE;
+
+  if (str == NULL)
+    return NULL;
+
+  g_mutex_lock (&mock_lock);
+  mock_ensure_locked ();
+  if (g_str_has_prefix (str, "spotify:track:") &&
+      str[strlen ("spotify:track:")] != '\0') {
+    link = mock_link_new (SP_LINKTYPE_TRACK, str);
+    link->track = mock_track_get_locked (str, NULL);
+    loading = !link->track->announced;
+  } else if (g_str_has_prefix (str, "spotify:album:") &&
+      str[strlen ("spotify:album:")] != '\0') {
+    link = mock_link_new (SP_LINKTYPE_ALBUM, str);
+    link->album = mock_album_get_locked (str + strlen ("spotify:album:"));
+  } else if (g_str_has_prefix (str, "spotify:user:") &&
+      (id = strstr (str, ":playlist:")) != NULL &&
+      id[strlen (":playlist:")] != '\0') {
+    link = mock_link_new (SP_LINKTYPE_PLAYLIST, str);
+  }
+  g_mutex_unlock (&mock_lock);
+
+  /* The main loop has to come around for the metadata */
+  if (loading)
+    mock_notify (mock_get_session_locked ());
+
+  return link;
+}
+
+sp_link *
+sp_link_create_from_track (sp_track * track, int offset)
+{
+  sp_link *link = mock_link_new (SP_LINKTYPE_TRACK, track->link);
+
+  link->track = track;
+  return link;
+}
+
+int
+sp_link_as_string (sp_link * link, char *buffer, int buffer_size)
+{
+  if (buffer && buffer_size > 0)
+    g_strlcpy (buffer, link->str, buffer_size);
+
+  return strlen (link->str);
+}
+
+sp_linktype
+sp_link_type (sp_link * link)
+{
+  return link->type;
+}
+
+sp_track *
+sp_link_as_track (sp_link * link)
+{
+  return link->type == SP_LINKTYPE_TRACK ? link->track : NULL;
+}
+
+sp_album *
+sp_link_as_album (sp_link * link)
+{
+  return link->type == SP_LINKTYPE_ALBUM ? link->album : NULL;
+}
+
+sp_error
+sp_link_release (sp_link * link)
+{
+  g_free (link->str);
+  g_free (link);
+
+  return SP_ERROR_OK;
+}
+
+/**** tracks, albums and artists  *****************************************/
+
+bool
+sp_track_is_loaded (sp_track * track)
+{
+  return g_get_monotonic_time () >= track->loaded_at;
+}
+
+sp_track_availability
+sp_track_get_availability (sp_session * session, sp_track * track)
+{
+  return SP_TRACK_AVAILABILITY_AVAILABLE;
+}
+
+int
+sp_track_num_artists (sp_track * track)
+{
+  return sp_track_is_loaded (track) ? 1 : 0;
+}
+
+sp_artist *
+sp_track_artist (sp_track * track, int index)
+{
+  return index == 0 ? &mock_artist : NULL;
+}
+
+sp_album *
+sp_track_album (sp_track * track)
+{
+  return sp_track_is_loaded (track) ? track->album : NULL;
+}
+
+const char *
+sp_track_name (sp_track * track)
+{
+  return sp_track_is_loaded (track) ? track->name : "";
+}
+
+int
+sp_track_duration (sp_track * track)
+{
+  int duration;
+
+  if (!sp_track_is_loaded (track))
+    return 0;
+
+  g_mutex_lock (&mock_lock);
+  duration = mock_config.track_duration;
+  g_mutex_unlock (&mock_lock);
+
+  return duration;
+}
+
+sp_error
+sp_track_add_ref (sp_track * track)
+{
+  g_mutex_lock (&mock_lock);
+  mock_stats.track_refs++;
+  g_mutex_unlock (&mock_lock);
+
+  return SP_ERROR_OK;
+}
+
+sp_error
+sp_track_release (sp_track * track)
+{
+  g_mutex_lock (&mock_lock);
+  mock_stats.track_refs--;
+  g_mutex_unlock (&mock_lock);
+
+  return SP_ERROR_OK;
+}
+
+bool
+sp_album_is_loaded (sp_album * album)
+{
+  return TRUE;
+}
+
+const char *
+sp_album_name (sp_album * album)
+{
+  return album->name;
+}
+
+bool
+sp_artist_is_loaded (sp_artist * artist)
+{
+  return TRUE;
+}
+
+const char *
+sp_artist_name (sp_artist * artist)
+{
+  return artist->name;
+}
+
+/**** album browsing  *****************************************************/
+
+sp_albumbrowse *
+sp_albumbrowse_create (sp_session * session, sp_album * album,
+    albumbrowse_complete_cb * callback, void *userdata)
+{
+  sp_albumbrowse *browse;
+
+  if (album == NULL)
+    return NULL;
+
+  browse = g_new0 (sp_albumbrowse, 1);
+  browse->session = session;
+  browse->album = album;
+  browse->callback = callback;
+  browse->userdata = userdata;
+
+  g_mutex_lock (&mock_lock);
+  browse->tracks = mock_tracks_new_locked (album->id, album,
+      mock_config.album_tracks);
+  session->browses = g_list_append (session->browses, browse);
+  g_mutex_unlock (&mock_lock);
+
+  mock_notify (session);
+  return browse;
+}
+
+bool
+sp_albumbrowse_is_loaded (sp_albumbrowse * browse)
+{
+  gboolean loaded;
+
+  g_mutex_lock (&mock_lock);
+  loaded = browse->loaded;
+  g_mutex_unlock (&mock_lock);
+
+  return loaded;
+}
+
+sp_error
+sp_albumbrowse_error (sp_albumbrowse * browse)
+{
+  return sp_albumbrowse_is_loaded (browse) ? SP_ERROR_OK :
+      SP_ERROR_IS_LOADING;
+}
+
+int
+sp_albumbrowse_num_tracks (sp_albumbrowse * browse)
+{
+  return sp_albumbrowse_is_loaded (browse) ? (int) browse->tracks->len : 0;
+}
+
+sp_track *
+sp_albumbrowse_track (sp_albumbrowse * browse, int index)
+{
+  if (index < 0 || (guint) index >= browse->tracks->len)
+    return NULL;
+
+  return g_ptr_array_index (browse->tracks, index);
+}
+
+sp_error
+sp_albumbrowse_release (sp_albumbrowse * browse)
+{
+  g_mutex_lock (&mock_lock);
+  if (browse->session)
+    browse->session->browses = g_list_remove (browse->session->browses,
+        browse);
+  g_mutex_unlock (&mock_lock);
+
+  g_ptr_array_free (browse->tracks, TRUE);
+  g_free (browse);
+
+  return SP_ERROR_OK;
+}
+
+/**** playlists  **********************************************************/
+
+sp_playlist *
+sp_playlist_create (sp_session * session, sp_link * link)
+{
+  sp_playlist *playlist;
+  const gchar *id;
+
+  if (link == NULL || link->type != SP_LINKTYPE_PLAYLIST)
+    return NULL;
+
+  id = strrchr (link->str, ':') + 1;
+  playlist = g_new0 (sp_playlist, 1);
+  playlist->link = g_strdup (link->str);
+
+  g_mutex_lock (&mock_lock);
+  playlist->tracks = mock_tracks_new_locked (id, NULL,
+      mock_config.album_tracks);
+  g_mutex_unlock (&mock_lock);
+
+  return playlist;
+}
+
+bool
+sp_playlist_is_loaded (sp_playlist * playlist)
+{
+  return TRUE;
+}
+
+sp_error
+sp_playlist_add_callbacks (sp_playlist * playlist,
+    sp_playlist_callbacks * callbacks, void *userdata)
+{
+  return SP_ERROR_OK;
+}
+
+sp_error
+sp_playlist_remove_callbacks (sp_playlist * playlist,
+    sp_playlist_callbacks * callbacks, void *userdata)
+{
+  return SP_ERROR_OK;
+}
+
+int
+sp_playlist_num_tracks (sp_playlist * playlist)
+{
+  return playlist->tracks->len;
+}
+
+sp_track *
+sp_playlist_track (sp_playlist * playlist, int index)
+{
+  if (index < 0 || (guint) index >= playlist->tracks->len)
+    return NULL;
+
+  return g_ptr_array_index (playlist->tracks, index);
+}
+
+sp_error
+sp_playlist_set_offline_mode (sp_session * session, sp_playlist * playlist,
+    bool offline)
+{
+  g_mutex_lock (&mock_lock);
+  if (offline)
+    g_hash_table_add (mock_offline, g_strdup (playlist->link));
+  else
+    g_hash_table_remove (mock_offline, playlist->link);
+  g_mutex_unlock (&mock_lock);
+
+  return SP_ERROR_OK;
+}
+
+sp_playlist_offline_status
+sp_playlist_get_offline_status (sp_session * session, sp_playlist * playlist)
+{
+  gboolean offline;
+
+  g_mutex_lock (&mock_lock);
+  offline = g_hash_table_contains (mock_offline, playlist->link);
+  g_mutex_unlock (&mock_lock);
+
+  return offline ? SP_PLAYLIST_OFFLINE_STATUS_YES :
+      SP_PLAYLIST_OFFLINE_STATUS_NO;
+}
+
+int
+sp_playlist_get_offline_download_completed (sp_session * session,
+    sp_playlist * playlist)
+{
+  return sp_playlist_get_offline_status (session, playlist) ==
+      SP_PLAYLIST_OFFLINE_STATUS_YES ? 100 : 0;
+}
+
+sp_error
+sp_playlist_release (sp_playlist * playlist)
+{
+  g_ptr_array_free (playlist->tracks, TRUE);
+  g_free (playlist->link);
+  g_free (playlist);
+
+  return SP_ERROR_OK;
+}
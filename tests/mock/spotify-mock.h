@@ -0,0 +1,104 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _SPOTIFY_MOCK_H_
+#define _SPOTIFY_MOCK_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Control side of the mock libspotify.  Every link resolves: a track link
+ * to one track, album and playlist links to album-tracks tracks.  Logins
+ * succeed with any password or blob, and a session thread delivers a
+ * counting pattern, see spotify_mock_sample(), in chunks of chunk-frames
+ * at speed times real time.  Refused frames are delivered again after
+ * retry-interval, and a seek is followed by an empty delivery, as
+ * libspotify does.
+ *
+ * Like libspotify, the mock refuses to create a second session while one
+ * exists.
+ */
+typedef struct
+{
+  gint    rate;
+  gint    channels;
+  /* frames per music_delivery call */
+  guint   chunk_frames;
+  /* delivery pace relative to real time, 0 for as fast as accepted */
+  gdouble speed;
+  /* in milliseconds */
+  guint   track_duration;
+  guint   album_tracks;
+  guint   login_delay;
+  guint   load_delay;
+  guint   retry_interval;
+  /* Audio the element may hold before delivery slows down to real time,
+   * in milliseconds, the way libspotify paces its decoder by the buffer
+   * stats.  0 ignores the stats. */
+  guint   target_buffer;
+} SpotifyMockConfig;
+
+typedef struct
+{
+  guint   sessions_created;
+  guint   sessions_live;
+  guint   max_sessions_live;
+  guint   sessions_refused;
+  guint   logins;
+  guint   tracks_loaded;
+  guint   tracks_ended;
+  guint   seeks;
+  guint   deliveries;
+  guint   empty_deliveries;
+  /* deliveries of which the element took less than all frames */
+  guint   deliveries_refused;
+  guint64 frames_accepted;
+  guint   buffer_stats_calls;
+  /* largest samples reported in the buffer stats, and the stutter summed */
+  guint   buffer_samples_max;
+  guint   stutter_total;
+  /* track references the element holds */
+  gint    track_refs;
+} SpotifyMockStats;
+
+void     spotify_mock_config_init      (SpotifyMockConfig * config);
+void     spotify_mock_configure        (const SpotifyMockConfig * config);
+void     spotify_mock_get_stats        (SpotifyMockStats * stats);
+void     spotify_mock_reset_stats      (void);
+
+/* Monotonic time at which the frame at @frame of the playing track was
+ * accepted, or -1 if it was not delivered since the track was loaded */
+gint64   spotify_mock_get_delivery_time (guint64 frame);
+
+/* Points SPOTIFY_APPKEY, SPOTIFY_USER and SPOTIFY_PASS at a dummy account
+ * for elements created afterwards */
+void     spotify_mock_setup_env        (void);
+void     spotify_mock_teardown_env     (void);
+
+/* The sample the mock delivers at @frame of a track in @channel */
+static inline gint16
+spotify_mock_sample (guint64 frame, gint channel)
+{
+  return (gint16) (guint16) (frame * 2 + channel);
+}
+
+G_END_DECLS
+
+#endif